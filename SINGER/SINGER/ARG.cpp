@@ -75,16 +75,19 @@ void ARG::build_singleton_arg(Node_ptr n) {
     Recombination r = Recombination({}, {branch});
     r.set_pos(0.0);
     recombinations[0] = r;
+    tree_map.clear();
     for (double x : mutation_sites) {
         mutation_branches[x] = {branch};
     }
+    recount_mutations();
 }
 
 void ARG::add_sample(Node_ptr n) {
     sample_nodes.insert(n);
-    for (auto &x : n->mutation_sites) {
-        // mutation_sites.insert(x);
-        mutation_sites.insert(x.first);
+    mutation_sites.insert(-1);
+    mutation_sites.insert(INT_MAX);
+    for (double x : n->get_mutations()) {
+        mutation_sites.insert(x);
     }
     removed_branches.clear();
     removed_branches[0] = Branch(n, root);
@@ -115,14 +118,30 @@ void ARG::add_new_node(double t) {
 Tree ARG::get_tree_at(double x) {
     Tree tree = Tree();
     auto recomb_it = recombinations.begin();
+    auto tree_it = tree_map.upper_bound(x);
+    if (tree_it != tree_map.begin()) {
+        tree_it--;
+        tree = tree_it->second;
+        recomb_it = recombinations.upper_bound(tree_it->first);
+    }
+    int num_updates = 0;
     while (recomb_it->first <= x) {
         Recombination &r = recomb_it->second;
         tree.forward_update(r);
+        num_updates += 1;
+        if (num_updates == tree_spacing) {
+            tree_map[recomb_it->first] = tree;
+            num_updates = 0;
+        }
         recomb_it++;
     }
     return tree;
 }
 
+void ARG::invalidate_trees(double x, double y) {
+    tree_map.erase(tree_map.lower_bound(x), tree_map.upper_bound(y));
+}
+
 Node_ptr ARG::get_query_node_at(double x) {
     auto query_it = removed_branches.upper_bound(x);
     query_it--;
@@ -154,6 +173,10 @@ Tree ARG::modify_tree_to(double x, Tree &reference_tree, double x0) {
 }
 
 Tree ARG::internal_modify_tree_to(double x, Tree &reference_tree, double x0) {
+    return internal_modify_tree_to(x, reference_tree, x0, cut_time);
+}
+
+Tree ARG::internal_modify_tree_to(double x, Tree &reference_tree, double x0, double t) {
     Tree tree = reference_tree;
     if (x == x0) {
         return tree;
@@ -161,7 +184,7 @@ Tree ARG::internal_modify_tree_to(double x, Tree &reference_tree, double x0) {
         auto recomb_it = recombinations.upper_bound(x0);
         while (recomb_it->first <= x) {
             Recombination &r = recomb_it->second;
-            tree.internal_forward_update(r, cut_time);
+            tree.internal_forward_update(r, t);
             ++recomb_it;
         }
         return tree;
@@ -170,7 +193,7 @@ Tree ARG::internal_modify_tree_to(double x, Tree &reference_tree, double x0) {
         --recomb_it;
         while (recomb_it->first > x) {
             Recombination &r = recomb_it->second;
-            tree.internal_backward_update(r, cut_time);
+            tree.internal_backward_update(r, t);
             --recomb_it;
         }
         return tree;
@@ -203,6 +226,9 @@ void ARG::remove(tuple<double, Branch, double> cut_point) {
         }
         next_joining_branch = forward_tree.find_joining_branch(next_removed_branch);
         r.remove(prev_removed_branch, next_removed_branch, prev_joining_branch, next_joining_branch, cut_node);
+        if (r.start_time <= 0) {
+            dirty_recombinations.push_back(r.pos);
+        }
         removed_branches[min(r.pos, sequence_length)] = next_removed_branch;
         joining_branches[min(r.pos, sequence_length)] = next_joining_branch;
         f_it++;
@@ -226,10 +252,14 @@ void ARG::remove(tuple<double, Branch, double> cut_point) {
         }
         prev_joining_branch = backward_tree.find_joining_branch(prev_removed_branch);
         r.remove(prev_removed_branch, next_removed_branch, prev_joining_branch, next_joining_branch, cut_node);
+        if (r.start_time <= 0) {
+            dirty_recombinations.push_back(r.pos);
+        }
         next_removed_branch = prev_removed_branch;
     }
     start = removed_branches.begin()->first;
     end = removed_branches.rbegin()->first;
+    invalidate_trees(start, end);
     remove_empty_recombinations();
     remap_mutations();
     cut_tree.remove(center_branch, cut_node);
@@ -240,8 +270,73 @@ void ARG::remove(tuple<double, Branch, double> cut_point) {
     end_tree = move(forward_tree);
 }
 
+pair<double, double> ARG::trace_cut(tuple<double, Branch, double> cut_point) {
+    double pos;
+    Branch center_branch;
+    double t;
+    tie(pos, center_branch, t) = cut_point;
+    double x = pos;
+    double y = pos;
+    auto f_it = recombinations.upper_bound(pos);
+    auto b_it = recombinations.upper_bound(pos);
+    Branch removed_branch = center_branch;
+    while (removed_branch != Branch()) {
+        Recombination &r = f_it->second;
+        removed_branch = r.trace_forward(t, removed_branch);
+        if (removed_branch.upper_node == root) {
+            removed_branch = Branch();
+        }
+        y = min(r.pos, sequence_length);
+        f_it++;
+    }
+    removed_branch = center_branch;
+    while (removed_branch != Branch()) {
+        b_it--;
+        Recombination &r = b_it->second;
+        removed_branch = r.trace_backward(t, removed_branch);
+        if (removed_branch.upper_node == root) {
+            removed_branch = Branch();
+        }
+        x = r.pos;
+    }
+    return {x, y};
+}
+
+void ARG::save_remove_info(Remove_info &r) {
+    r.cut_node = cut_node;
+    r.cut_time = cut_time;
+    r.start = start;
+    r.end = end;
+    r.cut_pos = cut_pos;
+    r.cut_tree = move(cut_tree);
+    r.start_tree = move(start_tree);
+    r.end_tree = move(end_tree);
+    r.joining_branches = move(joining_branches);
+    r.removed_branches = move(removed_branches);
+    joining_branches.clear();
+    removed_branches.clear();
+    cut_node = nullptr;
+}
+
+void ARG::load_remove_info(Remove_info &r) {
+    cut_node = r.cut_node;
+    cut_time = r.cut_time;
+    start = r.start;
+    end = r.end;
+    cut_pos = r.cut_pos;
+    cut_tree = move(r.cut_tree);
+    start_tree = move(r.start_tree);
+    end_tree = move(r.end_tree);
+    joining_branches = move(r.joining_branches);
+    removed_branches = move(r.removed_branches);
+    r.joining_branches.clear();
+    r.removed_branches.clear();
+    r.cut_node = nullptr;
+}
+
 void ARG::remove(map<double, Branch> seed_branches) {
     // insights here: the coordinates of removed branches is the same as recombinations
+    invalidate_trees(start, end);
     Tree tree = Tree();
     auto recomb_it = recombinations.lower_bound(start);
     auto seed_it = seed_branches.begin();
@@ -257,6 +352,9 @@ void ARG::remove(map<double, Branch> seed_branches) {
         next_joining_branch = tree.find_joining_branch(next_removed_branch);
         recomb_it++;
         r.remove(prev_removed_branch, next_removed_branch, prev_joining_branch, next_joining_branch);
+        if (r.start_time <= 0) {
+            dirty_recombinations.push_back(r.pos);
+        }
         removed_branches[r.pos] = next_removed_branch;
         joining_branches[r.pos] = next_joining_branch;
         prev_removed_branch = next_removed_branch;
@@ -268,6 +366,7 @@ void ARG::remove(map<double, Branch> seed_branches) {
     remap_mutations();
     start = removed_branches.begin()->first;
     end = removed_branches.rbegin()->first;
+    invalidate_trees(start, end);
 }
 
 void ARG::remove_leaf(int index) {
@@ -319,6 +418,9 @@ void ARG::add(map<double, Branch> &new_joining_branches, map<double, Branch> &ad
             next_added_branch = add_it->second;
             add_it++;
             r.add(prev_added_branch, next_added_branch, prev_joining_branch, next_joining_branch, cut_node);
+            if (r.start_time <= 0) {
+                dirty_recombinations.push_back(r.pos);
+            }
             prev_joining_branch = next_joining_branch;
             prev_added_branch = next_added_branch;
         } else {
@@ -333,13 +435,15 @@ void ARG::add(map<double, Branch> &new_joining_branches, map<double, Branch> &ad
             prev_added_branch = next_added_branch;
         }
     }
+    invalidate_trees(min(start, added_branches.begin()->first), max(end, added_branches.rbegin()->first));
     remove_empty_recombinations();
     impute(new_joining_branches, added_branches);
     start_tree.add(added_branches.begin()->second, new_joining_branches.begin()->second, cut_node);
 }
 
-void ARG::smc_sample_recombinations() {
+void ARG::smc_sample_recombinations(Random_context &rng) {
     RSP_smc rsp = RSP_smc();
+    rsp.rng = &rng;
     Tree tree = start_tree;
     auto it = recombinations.upper_bound(start);
     while (it->first < end) {
@@ -351,6 +455,7 @@ void ARG::smc_sample_recombinations() {
         tree.forward_update(r);
         it++;
     }
+    take_dirty_recombinations(start, end);
 }
 
 /*
@@ -386,19 +491,24 @@ void ARG::adjust_recombinations() {
  */
 
 void ARG::approx_sample_recombinations() {
-    // double n = sample_nodes.size();
+    approx_sample_recombinations(0, sequence_length);
+}
+
+void ARG::approx_sample_recombinations(double x, double y) {
+    // only the recombinations touched since the last call can still lack a start time
     RSP_smc rsp = RSP_smc();
-    auto it = recombinations.upper_bound(0);
-    while (it->first < sequence_length) {
+    for (double pos : take_dirty_recombinations(x, y)) {
+        auto it = recombinations.find(pos);
+        if (it == recombinations.end()) {
+            continue; // removed by remove_empty_recombinations
+        }
         Recombination &r = it->second;
         if (r.pos > 0 and r.pos < sequence_length) {
-            // rsp.approx_sample_recombination(r, cut_time, n);
             rsp.approx_sample_recombination(r, cut_time);
             assert(r.start_time > 0);
             assert(r.start_time <= r.inserted_node->time);
             assert(r.start_time <= r.deleted_node->time);
         }
-        it++;
     }
 }
 
@@ -419,6 +529,27 @@ void ARG::adjust_recombinations() {
     }
 }
 
+void ARG::adjust_recombinations(Thread_team &team) {
+    vector<Recombination *> adjusted = {};
+    auto it = recombinations.upper_bound(0);
+    while (it->first < sequence_length) {
+        if (it->second.pos != 0 and it->second.pos < sequence_length) {
+            adjusted.push_back(&it->second);
+        }
+        it++;
+    }
+    team.run_parts((int) adjusted.size(), [&adjusted](int x, int y) {
+        RSP_smc rsp = RSP_smc();
+        for (int i = x; i < y; i++) {
+            Recombination &r = *adjusted[i];
+            rsp.adjust(r, 0);
+            assert(r.start_time > 0);
+            assert(r.start_time <= r.inserted_node->time);
+            assert(r.start_time <= r.deleted_node->time);
+        }
+    });
+}
+
 /*
 int ARG::count_incompatibility() {
     Tree tree = Tree();
@@ -447,35 +578,32 @@ int ARG::count_incompatibility() {
  */
 
 int ARG::count_incompatibility() {
-    int count = 0;
-    for (auto &x : mutation_branches) {
-        set<Branch> &branches = x.second;
-        if (branches.size() > 1) {
-            if (branches.rbegin()->upper_node == root) {
-                if (branches.size() > 2) {
-                    count += 1;
-                }
-            } else {
-                if (branches.size() > 1) {
-                    count += 1;
-                }
-            }
-        }
-    }
-    return count;
+    return num_incompatible;
 }
 
-
-
 int ARG::count_flipping() {
-    int count = 0;
-    for (auto x : mutation_branches) {
-        set<Branch> &branches = x.second;
-        if (branches.size() > 1 and branches.rbegin()->upper_node == root) {
-            count += 1;
+    return num_flipped;
+}
+
+void ARG::tally_mutation(const set<Branch> &branches, int sign) {
+    if (branches.size() > 1) {
+        // the root branch is the last one, a mutation on it as well is a flip rather than an incompatibility
+        bool flipped = branches.rbegin()->upper_node == root;
+        if (!flipped or branches.size() > 2) {
+            num_incompatible += sign;
+        }
+        if (flipped) {
+            num_flipped += sign;
         }
     }
-    return count;
+}
+
+void ARG::recount_mutations() {
+    num_incompatible = 0;
+    num_flipped = 0;
+    for (auto &x : mutation_branches) {
+        tally_mutation(x.second, 1);
+    }
 }
 
 void ARG::read_coordinates(string filename) {
@@ -503,21 +631,38 @@ void ARG::write_coordinates(string filename) {
 }
 
 void ARG::write(string node_file, string branch_file) {
-    write_nodes(node_file);
-    write_branches(branch_file);
+    get_tables().write(node_file, branch_file, "", "");
 }
 
 void ARG::write(string node_file, string branch_file, string recomb_file) {
-    write_nodes(node_file);
-    write_branches(branch_file);
-    write_recombs(recomb_file);
+    get_tables().write(node_file, branch_file, recomb_file, "");
 }
 
 void ARG::write(string node_file, string branch_file, string recomb_file, string mutation_file) {
-    write_nodes(node_file);
-    write_branches(branch_file);
-    write_recombs(recomb_file);
-    write_mutations(mutation_file);
+    get_tables().write(node_file, branch_file, recomb_file, mutation_file);
+}
+
+ARG_tables ARG::get_tables() {
+    ARG_tables t = ARG_tables();
+    for (Node_ptr n : index_nodes()) {
+        t.node_times.push_back(n->time*Ne);
+    }
+    t.edges = list_edges();
+    for (auto &x : recombinations) {
+        Recombination &r = x.second;
+        if (x.first > 0 and x.first < sequence_length) {
+            t.recombs.push_back({r.pos, r.source_branch.lower_node->index, r.source_branch.upper_node->index, Ne*r.start_time});
+        }
+    }
+    for (auto &x : mutation_branches) {
+        double m = x.first;
+        for (auto &y : x.second) {
+            if (m < sequence_length and m > 0) {
+                t.mutations.push_back({m, y.lower_node->index, y.upper_node->index, y.lower_node->get_state(m)});
+            }
+        }
+    }
+    return t;
 }
 
 void ARG::read(string node_file, string branch_file) {
@@ -544,7 +689,6 @@ void ARG::read(string node_file, string branch_file, string recomb_file, string
 
 void ARG::impute_nodes(double x, double y) {
     Tree start_tree = get_tree_at(x);
-    Branch null_branch = Branch();
     Fitch_reconstruction rc = Fitch_reconstruction(start_tree);
     auto recomb_it = recombinations.upper_bound(x);
     auto mut_it = mutation_sites.lower_bound(x);
@@ -607,31 +751,35 @@ void ARG::map_mutations(double x, double y) {
 void ARG::map_mutation(double x, Branch joining_branch, Branch added_branch) {
     double sl, su, s0, sm;
     Branch new_branch;
-    sl = joining_branch.lower_node->get_state(x);
-    su = joining_branch.upper_node->get_state(x);
-    s0 = added_branch.lower_node->get_state(x);
+    int site = site_index().get_id(x);
+    sl = joining_branch.lower_node->get_state(site);
+    su = joining_branch.upper_node->get_state(site);
+    s0 = added_branch.lower_node->get_state(site);
     if (sl + su + s0 > 1) {
         sm = 1;
     } else {
         sm = 0;
     }
     added_branch.upper_node->write_state(x, sm);
+    set<Branch> &branches = mutation_branches[x];
+    tally_mutation(branches, -1);
     if (sl != su) {
-        mutation_branches[x].erase(joining_branch);
+        branches.erase(joining_branch);
     }
     if (sm != sl) {
         new_branch = Branch(joining_branch.lower_node, added_branch.upper_node);
-        mutation_branches[x].insert(new_branch);
+        branches.insert(new_branch);
     }
     if (sm != su) {
         new_branch = Branch(added_branch.upper_node, joining_branch.upper_node);
-        mutation_branches[x].insert(new_branch);
+        branches.insert(new_branch);
     }
     if (sm != s0) {
-        mutation_branches[x].insert(added_branch);
+        branches.insert(added_branch);
     }
-    for (const Branch &b : mutation_branches[x]) {
-        assert(b.lower_node->get_state(x) != b.upper_node->get_state(x));
+    tally_mutation(branches, 1);
+    for (const Branch &b : branches) {
+        assert(b.lower_node->get_state(site) != b.upper_node->get_state(site));
     }
 }
 
@@ -661,17 +809,19 @@ void ARG::remap_mutations() {
         assert(removed_branch != Branch());
         lower_branch = Branch(joining_branch.lower_node, joining_node);
         upper_branch = Branch(joining_node, joining_branch.upper_node);
+        tally_mutation(mut_it->second, -1);
         mut_it->second.erase(removed_branch);
         mut_it->second.erase(lower_branch);
         mut_it->second.erase(upper_branch);
-        double sl = lower_branch.lower_node->get_state(mut_it->first);
-        double su = upper_branch.upper_node->get_state(mut_it->first);
+        int site = site_index().get_id(mut_it->first);
+        double sl = lower_branch.lower_node->get_state(site);
+        double su = upper_branch.upper_node->get_state(site);
         if (sl != su) {
             mut_it->second.insert(joining_branch);
         }
+        tally_mutation(mut_it->second, 1);
         for (const Branch &b : mut_it->second) {
-            double m = mut_it->first;
-            assert(b.lower_node->get_state(m) != b.upper_node->get_state(m));
+            assert(b.lower_node->get_state(site) != b.upper_node->get_state(site));
         }
         mut_it++;
     }
@@ -681,14 +831,18 @@ void ARG::map_mutation(Tree tree, double x) {
     set<Branch> branches = {};
     double sl = 0;
     double su = 0;
+    int site = site_index().get_id(x);
     for (auto &y : tree.parents) {
-        sl = y.first->get_state(x);
-        su = y.second->get_state(x);
+        sl = y.first->get_state(site);
+        su = y.second->get_state(site);
         if (sl != su) {
             branches.insert({Branch(y.first, y.second)});
         }
     }
-    mutation_branches[x] = branches;
+    set<Branch> &mapped_branches = mutation_branches[x];
+    tally_mutation(mapped_branches, -1);
+    mapped_branches.swap(branches);
+    tally_mutation(mapped_branches, 1);
 }
 
 void ARG::check_mapping() {
@@ -723,41 +877,11 @@ void ARG::check_mapping() {
 }
 
 int ARG::num_unmapped() {
-    int count = 0;
-    for (auto &x : mutation_branches) {
-        set<Branch> &branches = x.second;
-        if (branches.size() > 1) {
-            if (branches.rbegin()->upper_node == root) {
-                if (branches.size() > 2) {
-                    count += 1;
-                }
-            } else {
-                if (branches.size() > 1) {
-                    count += 1;
-                }
-            }
-        }
-    }
-    return count;
+    return num_incompatible;
 }
 
 void ARG::check_incompatibility() {
-    int count = 0;
-    for (auto &x : mutation_branches) {
-        set<Branch> &branches = x.second;
-        if (branches.size() > 1) {
-            if (branches.rbegin()->upper_node == root) {
-                if (branches.size() > 2) {
-                    count += 1;
-                }
-            } else {
-                if (branches.size() > 1) {
-                    count += 1;
-                }
-            }
-        }
-    }
-    cout << "Number of incompatibilities: " << count << endl;
+    cout << "Number of incompatibilities: " << num_incompatible << endl;
 }
 
 /*
@@ -788,6 +912,59 @@ void ARG::clear_remove_info() {
     // end = 0;
     cut_node = nullptr;
 }
+
+void ARG::mark_nodes() {
+    root->marked = true;
+    if (cut_node != nullptr) {
+        cut_node->marked = true;
+    }
+    for (Node_ptr n : sample_nodes) {
+        n->marked = true;
+    }
+    for (Node_ptr n : node_set) {
+        n->marked = true;
+    }
+    for (auto &x : recombinations) {
+        Recombination &r = x.second;
+        mark_branch(r.source_branch);
+        mark_branch(r.target_branch);
+        mark_branch(r.source_sister_branch);
+        mark_branch(r.source_parent_branch);
+        mark_branch(r.recombined_branch);
+        mark_branch(r.merging_branch);
+        mark_branch(r.lower_transfer_branch);
+        mark_branch(r.upper_transfer_branch);
+        if (r.deleted_node != nullptr) {
+            r.deleted_node->marked = true;
+        }
+        if (r.inserted_node != nullptr) {
+            r.inserted_node->marked = true;
+        }
+        for (const Branch &b : r.deleted_branches) {
+            mark_branch(b);
+        }
+        for (const Branch &b : r.inserted_branches) {
+            mark_branch(b);
+        }
+    }
+    for (auto &x : mutation_branches) {
+        for (const Branch &b : x.second) {
+            mark_branch(b);
+        }
+    }
+    for (auto &x : joining_branches) {
+        mark_branch(x.second);
+    }
+    for (auto &x : removed_branches) {
+        mark_branch(x.second);
+    }
+    for (auto &x : tree_map) {
+        mark_tree(x.second);
+    }
+    mark_tree(cut_tree);
+    mark_tree(start_tree);
+    mark_tree(end_tree);
+}
  
 double ARG::smc_prior_likelihood(double r) {
     Tree tree = get_tree_at(0);
@@ -885,7 +1062,6 @@ set<double> ARG::get_check_points() {
 
 bool ARG::check_disjoint_nodes(double x, double y) {
     auto recomb_it = recombinations.lower_bound(x);
-    Node_ptr node = recomb_it->second.deleted_node;
     double t = recomb_it->second.deleted_node->time;
     Branch b = recomb_it->second.merging_branch;
     while (recomb_it->first < y) {
@@ -917,6 +1093,7 @@ void ARG::new_recombination(double pos, Branch prev_added_branch, Branch prev_jo
     Recombination r = Recombination(deleted_branches, inserted_branches);
     r.set_pos(pos);
     recombinations[pos] = r;
+    dirty_recombinations.push_back(pos);
     return;
 }
 
@@ -938,12 +1115,23 @@ void ARG::remove_empty_recombinations() {
     }
 }
 
+vector<double> ARG::take_dirty_recombinations(double x, double y) {
+    sort(dirty_recombinations.begin(), dirty_recombinations.end());
+    dirty_recombinations.erase(unique(dirty_recombinations.begin(), dirty_recombinations.end()), dirty_recombinations.end());
+    auto first = lower_bound(dirty_recombinations.begin(), dirty_recombinations.end(), x);
+    auto last = upper_bound(first, dirty_recombinations.end(), y);
+    vector<double> taken(first, last);
+    dirty_recombinations.erase(first, last);
+    return taken;
+}
+
 int ARG::count_incompatibility(Tree tree, double x) {
     int count = -1;
+    int site = site_index().get_id(x);
     for (auto &y : tree.parents) {
         if (y.second->index >= 0) {
-            int i1 = y.second->get_state(x);
-            int i2 = y.first->get_state(x);
+            int i1 = y.second->get_state(site);
+            int i2 = y.first->get_state(site);
             if (i1 != i2) {
                 count += 1;
             }
@@ -965,24 +1153,42 @@ void ARG::create_node_set() {
     assert(cut_node == nullptr or node_set.count(cut_node) > 0);
 }
 
-void ARG::write_nodes(string filename) {
+void ARG::mark_tree(Tree &tree) {
+    for (auto &x : tree.parents) {
+        x.first->marked = true;
+        x.second->marked = true;
+    }
+}
+
+void ARG::mark_branch(const Branch &b) {
+    if (b.lower_node != nullptr) {
+        b.lower_node->marked = true;
+    }
+    if (b.upper_node != nullptr) {
+        b.upper_node->marked = true;
+    }
+}
+
+vector<Node_ptr> ARG::index_nodes() {
     node_set.clear();
     create_node_set();
-    ofstream file;
-    file.open(filename);
-    int index = 0;
-    for (Node_ptr n : node_set) {
-        if (n->time > 0) {
-            n->set_index(index);
+    vector<Node_ptr> nodes = vector<Node_ptr>(node_set.begin(), node_set.end());
+    for (int i = 0; i < nodes.size(); i++) {
+        if (nodes[i]->time > 0) {
+            nodes[i]->set_index(i);
         }
-        file << std::setprecision(std::numeric_limits<double>::max_digits10) << n->time*Ne << "\n";
-        index += 1;
     }
-    file.close();
     node_set.clear();
+    return nodes;
 }
 
-void ARG::write_branches(string filename) {
+vector<tuple<double, double, double, double>> ARG::get_edges() {
+    vector<tuple<double, double, double, double>> branch_info = list_edges();
+    sort(branch_info.begin(), branch_info.end(), compare_edge);
+    return branch_info;
+}
+
+vector<tuple<double, double, double, double>> ARG::list_edges() {
     map<Branch, double> branch_map;
     vector<tuple<double, double, double, double>> branch_info;
     double pos;
@@ -1011,43 +1217,7 @@ void ARG::write_branches(string filename) {
         // assert(k1 < 1e5 and k2 < 1e5);
         branch_info.push_back({k1, k2, x.second, sequence_length});
     }
-    sort(branch_info.begin(), branch_info.end(), compare_edge);
-    ofstream file;
-    file.open(filename);
-    file << std::setprecision(std::numeric_limits<double>::max_digits10) << std::fixed;
-    for (int i = 0; i < branch_info.size(); i++) {
-        auto [k1, k2, x, l] = branch_info[i];
-        // assert(k1 < 1e5 and k2 < 1e5);
-        file << x << " " << l << " " << k1 << " " << k2 << "\n";
-    }
-    file.close();
-}
-
-void ARG::write_recombs(string filename) {
-    ofstream file;
-    file.open(filename);
-    file << std::setprecision(std::numeric_limits<double>::max_digits10) << std::fixed;
-    for (auto x : recombinations) {
-        Recombination &r = x.second;
-        if (x.first > 0 and x.first < sequence_length) {
-            file << r.pos << " " << r.source_branch.lower_node->index << " " << r.source_branch.upper_node->index << " " << Ne*r.start_time << endl;
-        }
-    }
-    file.close();
-}
-
-void ARG::write_mutations(string filename) {
-    ofstream file;
-    file.open(filename);
-    file.precision(numeric_limits<double>::max_digits10);
-    for (auto &x : mutation_branches) {
-        double m = x.first;
-        for (auto &y : x.second) {
-            if (m < sequence_length and m > 0) {
-                file << m << " " << y.lower_node->index << " " << y.upper_node->index << " " << y.lower_node->get_state(m) << endl;
-            }
-        }
-    }
+    return branch_info;
 }
 
 void ARG::read_nodes(string filename) {
@@ -1092,26 +1262,10 @@ void ARG::read_branches(string filename) {
         }
         child_node = nodes[int(c)];
         b = Branch(child_node, parent_node);
-        if (deleted_branches.count(right) > 0) {
-            deleted_branches[right].insert(b);
-        } else {
-            deleted_branches[right] = {b};
-        }
-        if (inserted_branches.count(left) > 0) {
-            inserted_branches[left].insert(b);
-        } else {
-            inserted_branches[left] = {b};
-        }
-    }
-    deleted_branches.erase(sequence_length);
-    for (auto x : deleted_branches) {
-        double pos = x.first;
-        set<Branch> db = deleted_branches.at(pos);
-        set<Branch> ib = inserted_branches.at(pos);
-        Recombination r = Recombination(db, ib);
-        r.set_pos(pos);
-        recombinations[pos] = r;
+        deleted_branches[right].insert(b);
+        inserted_branches[left].insert(b);
     }
+    set_recombinations(deleted_branches, inserted_branches);
 }
 
 void ARG::read_recombs(string filename) {
@@ -1140,26 +1294,9 @@ void ARG::read_recombs(string filename) {
         }
         b = Branch(ln, un);
         source_branches[pos] = b;
-        start_times[pos] = t;
-    }
-    for (auto &x : recombinations) {
-        pos = x.first;
-        if (pos > 0 and pos < sequence_length) {
-            t = start_times.at(pos);
-            b = source_branches.at(pos);
-            if (pos > 0 and pos < sequence_length) {
-                x.second.start_time = t/Ne;
-                x.second.source_branch = b;
-                x.second.find_nodes();
-                x.second.find_target_branch();
-                x.second.find_recomb_info();
-            }
-        }
-        if (pos > 0 and pos < sequence_length) {
-            assert(x.second.start_time <= x.second.deleted_node->time);
-            assert(x.second.start_time <= x.second.inserted_node->time);
-        }
+        start_times[pos] = t/Ne;
     }
+    set_recomb_sources(source_branches, start_times);
     node_set.clear();
 }
 
@@ -1177,27 +1314,64 @@ void ARG::read_muts(string filename) {
     double s;
     Node_ptr ln;
     Node_ptr un;
-    Branch b;
     while (fin >> pos >> n1 >> n2 >> s) {
         if (pos <= sequence_length) {
-            mutation_sites.insert(pos);
             ln = nodes[n1];
             if (n2 == -1) {
                 un = root;
             } else {
                 un = nodes[n2];
             }
-            if (s == 1) {
-                ln->write_state(pos, 1);
-                un->write_state(pos, 0);
-            } else {
-                un->write_state(pos, 1);
-                ln->write_state(pos, 0);
-            }
-            b = Branch(ln, un);
-            mutation_branches[pos].insert(b);
+            set_mutation(pos, Branch(ln, un), s);
         }
     }
+    impute_mutation_states();
+}
+
+void ARG::set_recombinations(map<double, set<Branch>> &deleted_branches, map<double, set<Branch>> &inserted_branches) {
+    deleted_branches.erase(sequence_length);
+    for (auto x : deleted_branches) {
+        double pos = x.first;
+        set<Branch> db = deleted_branches.at(pos);
+        set<Branch> ib = inserted_branches.at(pos);
+        Recombination r = Recombination(db, ib);
+        r.set_pos(pos);
+        recombinations[pos] = r;
+    }
+    tree_map.clear();
+}
+
+void ARG::set_recomb_sources(map<double, Branch> &source_branches, map<double, double> &start_times) {
+    for (auto &x : recombinations) {
+        double pos = x.first;
+        if (pos > 0 and pos < sequence_length) {
+            x.second.start_time = start_times.at(pos);
+            x.second.source_branch = source_branches.at(pos);
+            x.second.find_nodes();
+            x.second.find_target_branch();
+            x.second.find_recomb_info();
+            assert(x.second.start_time <= x.second.deleted_node->time);
+            assert(x.second.start_time <= x.second.inserted_node->time);
+        }
+    }
+}
+
+void ARG::set_mutation(double pos, Branch b, double s) {
+    mutation_sites.insert(pos);
+    if (s == 1) {
+        b.lower_node->write_state(pos, 1);
+        b.upper_node->write_state(pos, 0);
+    } else {
+        b.upper_node->write_state(pos, 1);
+        b.lower_node->write_state(pos, 0);
+    }
+    set<Branch> &branches = mutation_branches[pos];
+    tally_mutation(branches, -1);
+    branches.insert(b);
+    tally_mutation(branches, 1);
+}
+
+void ARG::impute_mutation_states() {
     Tree tree = Tree();
     auto m_it = mutation_branches.begin();
     auto r_it = recombinations.begin();
@@ -1212,6 +1386,125 @@ void ARG::read_muts(string filename) {
     }
 }
 
+void ARG::write_checkpoint(Checkpoint &c) {
+    vector<Node_ptr> nodes = index_nodes();
+    c.node_times.clear();
+    for (Node_ptr n : nodes) {
+        c.node_times.push_back(n->time);
+    }
+    c.edge_lefts.clear();
+    c.edge_rights.clear();
+    c.edge_parents.clear();
+    c.edge_children.clear();
+    for (auto [k1, k2, x, l] : get_edges()) {
+        c.edge_lefts.push_back(x);
+        c.edge_rights.push_back(l);
+        c.edge_parents.push_back((int) k1);
+        c.edge_children.push_back((int) k2);
+    }
+    c.recomb_positions.clear();
+    c.recomb_lower_nodes.clear();
+    c.recomb_upper_nodes.clear();
+    c.recomb_start_times.clear();
+    for (auto &x : recombinations) {
+        Recombination &r = x.second;
+        if (x.first > 0 and x.first < sequence_length) {
+            c.recomb_positions.push_back(r.pos);
+            c.recomb_lower_nodes.push_back(r.source_branch.lower_node->index);
+            c.recomb_upper_nodes.push_back(r.source_branch.upper_node->index);
+            c.recomb_start_times.push_back(r.start_time);
+        }
+    }
+    c.mutation_positions.clear();
+    c.mutation_lower_nodes.clear();
+    c.mutation_upper_nodes.clear();
+    for (auto &x : mutation_branches) {
+        double m = x.first;
+        for (auto &y : x.second) {
+            if (m < sequence_length and m > 0) {
+                c.mutation_positions.push_back(m);
+                c.mutation_lower_nodes.push_back(y.lower_node->index);
+                c.mutation_upper_nodes.push_back(y.upper_node->index);
+            }
+        }
+    }
+    c.site_positions = site_index().positions;
+    c.genotype_offsets = {0};
+    c.genotype_words.clear();
+    nodes.push_back(root);
+    for (Node_ptr n : nodes) {
+        c.genotype_words.insert(c.genotype_words.end(), n->genotypes.begin(), n->genotypes.end());
+        c.genotype_offsets.push_back(c.genotype_words.size());
+    }
+    c.coordinates = coordinates;
+    c.header.Ne = Ne;
+    c.header.sequence_length = sequence_length;
+    c.header.end = end;
+}
+
+void ARG::read_checkpoint(Checkpoint &c) {
+    root->set_index(-1);
+    node_set.clear();
+    for (double t : c.node_times) {
+        add_new_node(t);
+    }
+    vector<Node_ptr> nodes = vector<Node_ptr>(node_set.begin(), node_set.end());
+    auto get_node = [&](int k) {
+        return k < 0 ? root : nodes[k];
+    };
+    map<double, set<Branch>> deleted_branches = {{0, {}}};
+    map<double, set<Branch>> inserted_branches = {};
+    for (int i = 0; i < c.edge_lefts.size(); i++) {
+        Branch b = Branch(get_node(c.edge_children[i]), get_node(c.edge_parents[i]));
+        deleted_branches[c.edge_rights[i]].insert(b);
+        inserted_branches[c.edge_lefts[i]].insert(b);
+    }
+    set_recombinations(deleted_branches, inserted_branches);
+    map<double, Branch> source_branches = {};
+    map<double, double> start_times = {};
+    for (int i = 0; i < c.recomb_positions.size(); i++) {
+        double pos = c.recomb_positions[i];
+        source_branches[pos] = Branch(get_node(c.recomb_lower_nodes[i]), get_node(c.recomb_upper_nodes[i]));
+        start_times[pos] = c.recomb_start_times[i];
+    }
+    set_recomb_sources(source_branches, start_times);
+    dirty_recombinations.clear();
+    for (int i = 0; i < c.mutation_positions.size(); i++) {
+        double pos = c.mutation_positions[i];
+        mutation_sites.insert(pos);
+        mutation_branches[pos].insert(Branch(get_node(c.mutation_lower_nodes[i]), get_node(c.mutation_upper_nodes[i])));
+    }
+    recount_mutations();
+    mutation_sites.insert(-1); // sentinel added with the samples, counted by Scaler
+    // node states are stored, so there is no imputation; site ids only need remapping if this process numbered the sites differently
+    vector<int> site_ids = vector<int>(c.site_positions.size());
+    bool same_ids = true;
+    for (int j = 0; j < c.site_positions.size(); j++) {
+        site_ids[j] = site_index().add_site(c.site_positions[j]);
+        same_ids = same_ids and site_ids[j] == j;
+    }
+    nodes.push_back(root);
+    for (int i = 0; i < nodes.size(); i++) {
+        const uint64_t *row_begin = c.genotype_words.data() + c.genotype_offsets[i];
+        const uint64_t *row_end = c.genotype_words.data() + c.genotype_offsets[i + 1];
+        if (same_ids) {
+            nodes[i]->genotypes.assign(row_begin, row_end);
+            continue;
+        }
+        nodes[i]->genotypes.clear();
+        for (int w = 0; w < row_end - row_begin; w++) {
+            for (int k = 0; k < 64; k++) {
+                if ((row_begin[w] >> k) & 1) {
+                    nodes[i]->write_state(site_ids[64*w + k], 1);
+                }
+            }
+        }
+    }
+    node_set.clear();
+    coordinates = c.coordinates;
+    bin_num = (int) coordinates.size() - 1;
+}
+
 double ARG::get_arg_length() {
     Tree tree = get_tree_at(0);
     auto recomb_it = recombinations.upper_bound(0);
@@ -1314,7 +1607,7 @@ tuple<double, Branch, double> ARG::sample_internal_cut() {
 }
  */
 
-tuple<double, Branch, double> ARG::sample_internal_cut() {
+tuple<double, Branch, double> ARG::sample_internal_cut(Random_context &rng) {
     if (end >= sequence_length - 0.1) {
         cut_pos = 0;
         cut_tree = get_tree_at(0);
@@ -1325,9 +1618,24 @@ tuple<double, Branch, double> ARG::sample_internal_cut() {
     }
     Branch b;
     double t;
-    tie(b, t) = cut_tree.sample_cut_point();
+    tie(b, t) = cut_tree.sample_cut_point(rng);
+    while (t == b.lower_node->time or t == b.upper_node->time) {
+        tie(b, t) = cut_tree.sample_cut_point(rng);
+    }
+    return {cut_pos, b, t};
+}
+
+tuple<double, Branch, double> ARG::sample_internal_cut(Random_context &rng, double x) {
+    if (x >= sequence_length - 0.1) {
+        x = 0;
+    }
+    cut_pos = x;
+    cut_tree = get_tree_at(x);
+    Branch b;
+    double t;
+    tie(b, t) = cut_tree.sample_cut_point(rng);
     while (t == b.lower_node->time or t == b.upper_node->time) {
-        tie(b, t) = cut_tree.sample_cut_point();
+        tie(b, t) = cut_tree.sample_cut_point(rng);
     }
     return {cut_pos, b, t};
 }
@@ -1348,9 +1656,9 @@ tuple<double, Branch, double> ARG::sample_internal_cut() {
 }
  */
 
-tuple<double, Branch, double> ARG::sample_recombination_cut() {
+tuple<double, Branch, double> ARG::sample_recombination_cut(Random_context &rng) {
     auto recomb_it = recombinations.begin();
-    double p = uniform_random();
+    double p = rng.uniform();
     int dist = (recombinations.size() - 2)*p;
     dist = max(dist, 1);
     advance(recomb_it, dist);
@@ -1363,7 +1671,7 @@ tuple<double, Branch, double> ARG::sample_recombination_cut() {
     return {x, r.recombined_branch, t};
 }
 
-tuple<double, Branch, double> ARG::sample_mutation_cut() {
+tuple<double, Branch, double> ARG::sample_mutation_cut(Random_context &rng) {
     double p = 0;
     double replace_prob = 0;
     int mapping_size = 0;
@@ -1378,10 +1686,10 @@ tuple<double, Branch, double> ARG::sample_mutation_cut() {
             replace_prob = (double) mapping_size/(mapping_size + count);
             count += mb_it->second.size();
         }
-        p = uniform_random();
+        p = rng.uniform();
         if (p < replace_prob) {
             auto b_it = mb_it->second.begin();
-            advance(b_it, (mapping_size - 1)*uniform_random());
+            advance(b_it, (mapping_size - 1)*rng.uniform());
             b = *b_it;
             x = mb_it->first;
             t = b.lower_node->time + 1e-3;
@@ -1394,11 +1702,11 @@ tuple<double, Branch, double> ARG::sample_mutation_cut() {
     return {x, b, t};
 }
 
-tuple<double, Branch, double> ARG::sample_terminal_cut() {
+tuple<double, Branch, double> ARG::sample_terminal_cut(Random_context &rng) {
     Branch branch;
     double time = 1e-10;
     vector<Node_ptr > nodes = vector<Node_ptr >(sample_nodes.begin(), sample_nodes.end());
-    int index = rand() % nodes.size();
+    int index = rng() % nodes.size();
     Node_ptr terminal_node = nodes[index];
     cut_tree = get_tree_at(0);
     for (auto &x : cut_tree.parents) {
@@ -1410,6 +1718,70 @@ tuple<double, Branch, double> ARG::sample_terminal_cut() {
     return {0, branch, time};
 }
 
+void ARG_tables::write(string node_file, string branch_file, string recomb_file, string mutation_file) {
+    // every file is written next to its target and renamed once all are complete, so a sample is either all there or not at all
+    if (node_file != "") {
+        write_nodes(node_file + ".tmp");
+    }
+    if (branch_file != "") {
+        write_branches(branch_file + ".tmp");
+    }
+    if (recomb_file != "") {
+        write_recombs(recomb_file + ".tmp");
+    }
+    if (mutation_file != "") {
+        write_mutations(mutation_file + ".tmp");
+    }
+    vector<string> filenames = {node_file, branch_file, recomb_file, mutation_file};
+    for (string &filename : filenames) {
+        if (filename != "" and rename((filename + ".tmp").c_str(), filename.c_str()) != 0) {
+            cerr << "Error writing the file: " << filename << endl;
+            exit(1);
+        }
+    }
+}
+
+void ARG_tables::write_nodes(string filename) {
+    ofstream file;
+    file.open(filename);
+    for (double t : node_times) {
+        file << std::setprecision(std::numeric_limits<double>::max_digits10) << t << "\n";
+    }
+    file.close();
+}
+
+void ARG_tables::write_branches(string filename) {
+    sort(edges.begin(), edges.end(), compare_edge);
+    ofstream file;
+    file.open(filename);
+    file << std::setprecision(std::numeric_limits<double>::max_digits10) << std::fixed;
+    for (int i = 0; i < edges.size(); i++) {
+        auto [k1, k2, x, l] = edges[i];
+        file << x << " " << l << " " << k1 << " " << k2 << "\n";
+    }
+    file.close();
+}
+
+void ARG_tables::write_recombs(string filename) {
+    ofstream file;
+    file.open(filename);
+    file << std::setprecision(std::numeric_limits<double>::max_digits10) << std::fixed;
+    for (auto [x, k1, k2, t] : recombs) {
+        file << x << " " << k1 << " " << k2 << " " << t << "\n";
+    }
+    file.close();
+}
+
+void ARG_tables::write_mutations(string filename) {
+    ofstream file;
+    file.open(filename);
+    file.precision(numeric_limits<double>::max_digits10);
+    for (auto [m, k1, k2, s] : mutations) {
+        file << m << " " << k1 << " " << k2 << " " << s << "\n";
+    }
+    file.close();
+}
+
 bool compare_edge(const tuple<int, int, double, double>& edge1, const tuple<int, int, double, double>& edge2) {
     if (get<0>(edge1) < get<0>(edge2)) {
         return true;
@@ -16,6 +16,48 @@
 #include "Reconstruction.hpp"
 #include "Fitch_reconstruction.hpp"
 #include "Rate_map.hpp"
+#include "Checkpoint.hpp"
+#include "Thread_team.hpp"
+
+// The state ARG::remove leaves behind for one cut, so that cuts in disjoint intervals can all be
+// removed before any of them is added back (see Cut_scheduler).
+class Remove_info {
+    
+public:
+    
+    Node_ptr cut_node = nullptr;
+    double cut_time = 0;
+    double start = 0;
+    double end = 0;
+    double cut_pos = 0;
+    Tree cut_tree;
+    Tree start_tree;
+    Tree end_tree;
+    map<double, Branch> joining_branches = {};
+    map<double, Branch> removed_branches = {};
+};
+
+// The output columns of an ARG, in the order of the text files. Taking them is cheap next to
+// formatting them, so a sampler can hand them to another thread and go on (see Sample_writer).
+class ARG_tables {
+    
+public:
+    
+    vector<double> node_times = {}; // in generations
+    vector<tuple<double, double, double, double>> edges = {}; // (parent, child, left, right), sorted when written
+    vector<tuple<double, int, int, double>> recombs = {}; // (position, lower node, upper node, start time)
+    vector<tuple<double, int, int, double>> mutations = {}; // (position, lower node, upper node, state of the lower node)
+    
+    void write(string node_file, string branch_file, string recomb_file, string mutation_file); // empty names are skipped
+    
+    void write_nodes(string filename);
+    
+    void write_branches(string filename);
+    
+    void write_recombs(string filename);
+    
+    void write_mutations(string filename);
+};
 
 class ARG {
     
@@ -27,7 +69,10 @@ public:
     double cut_time = 0;
     set<double> mutation_sites = {};
     map<double, set<Branch>> mutation_branches = {};
+    int num_incompatible = 0; // sites counted by count_incompatibility, updated with every change of mutation_branches
+    int num_flipped = 0; // sites counted by count_flipping
     map<double, Recombination> recombinations = {};
+    vector<double> dirty_recombinations = {}; // recombinations touched by remove, add and new_recombination that still lack a start time
     int bin_num = 0;
     double sequence_length = 0;
     double bin_size = 0;
@@ -38,7 +83,8 @@ public:
     set<Node_ptr, compare_node> node_set = {};
     map<double, Branch> joining_branches = {};
     map<double, Branch> removed_branches = {};
-    map<double, Tree> tree_map = {};
+    map<double, Tree> tree_map = {}; // tree after the recombination at each key, every tree_spacing breakpoints
+    int tree_spacing = 64;
     
     double start = 0;
     double end = 0;
@@ -71,32 +117,50 @@ public:
     
     Tree get_tree_at(double x);
     
+    void invalidate_trees(double x, double y); // drop the trees in tree_map from x to y, after the recombinations there changed
+    
     Node_ptr get_query_node_at(double x);
     
     Tree modify_tree_to(double x, Tree &reference_tree, double x0);
     
     Tree internal_modify_tree_to(double x, Tree &reference_tree, double x0);
+    
+    Tree internal_modify_tree_to(double x, Tree &reference_tree, double x0, double t); // cut at time t instead of cut_time
 
     void remove(tuple<double, Branch, double> cut_point);
     
     void remove(map<double, Branch> seed_branches);
     
+    pair<double, double> trace_cut(tuple<double, Branch, double> cut_point); // the interval remove would update, without changing the ARG
+    
+    void save_remove_info(Remove_info &r);
+    
+    void load_remove_info(Remove_info &r);
+    
     void remove_leaf(int index);
     
     double get_updated_length();
     
     void add(map<double, Branch> &new_joining_branches, map<double, Branch> &added_branches);
     
-    void smc_sample_recombinations();
+    void smc_sample_recombinations(Random_context &rng);
     
-    void approx_sample_recombinations();
+    void approx_sample_recombinations(); // only the dirty recombinations, in position order
+    
+    void approx_sample_recombinations(double x, double y); // only the dirty recombinations in [x, y]
     
     void adjust_recombinations();
     
+    void adjust_recombinations(Thread_team &team); // the recombinations are independent, so they are shared across the team
+    
     int count_incompatibility();
     
     int count_flipping();
     
+    void tally_mutation(const set<Branch> &branches, int sign); // adds the site to num_incompatible and num_flipped, or removes it
+    
+    void recount_mutations();
+    
     void read_coordinates(string filename);
     
     void write_coordinates(string filename);
@@ -107,25 +171,33 @@ public:
     
     void write(string node_file, string branch_file, string recomb_file, string mutation_file);
     
+    ARG_tables get_tables(); // also assigns the output indices of the nodes
+    
     void read(string node_file, string branch_file);
     
     void read(string node_file, string branch_file, string recomb_file);
     
     void read(string node_file, string branch_file, string recomb_file, string mut_file);
     
+    void write_checkpoint(Checkpoint &c); // fill the ARG columns of a binary checkpoint, sampler fields are left to the caller
+    
+    void read_checkpoint(Checkpoint &c);
+    
     double get_arg_length();
     
     double get_arg_length(double x, double y);
     
     double get_arg_length(map<double, Branch> &new_joining_branches, map<double, Branch> &new_added_branches);
     
-    tuple<double, Branch, double> sample_internal_cut();
+    tuple<double, Branch, double> sample_internal_cut(Random_context &rng);
+    
+    tuple<double, Branch, double> sample_internal_cut(Random_context &rng, double x); // cut the tree at x instead of the end of the last cut
     
-    tuple<double, Branch, double> sample_terminal_cut();
+    tuple<double, Branch, double> sample_terminal_cut(Random_context &rng);
     
-    tuple<double, Branch, double> sample_recombination_cut();
+    tuple<double, Branch, double> sample_recombination_cut(Random_context &rng);
     
-    tuple<double, Branch, double> sample_mutation_cut();
+    tuple<double, Branch, double> sample_mutation_cut(Random_context &rng);
     
     void impute_nodes(double x, double y);
     
@@ -147,6 +219,8 @@ public:
     
     void clear_remove_info();
     
+    void mark_nodes();
+    
     double smc_prior_likelihood(double r);
     
     double data_likelihood(double m);
@@ -165,17 +239,21 @@ public:
     
     void remove_empty_recombinations();
     
+    vector<double> take_dirty_recombinations(double x, double y); // sorted dirty positions in [x, y], the others stay dirty
+    
     int count_incompatibility(Tree tree, double x);
     
     void create_node_set();
     
-    void write_nodes(string filename);
+    void mark_tree(Tree &tree);
     
-    void write_branches(string filename);
+    void mark_branch(const Branch &b);
     
-    void write_recombs(string filename);
+    vector<Node_ptr> index_nodes(); // nodes in output order, with indices assigned to the non-sample nodes
     
-    void write_mutations(string filename);
+    vector<tuple<double, double, double, double>> get_edges(); // (parent, child, left, right) in output order
+    
+    vector<tuple<double, double, double, double>> list_edges(); // same edges, unsorted
     
     void read_nodes(string filename);
     
@@ -185,6 +263,14 @@ public:
     
     void read_muts(string filename);
     
+    void set_recombinations(map<double, set<Branch>> &deleted_branches, map<double, set<Branch>> &inserted_branches);
+    
+    void set_recomb_sources(map<double, Branch> &source_branches, map<double, double> &start_times);
+    
+    void set_mutation(double pos, Branch b, double s);
+    
+    void impute_mutation_states();
+    
 };
 
 bool compare_edge(const tuple<int, int, double, double>& edge1, const tuple<int, int, double, double>& edge2);
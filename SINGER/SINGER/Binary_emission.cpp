@@ -54,6 +54,102 @@ double Binary_emission::emit(Branch &branch, double time, double theta, double b
     return emit_prob;
 }
 
+// Batched kernels: the same arithmetic as the scalar versions above, laid out over arrays of intervals
+
+EMISSION_KERNEL
+static void binary_null_exponents(int dim, const double *times, const double *lower_times, const double *upper_times, double node_time, double theta,
+                                  double *lower_exponents, double *upper_exponents, double *query_exponents, double *old_exponents) {
+    for (int i = 0; i < dim; i++) {
+        double ll = times[i] - lower_times[i];
+        double lu = upper_times[i] - times[i];
+        double l0 = times[i] - node_time;
+        lower_exponents[i] = ll*theta;
+        upper_exponents[i] = isinf(lu) ? numeric_limits<double>::infinity() : lu*theta;
+        query_exponents[i] = l0*theta;
+        old_exponents[i] = isinf(lu) ? numeric_limits<double>::infinity() : theta*(ll + lu);
+    }
+}
+
+EMISSION_KERNEL
+static void binary_null_combine(int dim, const double *lower_probs, const double *upper_probs, const double *query_probs, const double *old_probs, double *emit_probs) {
+    for (int i = 0; i < dim; i++) {
+        double p = 1;
+        p *= lower_probs[i];
+        p *= upper_probs[i];
+        p *= query_probs[i];
+        emit_probs[i] = p/old_probs[i];
+    }
+}
+
+void Binary_emission::null_emit(vector<double> &times, vector<double> &lower_times, vector<double> &upper_times, double theta, Node_ptr node, vector<double> &emit_probs) {
+    int dim = (int) times.size();
+    prepare_null_emit(dim, emit_probs);
+    null_emit(0, dim, times, lower_times, upper_times, theta, node, emit_probs);
+}
+
+void Binary_emission::prepare_null_emit(int dim, vector<double> &emit_probs) {
+    lower_probs.resize(dim);
+    upper_probs.resize(dim);
+    query_probs.resize(dim);
+    old_probs.resize(dim);
+    emit_probs.resize(dim);
+}
+
+void Binary_emission::null_emit(int begin, int end, vector<double> &times, vector<double> &lower_times, vector<double> &upper_times, double theta, Node_ptr node, vector<double> &emit_probs) {
+    int n = end - begin;
+    double *lp = lower_probs.data() + begin;
+    double *up = upper_probs.data() + begin;
+    double *qp = query_probs.data() + begin;
+    double *op = old_probs.data() + begin;
+    // each factor is computed in place from its exponent
+    binary_null_exponents(n, times.data() + begin, lower_times.data() + begin, upper_times.data() + begin, node->time, theta, lp, up, qp, op);
+    compute_null_probs(n, lp, lp);
+    compute_null_probs(n, up, up);
+    compute_null_probs(n, qp, qp);
+    compute_null_probs(n, op, op);
+    binary_null_combine(n, lp, up, qp, op, emit_probs.data() + begin);
+}
+
+void Binary_emission::mut_emit(vector<double> &times, vector<Node_ptr> &lower_nodes, vector<Node_ptr> &upper_nodes, double theta, double bin_size, set<double> &mut_set, Node_ptr node, vector<double> &emit_probs) {
+    int dim = (int) times.size();
+    int num_muts = (int) mut_set.size();
+    get_states(lower_nodes, upper_nodes, mut_set, node);
+    emit_probs.resize(dim);
+    double sl, su, s0, sm = 0;
+    for (int i = 0; i < dim; i++) {
+        fill(diff.begin(), diff.end(), 0);
+        for (int j = 0; j < num_muts; j++) {
+            sl = lower_states[j*dim + i];
+            su = upper_states[j*dim + i];
+            s0 = query_states[j];
+            sm = (sl + su + s0 > 1.5) ? 1 : 0;
+            diff[0] += abs(sm - sl);
+            diff[1] += abs(sm - su);
+            diff[2] += abs(sm - s0);
+            diff[3] += abs(sl - su);
+        }
+        double ll = times[i] - lower_times[i];
+        double lu = upper_times[i] - times[i];
+        double l0 = times[i] - node->time;
+        emit_probs[i] = calculate_prob(theta, bin_size, ll, lu, l0, diff[0], diff[1], diff[2]);
+        emit_probs[i] /= calculate_prob(theta*(ll + lu), bin_size, diff[3]);
+    }
+}
+
+void Binary_emission::emit(vector<double> &times, Branch &branch, double theta, double bin_size, vector<double> &emissions, Node_ptr node, vector<double> &emit_probs) {
+    int dim = (int) times.size();
+    double lower_time = branch.lower_node->time;
+    double upper_time = branch.upper_node->time;
+    emit_probs.resize(dim);
+    for (int i = 0; i < dim; i++) {
+        double ll = times[i] - lower_time;
+        double lu = upper_time - times[i];
+        double l0 = times[i] - node->time;
+        emit_probs[i] = calculate_prob(theta, bin_size, ll, lu, l0, emissions[0], emissions[1], emissions[2]);
+        emit_probs[i] /= calculate_prob(theta*(ll + lu), bin_size, emissions[3]);
+    }
+}
+
 double Binary_emission::calculate_prob(double theta, double bin_size, double ll, double lu, double l0, int sl, int su, int s0) {
     double prob = 1;
     prob *= calculate_prob(ll*theta, bin_size, sl);
@@ -78,10 +174,12 @@ void Binary_emission::get_diff(set<double> &mut_set, Branch branch, Node_ptr nod
     double s0 = 0;
     double sm = 0;
     fill(diff.begin(), diff.end(), 0);
+    Site_index &sites = site_index();
     for (double x : mut_set) {
-        sl = branch.lower_node->get_state(x);
-        su = branch.upper_node->get_state(x);
-        s0 = node->get_state(x);
+        int site = sites.get_id(x);
+        sl = branch.lower_node->get_state(site);
+        su = branch.upper_node->get_state(site);
+        s0 = node->get_state(site);
         if (sl + su + s0 > 1.5) {
             sm = 1;
         } else {
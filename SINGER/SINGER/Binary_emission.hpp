@@ -22,6 +22,9 @@ public:
     double penalty = 0.1;
     
     vector<double> diff = vector<double>(4);
+    vector<double> lower_probs = {};
+    vector<double> upper_probs = {};
+    vector<double> query_probs = {};
     
     Binary_emission();
     
@@ -33,6 +36,16 @@ public:
     
     double emit(Branch &branch, double time, double theta, double bin_size, vector<double> &emissions, Node_ptr node) override;
     
+    void null_emit(vector<double> &times, vector<double> &lower_times, vector<double> &upper_times, double theta, Node_ptr node, vector<double> &emit_probs) override;
+    
+    void prepare_null_emit(int dim, vector<double> &emit_probs) override;
+    
+    void null_emit(int begin, int end, vector<double> &times, vector<double> &lower_times, vector<double> &upper_times, double theta, Node_ptr node, vector<double> &emit_probs) override;
+    
+    void mut_emit(vector<double> &times, vector<Node_ptr> &lower_nodes, vector<Node_ptr> &upper_nodes, double theta, double bin_size, set<double> &mut_set, Node_ptr node, vector<double> &emit_probs) override;
+    
+    void emit(vector<double> &times, Branch &branch, double theta, double bin_size, vector<double> &emissions, Node_ptr node, vector<double> &emit_probs) override;
+    
     double calculate_prob(double theta, double bin_size, double ll, double lu, double l0, int sl, int su, int s0);
     
     double calculate_prob(double theta, double bin_size, int s);
@@ -11,7 +11,7 @@
 #include <stdio.h>
 #include "Node.hpp"
 
-using Node_ptr = shared_ptr<Node>;
+using Node_ptr = Node *;
 
 class Branch {
     
@@ -0,0 +1,127 @@
+//
+//  Chain_sampler.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Chain_sampler.hpp"
+
+Chain_sampler::Chain_sampler(Sampler &s, int k) : prototype(s) {
+    num_chains = k;
+}
+
+void Chain_sampler::run(int num_iters, int spacing) {
+    Checkpoint c = Checkpoint();
+    prototype.save_state(c);
+    // the chains only need the snapshot, not the nodes of this thread
+    prototype.arg = ARG();
+    prototype.sample_nodes.clear();
+    prototype.ordered_sample_nodes.clear();
+    prototype.carriers.clear();
+    prototype.mutation_sets.clear();
+    vector<thread> threads = {};
+    for (int k = 0; k < num_chains; k++) {
+        threads.emplace_back([this, k, &c, num_iters, spacing]() {
+            run_chain(k, c, num_iters, spacing);
+        });
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+    write_log();
+}
+
+void Chain_sampler::run_chain(int k, Checkpoint &c, int num_iters, int spacing) {
+    cout << get_time() << " Chain " << k << " started" << endl;
+    Sampler sampler = prototype;
+    sampler.set_output_file_prefix(chain_prefix(k));
+    sampler.restore_state(c);
+    sampler.rng = sampler.rng.split(k);
+    sampler.start_log();
+    if (sampler.fast_mode) {
+        sampler.fast_internal_sample(num_iters, spacing);
+    } else {
+        sampler.internal_sample(num_iters, spacing);
+    }
+    cout << get_time() << " Chain " << k << " finished" << endl;
+}
+
+string Chain_sampler::chain_prefix(int k) {
+    return prototype.output_prefix + "_chain_" + to_string(k);
+}
+
+void Chain_sampler::write_log() {
+    string filename = prototype.output_prefix + "_chains.log";
+    ofstream file(filename, ios::out|ios::trunc);
+    if (!file) {
+        cerr << "Error opening the file: " << filename << endl;
+        return;
+    }
+    file << "Chain" << "\t"
+    << "Iteration" << "\t"
+    << "#Recombinations" << "\t"
+    << "#Mutations_not_uniquely_mapped" << endl;
+    vector<vector<double>> recombs = vector<vector<double>>(num_chains);
+    vector<vector<double>> unmapped = vector<vector<double>>(num_chains);
+    for (int k = 0; k < num_chains; k++) {
+        ifstream chain_file(chain_prefix(k) + ".log");
+        string line;
+        while (getline(chain_file, line)) {
+            istringstream words(line);
+            string time, iteration, type, num_recombs, num_unmapped;
+            words >> time >> iteration >> type >> num_recombs >> num_unmapped;
+            if (type != "rethread") {
+                continue;
+            }
+            file << k << "\t" << iteration << "\t" << num_recombs << "\t" << num_unmapped << endl;
+            recombs[k].push_back(stod(num_recombs));
+            unmapped[k].push_back(stod(num_unmapped));
+        }
+    }
+    cout << "Gelman-Rubin R-hat, #recombinations: " << r_hat_text(recombs);
+    cout << ", #mutations not uniquely mapped: " << r_hat_text(unmapped) << endl;
+}
+
+string Chain_sampler::r_hat_text(vector<vector<double>> &chains) {
+    double r_hat = gelman_rubin(chains);
+    if (isnan(r_hat)) {
+        return "undefined";
+    }
+    ostringstream text;
+    text << r_hat;
+    return text.str();
+}
+
+double Chain_sampler::gelman_rubin(vector<vector<double>> &chains) {
+    int m = (int) chains.size();
+    int n = INT_MAX;
+    for (vector<double> &x : chains) {
+        n = min(n, (int) x.size()/2);
+    }
+    if (m < 2 or n < 2) {
+        return numeric_limits<double>::quiet_NaN();
+    }
+    vector<double> means = vector<double>(m, 0);
+    double within = 0;
+    for (int k = 0; k < m; k++) {
+        vector<double> &x = chains[k];
+        int size = (int) x.size();
+        for (int i = size - n; i < size; i++) {
+            means[k] += x[i]/n;
+        }
+        for (int i = size - n; i < size; i++) {
+            within += (x[i] - means[k])*(x[i] - means[k])/(n - 1)/m;
+        }
+    }
+    double grand_mean = accumulate(means.begin(), means.end(), 0.0)/m;
+    double between = 0;
+    for (double mean : means) {
+        between += n*(mean - grand_mean)*(mean - grand_mean)/(m - 1);
+    }
+    if (within == 0) {
+        return numeric_limits<double>::quiet_NaN();
+    }
+    double pooled = (n - 1.0)/n*within + between/n;
+    return sqrt(pooled/within);
+}
@@ -0,0 +1,43 @@
+//
+//  Chain_sampler.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Chain_sampler_hpp
+#define Chain_sampler_hpp
+
+#include <stdio.h>
+#include <thread>
+#include "Sampler.hpp"
+
+// Runs K independent MCMC chains from one loaded dataset and one initial ARG. The state of the
+// prototype sampler is taken once as an in-memory checkpoint, which every chain reads to build
+// its own nodes on its own thread (imputation and node collection write to every node they
+// visit, so nodes cannot be shared between chains, only the snapshot they are built from).
+// Chain k draws from stream k of the generator and writes to <output>_chain_<k>, so chain 0
+// reproduces a single-chain run. The per-chain statistics are collected into <output>_chains.log.
+class Chain_sampler {
+
+public:
+
+    Sampler prototype; // data and initial ARG shared by all chains
+    int num_chains = 1;
+
+    Chain_sampler(Sampler &s, int k);
+
+    void run(int num_iters, int spacing);
+
+    void run_chain(int k, Checkpoint &c, int num_iters, int spacing);
+
+    string chain_prefix(int k);
+
+    void write_log();
+
+    double gelman_rubin(vector<vector<double>> &chains); // potential scale reduction over the second half of each chain
+
+    string r_hat_text(vector<vector<double>> &chains); // "undefined" when there are too few samples or no within-chain variance
+};
+
+#endif /* Chain_sampler_hpp */
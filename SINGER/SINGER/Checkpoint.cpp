@@ -0,0 +1,138 @@
+//
+//  Checkpoint.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Checkpoint.hpp"
+
+static const char checkpoint_magic[8] = {'S', 'I', 'N', 'G', 'E', 'R', 'C', 'K'};
+static const uint32_t checkpoint_byte_order = 0x01020304;
+
+template<class T>
+void Checkpoint::write_column(ofstream &file, const vector<T> &column) {
+    size_t size = column.size()*sizeof(T);
+    file.write((const char *) column.data(), size);
+    static const char padding[8] = {};
+    file.write(padding, (8 - size % 8) % 8);
+}
+
+template<class T>
+void Checkpoint::read_column(const char *&p, const char *end, vector<T> &column, int64_t n) {
+    size_t size = n*sizeof(T);
+    if (n < 0 or p + size > end) {
+        cerr << "checkpoint file is truncated" << endl;
+        exit(1);
+    }
+    column.resize(n);
+    memcpy(column.data(), p, size);
+    p += size + (8 - size % 8) % 8;
+}
+
+void Checkpoint::write(string filename) {
+    memcpy(header.magic, checkpoint_magic, 8);
+    header.version = version;
+    header.byte_order = checkpoint_byte_order;
+    header.num_nodes = node_times.size();
+    header.num_edges = edge_lefts.size();
+    header.num_recombs = recomb_positions.size();
+    header.num_mutations = mutation_positions.size();
+    header.num_coordinates = coordinates.size();
+    header.num_sites = site_positions.size();
+    header.num_genotype_words = genotype_words.size();
+    header.rng_length = rng_state.size();
+    string temp_filename = filename + ".tmp";
+    ofstream file(temp_filename, ios::out|ios::binary|ios::trunc);
+    if (!file) {
+        cerr << "Error opening the file: " << temp_filename << endl;
+        exit(1);
+    }
+    file.write((const char *) &header, sizeof(header));
+    write_column(file, node_times);
+    write_column(file, edge_lefts);
+    write_column(file, edge_rights);
+    write_column(file, edge_parents);
+    write_column(file, edge_children);
+    write_column(file, recomb_positions);
+    write_column(file, recomb_lower_nodes);
+    write_column(file, recomb_upper_nodes);
+    write_column(file, recomb_start_times);
+    write_column(file, mutation_positions);
+    write_column(file, mutation_lower_nodes);
+    write_column(file, mutation_upper_nodes);
+    write_column(file, site_positions);
+    write_column(file, genotype_offsets);
+    write_column(file, genotype_words);
+    write_column(file, coordinates);
+    write_column(file, vector<char>(rng_state.begin(), rng_state.end()));
+    file.close();
+    if (!file) {
+        cerr << "Error writing the file: " << temp_filename << endl;
+        exit(1);
+    }
+    // replace the previous file only once the new one is complete
+    if (rename(temp_filename.c_str(), filename.c_str()) != 0) {
+        cerr << "Error renaming the file: " << temp_filename << endl;
+        exit(1);
+    }
+}
+
+void Checkpoint::read(string filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "input file not found" << endl;
+        exit(1);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_t length = st.st_size;
+    if (length < sizeof(header)) {
+        cerr << "checkpoint file is truncated" << endl;
+        exit(1);
+    }
+    void *data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        cerr << "Error mapping the file: " << filename << endl;
+        exit(1);
+    }
+    const char *p = (const char *) data;
+    const char *end = p + length;
+    memcpy(&header, p, sizeof(header));
+    p += sizeof(header);
+    if (memcmp(header.magic, checkpoint_magic, 8) != 0 or header.byte_order != checkpoint_byte_order) {
+        cerr << "not a checkpoint file for this machine: " << filename << endl;
+        exit(1);
+    }
+    if (header.version != version) {
+        cerr << "unsupported checkpoint version " << header.version << ": " << filename << endl;
+        exit(1);
+    }
+    read_column(p, end, node_times, header.num_nodes);
+    read_column(p, end, edge_lefts, header.num_edges);
+    read_column(p, end, edge_rights, header.num_edges);
+    read_column(p, end, edge_parents, header.num_edges);
+    read_column(p, end, edge_children, header.num_edges);
+    read_column(p, end, recomb_positions, header.num_recombs);
+    read_column(p, end, recomb_lower_nodes, header.num_recombs);
+    read_column(p, end, recomb_upper_nodes, header.num_recombs);
+    read_column(p, end, recomb_start_times, header.num_recombs);
+    read_column(p, end, mutation_positions, header.num_mutations);
+    read_column(p, end, mutation_lower_nodes, header.num_mutations);
+    read_column(p, end, mutation_upper_nodes, header.num_mutations);
+    read_column(p, end, site_positions, header.num_sites);
+    read_column(p, end, genotype_offsets, header.num_nodes + 2);
+    read_column(p, end, genotype_words, header.num_genotype_words);
+    for (int i = 0; i + 1 < genotype_offsets.size(); i++) {
+        if (genotype_offsets[i] > genotype_offsets[i + 1] or genotype_offsets[i + 1] > header.num_genotype_words) {
+            cerr << "checkpoint file is corrupted: " << filename << endl;
+            exit(1);
+        }
+    }
+    read_column(p, end, coordinates, header.num_coordinates);
+    vector<char> rng_chars;
+    read_column(p, end, rng_chars, header.rng_length);
+    rng_state = string(rng_chars.begin(), rng_chars.end());
+    munmap(data, length);
+}
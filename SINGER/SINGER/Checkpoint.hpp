@@ -0,0 +1,97 @@
+//
+//  Checkpoint.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Checkpoint_hpp
+#define Checkpoint_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Binary checkpoint of an ARG sample and the sampler state to resume from it. The file is a
+// fixed header followed by one column per field, each padded to 8 bytes, so a reader maps the
+// file and copies every column out in a single pass. Times are stored unscaled, so a sample
+// read back from a checkpoint is identical to the one written.
+struct Checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    double Ne;
+    double sequence_length;
+    double end;
+    int64_t sample_index;
+    int64_t random_seed;
+    int64_t counter;
+    int64_t num_nodes;
+    int64_t num_edges;
+    int64_t num_recombs;
+    int64_t num_mutations;
+    int64_t num_coordinates;
+    int64_t num_sites;
+    int64_t num_genotype_words;
+    int64_t rng_length;
+};
+
+class Checkpoint {
+
+public:
+
+    static const uint32_t version = 2; // 1 stored the mt19937 state, 2 the Random_context state
+
+    Checkpoint_header header = {};
+
+    // nodes, in the order of their indices
+    vector<double> node_times = {};
+
+    // edges: span, parent and child index (-1 is the root)
+    vector<double> edge_lefts = {};
+    vector<double> edge_rights = {};
+    vector<int> edge_parents = {};
+    vector<int> edge_children = {};
+
+    // recombinations: position, source branch and start time
+    vector<double> recomb_positions = {};
+    vector<int> recomb_lower_nodes = {};
+    vector<int> recomb_upper_nodes = {};
+    vector<double> recomb_start_times = {};
+
+    // mutations: position and branch
+    vector<double> mutation_positions = {};
+    vector<int> mutation_lower_nodes = {};
+    vector<int> mutation_upper_nodes = {};
+
+    // node genotypes as bit rows over the sites, in node order with the root last
+    vector<double> site_positions = {};
+    vector<int64_t> genotype_offsets = {};
+    vector<uint64_t> genotype_words = {};
+
+    vector<double> coordinates = {};
+
+    string rng_state = ""; // random engine in its text serialization
+
+    void write(string filename);
+
+    void read(string filename);
+
+    template<class T>
+    void write_column(ofstream &file, const vector<T> &column);
+
+    template<class T>
+    void read_column(const char *&p, const char *end, vector<T> &column, int64_t n);
+};
+
+#endif /* Checkpoint_hpp */
@@ -0,0 +1,38 @@
+//
+//  Coalescent_prior.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Coalescent_prior_hpp
+#define Coalescent_prior_hpp
+
+#include <stdio.h>
+#include "Branch.hpp"
+#include "Tree.hpp"
+#include "Recombination.hpp"
+
+// Prior of the time at which the threaded lineage joins a branch above cut_time, as used by the
+// BSP engines. approx_coalescent_calculator keeps the number of lineages at cut_time and
+// approximates how it decreases; fast_coalescent_calculator keeps the exact coalescence times.
+class Coalescent_prior {
+
+public:
+
+    virtual ~Coalescent_prior() {}
+
+    virtual void start(set<Branch> &branches) = 0;
+
+    virtual void start(Tree &tree) = 0;
+
+    virtual void update(Recombination &r) = 0;
+
+    virtual double prob(double x, double y) = 0; // joining a given branch in [x, y]
+
+    virtual double find_median(double x, double y) = 0;
+
+    virtual pair<double, double> compute_time_weights(double x, double y) = 0; // a representative joining time in [x, y] and its weight
+};
+
+#endif /* Coalescent_prior_hpp */
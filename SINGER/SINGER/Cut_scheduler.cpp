@@ -0,0 +1,129 @@
+//
+//  Cut_scheduler.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Cut_scheduler.hpp"
+
+Cut_scheduler::Cut_scheduler(Threader_smc &prototype, int n, bool fast) {
+    num_threads = n;
+    fast_mode = fast;
+    contexts = vector<Random_context>(num_threads);
+    cuts = vector<Remove_info>(num_threads);
+    cut_points = vector<tuple<double, Branch, double>>(num_threads);
+    lanes = vector<double>(num_threads, 0);
+    threaders = vector<Threader_smc>(num_threads, prototype);
+    for (int k = 0; k < num_threads; k++) {
+        Threader_smc &threader = threaders[k];
+        // the emissions keep scratch space, so every lane needs its own
+        threader.pe = make_shared<Polar_emission>(*prototype.pe);
+        threader.be = make_shared<Binary_emission>(*prototype.be);
+        threader.set_bsp_threads(1);
+        threader.set_random_context(contexts[k]);
+    }
+    // the helpers read the site ids of this thread, which do not change while sampling
+    Site_index &sites = site_index();
+    team = make_shared<Thread_team>(num_threads, [&sites]() {
+        site_index() = sites;
+    });
+    team->block_size = 1;
+}
+
+void Cut_scheduler::start(ARG &a) {
+    double x = a.end;
+    if (x >= a.sequence_length - 0.1) {
+        x = 0;
+    }
+    for (int k = 0; k < num_threads; k++) {
+        lanes[k] = x + k*a.sequence_length/num_threads;
+        if (lanes[k] >= a.sequence_length) {
+            lanes[k] -= a.sequence_length;
+        }
+    }
+}
+
+double Cut_scheduler::rethread(ARG &a, Random_context &rng) {
+    plan(a, rng);
+    for (int k : batch) {
+        a.load_remove_info(cuts[k]);
+        threaders[k].remove_cut(a, cut_points[k]);
+        a.save_remove_info(cuts[k]);
+    }
+    team->run((int) batch.size(), [this, &a](int x, int y) {
+        for (int i = x; i < y; i++) {
+            Threader_smc &threader = threaders[batch[i]];
+            if (fast_mode) {
+                threader.fast_sample_threading(a);
+            } else {
+                threader.sample_threading(a);
+            }
+        }
+    });
+    double updated_length = 0;
+    for (int k : batch) {
+        Threader_smc &threader = threaders[k];
+        a.load_remove_info(cuts[k]);
+        threader.commit_cut(a);
+        updated_length += a.coordinates[threader.end_index] - a.coordinates[threader.start_index];
+        lanes[k] = a.end;
+        record_cost(threader);
+    }
+    for (int k : deferred) {
+        Threader_smc &threader = threaders[k];
+        threader.reset();
+        tuple<double, Branch, double> cut_point = a.sample_internal_cut(contexts[k], lanes[k]);
+        if (fast_mode) {
+            threader.fast_internal_rethread(a, cut_point);
+        } else {
+            threader.internal_rethread(a, cut_point);
+        }
+        updated_length += a.coordinates[threader.end_index] - a.coordinates[threader.start_index];
+        lanes[k] = a.end;
+        record_cost(threader);
+        a.clear_remove_info();
+    }
+    num_batched += batch.size();
+    num_deferred += deferred.size();
+    return updated_length;
+}
+
+void Cut_scheduler::plan(ARG &a, Random_context &rng) {
+    batch.clear();
+    deferred.clear();
+    vector<pair<double, double>> intervals = {};
+    for (int k = 0; k < num_threads; k++) {
+        threaders[k].reset();
+        contexts[k].seed(rng(), k);
+        cut_points[k] = a.sample_internal_cut(rng, lanes[k]);
+        pair<double, double> interval = a.trace_cut(cut_points[k]);
+        if (overlaps(interval, intervals)) {
+            deferred.push_back(k);
+        } else {
+            intervals.push_back(interval);
+            batch.push_back(k);
+            a.save_remove_info(cuts[k]); // keeps the cut tree for remove
+        }
+    }
+}
+
+void Cut_scheduler::record_cost(Threader_smc &threader) {
+    pruner_time += threader.pruner_time;
+    forward_time += threader.forward_time;
+    traceback_time += threader.traceback_time;
+    tsp_time += threader.tsp_time;
+    add_time += threader.add_time;
+    recombination_time += threader.recombination_time;
+    forward_memory = max(forward_memory, threader.forward_memory);
+}
+
+bool Cut_scheduler::overlaps(pair<double, double> interval, vector<pair<double, double>> &intervals) {
+    // intervals that share an end point share the recombination there, which both cuts update
+    for (pair<double, double> &other : intervals) {
+        if (interval.first <= other.second and other.first <= interval.second) {
+            return true;
+        }
+    }
+    return false;
+}
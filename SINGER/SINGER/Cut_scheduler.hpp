@@ -0,0 +1,60 @@
+//
+//  Cut_scheduler.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Cut_scheduler_hpp
+#define Cut_scheduler_hpp
+
+#include <stdio.h>
+#include "Threader_smc.hpp"
+#include "Thread_team.hpp"
+
+// Rethreads several internal cuts at once. A cut normally starts where the last one ended, so
+// consecutive cuts always depend on each other; instead the sequence is walked by K lanes that
+// start evenly spaced from the end of the last cut. Every batch samples one cut per lane and
+// traces the interval each would update. The lanes whose intervals are disjoint from those of the
+// lanes before them are removed one after another, their BSP and TSP passes run on a thread team
+// and their threadings are added back in lane order. A lane that overlaps is rethreaded on its own
+// after the batch, as in the serial sampler. Each lane draws from its own stream, so the result
+// depends on K but not on the timing of the threads.
+class Cut_scheduler {
+
+public:
+
+    int num_threads = 1;
+    bool fast_mode = false;
+    vector<Threader_smc> threaders = {};
+    vector<Random_context> contexts = {};
+    vector<Remove_info> cuts = {};
+    vector<tuple<double, Branch, double>> cut_points = {};
+    vector<double> lanes = {}; // position of the next cut of each lane
+    vector<int> batch = {}; // lanes sampled concurrently
+    vector<int> deferred = {}; // lanes that overlap an earlier lane of the batch
+    shared_ptr<Thread_team> team = nullptr;
+    int num_batched = 0;
+    int num_deferred = 0;
+    double pruner_time = 0;
+    double forward_time = 0;
+    double traceback_time = 0;
+    double tsp_time = 0;
+    double add_time = 0;
+    double recombination_time = 0;
+    size_t forward_memory = 0;
+
+    Cut_scheduler(Threader_smc &prototype, int n, bool fast);
+
+    void start(ARG &a); // place the lanes from the end of the last cut
+
+    double rethread(ARG &a, Random_context &rng); // one batch, returns the length updated
+
+    void plan(ARG &a, Random_context &rng);
+
+    void record_cost(Threader_smc &threader);
+
+    bool overlaps(pair<double, double> interval, vector<pair<double, double>> &intervals);
+};
+
+#endif /* Cut_scheduler_hpp */
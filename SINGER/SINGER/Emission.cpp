@@ -6,3 +6,42 @@
 //
 
 #include "Emission.hpp"
+
+void Emission::get_states(vector<Node_ptr> &lower_nodes, vector<Node_ptr> &upper_nodes, set<double> &mut_set, Node_ptr node) {
+    int dim = (int) lower_nodes.size();
+    int num_muts = (int) mut_set.size();
+    Site_index &sites = site_index();
+    lower_times.resize(dim);
+    upper_times.resize(dim);
+    lower_states.resize(num_muts*dim);
+    upper_states.resize(num_muts*dim);
+    query_states.resize(num_muts);
+    for (int i = 0; i < dim; i++) {
+        lower_times[i] = lower_nodes[i]->time;
+        upper_times[i] = upper_nodes[i]->time;
+    }
+    int j = 0;
+    for (double m : mut_set) {
+        int site = sites.get_id(m);
+        double *ls = &lower_states[j*dim];
+        double *us = &upper_states[j*dim];
+        for (int i = 0; i < dim; i++) {
+            ls[i] = lower_nodes[i]->get_state(site);
+            us[i] = upper_nodes[i]->get_state(site);
+        }
+        query_states[j] = node->get_state(site);
+        j += 1;
+    }
+}
+
+void Emission::compute_null_probs(vector<double> &exponents, vector<double> &probs) {
+    int dim = (int) exponents.size();
+    probs.resize(dim);
+    compute_null_probs(dim, exponents.data(), probs.data());
+}
+
+void Emission::compute_null_probs(int n, const double *exponents, double *probs) {
+    for (int i = 0; i < n; i++) {
+        probs[i] = isinf(exponents[i]) ? 1.0 : exp(-exponents[i]);
+    }
+}
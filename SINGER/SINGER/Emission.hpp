@@ -12,6 +12,13 @@
 #include "Branch.hpp"
 #include "ARG.hpp"
 
+// Batched kernels are compiled for several instruction sets and dispatched at load time
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+#define EMISSION_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define EMISSION_KERNEL
+#endif
+
 class Emission {
     
 public:
@@ -19,6 +26,31 @@ public:
     virtual double null_emit(Branch &branch, double time, double theta, Node_ptr node) = 0;
     virtual double mut_emit(Branch &branch, double time, double theta, double bin_size, set<double> &mut_set, Node_ptr node) = 0;
     virtual double emit(Branch &branch, double time, double theta, double bin_size, vector<double> &emissions, Node_ptr node) = 0;
+    
+    // batched versions over a whole state space, one entry per interval
+    virtual void null_emit(vector<double> &times, vector<double> &lower_times, vector<double> &upper_times, double theta, Node_ptr node, vector<double> &emit_probs) = 0;
+    virtual void mut_emit(vector<double> &times, vector<Node_ptr> &lower_nodes, vector<Node_ptr> &upper_nodes, double theta, double bin_size, set<double> &mut_set, Node_ptr node, vector<double> &emit_probs) = 0;
+    virtual void emit(vector<double> &times, Branch &branch, double theta, double bin_size, vector<double> &emissions, Node_ptr node, vector<double> &emit_probs) = 0;
+    
+    // null emission in two steps, so that disjoint ranges of intervals can be filled on different threads:
+    // prepare_null_emit sizes the output and scratch space, then null_emit(begin, end, ...) fills [begin, end)
+    virtual void prepare_null_emit(int dim, vector<double> &emit_probs) = 0;
+    virtual void null_emit(int begin, int end, vector<double> &times, vector<double> &lower_times, vector<double> &upper_times, double theta, Node_ptr node, vector<double> &emit_probs) = 0;
+    
+    vector<double> lower_times = {};
+    vector<double> upper_times = {};
+    vector<double> lower_states = {};
+    vector<double> upper_states = {};
+    vector<double> query_states = {};
+    vector<double> old_probs = {};
+    vector<double> exponents = {};
+    vector<double> null_probs = {};
+    
+    void get_states(vector<Node_ptr> &lower_nodes, vector<Node_ptr> &upper_nodes, set<double> &mut_set, Node_ptr node);
+    
+    void compute_null_probs(vector<double> &exponents, vector<double> &probs);
+    
+    void compute_null_probs(int n, const double *exponents, double *probs); // may be in place
 };
 
 #endif /* Emission_hpp */
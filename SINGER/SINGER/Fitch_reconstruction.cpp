@@ -14,6 +14,7 @@ Fitch_reconstruction::Fitch_reconstruction(Tree tree) {
 
 void Fitch_reconstruction::reconstruct(double pos) {
     recon_pos = pos;
+    recon_site = site_index().get_id(pos);
     pruning_node_states.clear();
     peeling_node_states.clear();
     for (Node_ptr n : node_set) {
@@ -111,7 +112,7 @@ void Fitch_reconstruction::pruning_pass(Node_ptr n) {
     }
     double s;
     if (children_nodes.count(n) == 0) {
-        s = n->get_state(recon_pos);
+        s = n->get_state(recon_site);
         pruning_node_states.insert({n, s});
         return;
     }
@@ -31,6 +31,7 @@ private:
     map<Node_ptr, double> pruning_node_states = {};
     map<Node_ptr, double> peeling_node_states = {};
     double recon_pos = 0.0f;
+    int recon_site = -1;
     
     void fill_tree_info(Tree tree);
     
@@ -0,0 +1,156 @@
+//
+//  Forward_buffer.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Forward_buffer.hpp"
+
+static vector<vector<double>> &spare_probs() {
+    thread_local vector<vector<double>> spares;
+    return spares;
+}
+
+static vector<vector<size_t>> &spare_offsets() {
+    thread_local vector<vector<size_t>> spares;
+    return spares;
+}
+
+Forward_buffer::Forward_buffer() {
+    vector<vector<double>> &sp = spare_probs();
+    vector<vector<size_t>> &so = spare_offsets();
+    if (sp.size() > 0) {
+        probs = move(sp.back());
+        sp.pop_back();
+    }
+    if (so.size() > 0) {
+        offsets = move(so.back());
+        so.pop_back();
+    }
+    clear();
+}
+
+Forward_buffer::~Forward_buffer() {
+    vector<vector<double>> &sp = spare_probs();
+    vector<vector<size_t>> &so = spare_offsets();
+    if (sp.size() < 4 and probs.capacity() > 0) {
+        sp.push_back(move(probs));
+    }
+    if (so.size() < 4 and offsets.capacity() > 0) {
+        so.push_back(move(offsets));
+    }
+}
+
+void Forward_buffer::clear() {
+    offsets.resize(1);
+    offsets[0] = 0;
+    rows.clear();
+    pinned.clear();
+    segment_offsets.resize(1);
+    segment_offsets[0] = 0;
+    segment_start = 0;
+    segment_end = 0;
+    peak_size = 0;
+}
+
+void Forward_buffer::reserve(int length) {
+    offsets.reserve(length + 1);
+    if (spacing > 0) {
+        rows.reserve(length);
+        pinned.reserve(length);
+    }
+}
+
+void Forward_buffer::set_spacing(int k) {
+    assert(size() == 0);
+    spacing = max(k, 0);
+}
+
+double *Forward_buffer::add_row(int n) {
+    if (spacing > 0) {
+        int x = (int) rows.size();
+        if (x >= 2 and !pinned[x - 2] and (x - 2) % spacing != 0) {
+            drop_row(x - 2);
+        }
+        rows.push_back((int) offsets.size() - 1);
+        pinned.push_back(0);
+    }
+    size_t start = offsets.back();
+    size_t stop = start + n;
+    if (stop > probs.size()) {
+        probs.resize(stop); // capacity grows geometrically, only the used prefix is touched
+    }
+    offsets.push_back(stop);
+    peak_size = max(peak_size, stop + segment_offsets.back());
+    return probs.data() + start;
+}
+
+double *Forward_buffer::add_row(const vector<double> &row) {
+    double *new_row = add_row((int) row.size());
+    copy(row.begin(), row.end(), new_row);
+    return new_row;
+}
+
+void Forward_buffer::pin(int x) {
+    if (spacing > 0) {
+        assert(rows[x] >= 0);
+        pinned[x] = 1;
+    }
+}
+
+bool Forward_buffer::available(int x) {
+    if (spacing == 0 or rows[x] >= 0) {
+        return true;
+    }
+    return x >= segment_start and x < segment_end;
+}
+
+int Forward_buffer::prev_stored(int x) {
+    while (rows[x] < 0) {
+        x -= 1;
+    }
+    return x;
+}
+
+int Forward_buffer::next_stored(int x) {
+    while (x < rows.size() and rows[x] < 0) {
+        x += 1;
+    }
+    return x;
+}
+
+void Forward_buffer::start_segment(int x) {
+    segment_start = x;
+    segment_end = x;
+    segment_offsets.resize(1);
+}
+
+double *Forward_buffer::add_segment_row(int n) {
+    size_t start = segment_offsets.back();
+    size_t stop = start + n;
+    if (stop > segment.size()) {
+        segment.resize(stop);
+    }
+    segment_offsets.push_back(stop);
+    segment_end += 1;
+    peak_size = max(peak_size, offsets.back() + stop);
+    return segment.data() + start;
+}
+
+size_t Forward_buffer::memory() {
+    return peak_size*sizeof(double) + (offsets.capacity() + segment_offsets.capacity())*sizeof(size_t) + rows.capacity()*(sizeof(int) + sizeof(char));
+}
+
+// bin x is the second to last stored row: slide the last row down over it
+void Forward_buffer::drop_row(int x) {
+    int r = rows[x];
+    int next_r = rows[x + 1];
+    assert(next_r == r + 1 and next_r == offsets.size() - 2);
+    size_t n = offsets[next_r + 1] - offsets[next_r];
+    copy(probs.begin() + offsets[next_r], probs.begin() + offsets[next_r + 1], probs.begin() + offsets[r]);
+    offsets[r + 1] = offsets[r] + n;
+    offsets.pop_back();
+    rows[x] = -1;
+    rows[x + 1] = r;
+}
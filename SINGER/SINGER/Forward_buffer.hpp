@@ -0,0 +1,111 @@
+//
+//  Forward_buffer.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Forward_buffer_hpp
+#define Forward_buffer_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+// Forward probabilities of all bins packed into one flat buffer, row x spanning
+// [offsets[x], offsets[x + 1]). Storage is handed back to a per-thread spare list on
+// destruction and picked up by the next buffer, so repeated rethreading stops allocating
+// once the buffer has grown to the largest window seen. Row pointers are invalidated by add_row.
+//
+// With a checkpoint spacing k > 0 only every k-th bin, pinned bins and the two most recent
+// bins are stored; the engine recomputes the rows in between into a segment cache during
+// traceback (see approx_BSP::get_forward_probs), bounding storage to O(n/k + k) rows.
+class Forward_buffer {
+
+public:
+
+    vector<double> probs = {};
+    vector<size_t> offsets = {0};
+    
+    // checkpointing:
+    int spacing = 0;
+    vector<int> rows = {}; // bin -> stored row, -1 once dropped
+    vector<char> pinned = {};
+    vector<double> segment = {};
+    vector<size_t> segment_offsets = {0};
+    int segment_start = 0;
+    int segment_end = 0;
+    size_t peak_size = 0;
+
+    Forward_buffer();
+
+    Forward_buffer(const Forward_buffer &other) = default;
+    
+    Forward_buffer(Forward_buffer &&other) = default;
+    
+    Forward_buffer &operator=(const Forward_buffer &other) = default;
+    
+    Forward_buffer &operator=(Forward_buffer &&other) = default;
+
+    ~Forward_buffer();
+
+    void clear();
+
+    void reserve(int length);
+    
+    void set_spacing(int k);
+
+    double *add_row(int n);
+
+    double *add_row(const vector<double> &row);
+    
+    void pin(int x);
+    
+    bool available(int x);
+    
+    int prev_stored(int x);
+    
+    int next_stored(int x);
+    
+    void start_segment(int x);
+    
+    double *add_segment_row(int n);
+    
+    size_t memory();
+
+    double *operator[](int x) {
+        if (spacing == 0) {
+            return probs.data() + offsets[x];
+        }
+        int r = rows[x];
+        if (r >= 0) {
+            return probs.data() + offsets[r];
+        }
+        return segment.data() + segment_offsets[x - segment_start];
+    }
+
+    int dim(int x) {
+        if (spacing == 0) {
+            return (int) (offsets[x + 1] - offsets[x]);
+        }
+        int r = rows[x];
+        if (r >= 0) {
+            return (int) (offsets[r + 1] - offsets[r]);
+        }
+        return (int) (segment_offsets[x - segment_start + 1] - segment_offsets[x - segment_start]);
+    }
+
+    int size() {
+        if (spacing == 0) {
+            return (int) offsets.size() - 1;
+        }
+        return (int) rows.size();
+    }
+    
+    void drop_row(int x);
+};
+
+#endif /* Forward_buffer_hpp */
@@ -0,0 +1,232 @@
+//
+//  Genotype_cache.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Genotype_cache.hpp"
+
+static const char genotype_cache_magic[8] = {'S', 'I', 'N', 'G', 'E', 'R', 'G', 'C'};
+static const uint32_t genotype_cache_byte_order = 0x01020304;
+
+Genotype_cache::Genotype_cache() {}
+
+Genotype_cache::~Genotype_cache() {
+    if (data != nullptr) {
+        munmap(data, length);
+    }
+}
+
+string Genotype_cache::source_filename(string prefix, bool haps) {
+    if (haps) {
+        return prefix + ".haps";
+    }
+    return Vcf_reader::find(prefix);
+}
+
+long Genotype_cache::file_size(string filename) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return -1;
+    }
+    return (long) st.st_size;
+}
+
+int64_t Genotype_cache::file_mtime(string filename) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return -1;
+    }
+    return (int64_t) st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec;
+}
+
+bool Genotype_cache::map(string source) {
+    long source_size = file_size(source);
+    if (source_size < 0) {
+        return false;
+    }
+    string filename = source + ".gtc";
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_t n = st.st_size;
+    if (n < sizeof(header)) {
+        close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, n, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    memcpy(&header, p, sizeof(header));
+    size_t expected = sizeof(header) + 8*(header.num_sites + header.num_removed + header.num_sites*header.words_per_site);
+    if (memcmp(header.magic, genotype_cache_magic, 8) != 0 or header.byte_order != genotype_cache_byte_order
+        or header.version != version or header.source_size != source_size or header.source_mtime != file_mtime(source)
+        or n < expected) {
+        munmap(p, n);
+        header = {};
+        return false; // converted from another version of the input, or on another machine
+    }
+    data = p;
+    length = n;
+    positions = (const double *) ((const char *) data + sizeof(header));
+    removed = positions + header.num_sites;
+    bits = (const uint64_t *) (removed + header.num_removed);
+    return true;
+}
+
+void Genotype_cache::load(string prefix, bool haps) {
+    if (map(source_filename(prefix, haps))) {
+        return;
+    }
+    if (haps) {
+        read_haps(prefix);
+    } else {
+        read_vcf(prefix);
+    }
+}
+
+void Genotype_cache::build(string prefix, bool haps) {
+    string source = source_filename(prefix, haps);
+    if (haps) {
+        read_haps(prefix);
+    } else {
+        read_vcf(prefix);
+    }
+    header.source_size = file_size(source);
+    header.source_mtime = file_mtime(source);
+    write(source + ".gtc");
+}
+
+void Genotype_cache::read_vcf(string prefix) {
+    Vcf_reader reader = Vcf_reader(prefix);
+    header.num_haplotypes = 2*reader.num_individuals;
+    int prev_pos = -1;
+    vector<double> genotypes = {};
+    // the filters of Sampler::guide_read_vcf, over the whole file
+    while (reader.next()) {
+        int pos = reader.position;
+        if (pos == prev_pos) {continue;}
+        if (reader.ref_length > 1 or reader.alt_length > 1) {
+            removed_positions.push_back(pos);
+            continue;
+        }
+        if (reader.next_position == pos) {
+            removed_positions.push_back(pos);
+            prev_pos = pos;
+            continue;
+        }
+        int n = reader.read_genotypes(genotypes);
+        add_site(pos, genotypes, n);
+    }
+    header.num_removed = removed_positions.size();
+    positions = site_positions.data();
+    removed = removed_positions.data();
+    bits = words.data();
+}
+
+void Genotype_cache::read_haps(string prefix) {
+    string haps_file = prefix + ".haps";
+    ifstream file(haps_file);
+    if (!file.is_open()) {
+        cerr << "Failed to open file: " << haps_file << endl;
+        exit(1);
+    }
+    string line;
+    vector<double> genotypes = {};
+    while (getline(file, line)) {
+        istringstream iss(line);
+        string chrom, id, ref, alt, pos_str;
+        iss >> chrom >> id >> pos_str >> ref >> alt;
+        double pos = stod(pos_str.substr(pos_str.find(':') + 1));
+        int n = 0;
+        const char *p = line.c_str() + min((size_t) iss.tellg(), line.size());
+        for (; *p != '\0'; p++) {
+            if (!isspace(*p)) {
+                if (genotypes.size() < n + 1) {
+                    genotypes.resize(n + 1);
+                }
+                genotypes[n] = (*p == '0' ? 0.0 : 1.0);
+                n += 1;
+            }
+        }
+        add_site(pos, genotypes, n);
+    }
+    positions = site_positions.data();
+    removed = removed_positions.data();
+    bits = words.data();
+}
+
+void Genotype_cache::add_site(double pos, vector<double> &genotypes, int n) {
+    if (header.num_haplotypes == 0) {
+        header.num_haplotypes = n; // a haps file, or a VCF without a #CHROM line
+    }
+    if (n != header.num_haplotypes) {
+        cerr << "site at " << pos << " has " << n << " haplotypes instead of " << header.num_haplotypes << endl;
+        exit(1);
+    }
+    header.words_per_site = (header.num_haplotypes + 63)/64;
+    size_t offset = words.size();
+    words.resize(offset + header.words_per_site, 0);
+    for (int h = 0; h < n; h++) {
+        if (genotypes[h] == 1) {
+            words[offset + (h >> 6)] |= (uint64_t) 1 << (h & 63);
+        }
+    }
+    site_positions.push_back(pos);
+    header.num_sites = site_positions.size();
+}
+
+void Genotype_cache::write(string filename) {
+    memcpy(header.magic, genotype_cache_magic, 8);
+    header.version = version;
+    header.byte_order = genotype_cache_byte_order;
+    // other windows may be mapping the cache, so the new one appears in one rename
+    string temp_filename = filename + "." + to_string(getpid());
+    ofstream file(temp_filename, ios::out|ios::binary|ios::trunc);
+    if (!file) {
+        cerr << "Error opening the file: " << temp_filename << endl;
+        exit(1);
+    }
+    file.write((const char *) &header, sizeof(header));
+    file.write((const char *) site_positions.data(), site_positions.size()*sizeof(double));
+    file.write((const char *) removed_positions.data(), removed_positions.size()*sizeof(double));
+    file.write((const char *) words.data(), words.size()*sizeof(uint64_t));
+    file.close();
+    if (!file) {
+        cerr << "Error writing the file: " << temp_filename << endl;
+        exit(1);
+    }
+    if (rename(temp_filename.c_str(), filename.c_str()) != 0) {
+        cerr << "Error renaming the file: " << temp_filename << endl;
+        exit(1);
+    }
+}
+
+pair<int, int> Genotype_cache::site_range(double start, double end, bool closed) {
+    const double *last = positions + header.num_sites;
+    int x = (int) (lower_bound(positions, last, start) - positions);
+    int y = (int) ((closed ? upper_bound(positions, last, end) : lower_bound(positions, last, end)) - positions);
+    return {x, max(x, y)};
+}
+
+int Genotype_cache::count_removed(double start, double end, bool closed) {
+    const double *last = removed + header.num_removed;
+    const double *x = lower_bound(removed, last, start);
+    const double *y = closed ? upper_bound(removed, last, end) : lower_bound(removed, last, end);
+    return (int) max(y - x, (ptrdiff_t) 0);
+}
+
+int Genotype_cache::count_derived(int site) {
+    const uint64_t *row = bits + site*header.words_per_site;
+    int count = 0;
+    for (int i = 0; i < header.words_per_site; i++) {
+        count += __builtin_popcountll(row[i]);
+    }
+    return count;
+}
@@ -0,0 +1,103 @@
+//
+//  Genotype_cache.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Genotype_cache_hpp
+#define Genotype_cache_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <iostream>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Vcf_reader.hpp"
+
+using namespace std;
+
+// Sites of a VCF or haps file with the filters of the readers already applied, converted once
+// for all the windows of a chromosome. A VCF keeps the lines that are single-base and not at a
+// duplicated position; the positions of the lines removed for that are kept so a window reports
+// the same counts. A haps file keeps every line. Each site stores its haplotype states as a bit
+// row. The file is a fixed header and three columns of 8-byte values, written next to the input
+// as <file>.gtc. Readers map it shared and read the columns in place, so every window of the
+// chromosome reads the same pages from the page cache.
+struct Genotype_cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    int64_t source_size; // size of the input file the cache was converted from
+    int64_t source_mtime; // and its modification time, in nanoseconds
+    int64_t num_haplotypes;
+    int64_t num_sites;
+    int64_t num_removed;
+    int64_t words_per_site;
+};
+
+class Genotype_cache {
+
+public:
+
+    static const uint32_t version = 2;
+
+    Genotype_cache_header header = {};
+    vector<double> site_positions = {};
+    vector<double> removed_positions = {};
+    vector<uint64_t> words = {};
+    const double *positions = nullptr; // columns in site_positions, removed_positions and words or in the mapped file
+    const double *removed = nullptr;
+    const uint64_t *bits = nullptr;
+    void *data = nullptr;
+    size_t length = 0;
+
+    Genotype_cache();
+
+    Genotype_cache(const Genotype_cache &) = delete;
+
+    ~Genotype_cache();
+
+    static string source_filename(string prefix, bool haps);
+
+    static long file_size(string filename);
+
+    static int64_t file_mtime(string filename);
+
+    bool map(string source); // false without a cache converted from the current source
+
+    void load(string prefix, bool haps); // mapped if there is a cache, converted in memory otherwise
+
+    void build(string prefix, bool haps); // converts the input and writes its cache
+
+    void read_vcf(string prefix);
+
+    void read_haps(string prefix);
+
+    void add_site(double pos, vector<double> &genotypes, int n);
+
+    void write(string filename);
+
+    int num_haplotypes() {
+        return (int) header.num_haplotypes;
+    }
+
+    pair<int, int> site_range(double start, double end, bool closed); // sites in [start, end), or [start, end]
+
+    int count_removed(double start, double end, bool closed);
+
+    int count_derived(int site);
+
+    bool get_state(int site, int haplotype) {
+        return (bits[site*header.words_per_site + (haplotype >> 6)] >> (haplotype & 63)) & 1;
+    }
+};
+
+#endif /* Genotype_cache_hpp */
@@ -0,0 +1,80 @@
+//
+//  Grid_counter.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Grid_counter.hpp"
+
+void Grid_counter::count(const vector<double> &grid, vector<double> &counts, Thread_team *team) {
+    int n = (int) lower_bounds.size();
+    int num_windows = (int) grid.size() - 1;
+    first_windows.resize(n);
+    end_windows.resize(n);
+    num_parts = team == nullptr ? 1 : team->num_threads;
+    part_windows.resize(num_parts + 1);
+    for (int p = 0; p <= num_parts; p++) {
+        part_windows[p] = (int) ((long) num_windows*p/num_parts);
+    }
+    buckets.resize(num_parts*num_parts);
+    if (team == nullptr) {
+        find_windows(grid, 0);
+        count_windows(grid, counts, 0);
+        return;
+    }
+    team->run_parts(num_parts, [this, &grid](int x, int y) {
+        for (int q = x; q < y; q++) {
+            find_windows(grid, q);
+        }
+    });
+    team->run_parts(num_parts, [this, &grid, &counts](int x, int y) {
+        for (int p = x; p < y; p++) {
+            count_windows(grid, counts, p);
+        }
+    });
+}
+
+void Grid_counter::find_windows(const vector<double> &grid, int q) {
+    int n = (int) lower_bounds.size();
+    int num_windows = (int) grid.size() - 1;
+    for (int p = 0; p < num_parts; p++) {
+        buckets[q*num_parts + p].clear();
+    }
+    int x = (int) ((long) n*q/num_parts);
+    int y = (int) ((long) n*(q + 1)/num_parts);
+    for (int i = x; i < y; i++) {
+        // windows from the one containing lb up to the last one starting below ub
+        first_windows[i] = (int) distance(grid.begin(), upper_bound(grid.begin(), grid.end(), lower_bounds[i])) - 1;
+        end_windows[i] = (int) distance(grid.begin(), lower_bound(grid.begin(), grid.end(), upper_bounds[i]));
+        end_windows[i] = min(end_windows[i], num_windows);
+        if (first_windows[i] >= end_windows[i]) {
+            continue;
+        }
+        int last_part = find_part(end_windows[i] - 1);
+        for (int p = find_part(max(first_windows[i], 0)); p <= last_part; p++) {
+            buckets[q*num_parts + p].push_back(i);
+        }
+    }
+}
+
+void Grid_counter::count_windows(const vector<double> &grid, vector<double> &counts, int p) {
+    int x = part_windows[p];
+    int y = part_windows[p + 1];
+    for (int q = 0; q < num_parts; q++) {
+        for (int i : buckets[q*num_parts + p]) {
+            int first = max(first_windows[i], x);
+            int end = min(end_windows[i], y);
+            double lb = lower_bounds[i];
+            double ub = upper_bounds[i];
+            for (int k = first; k < end; k++) {
+                double l = min(ub, grid[k + 1]) - max(lb, grid[k]);
+                counts[k] += l/(ub - lb);
+            }
+        }
+    }
+}
+
+int Grid_counter::find_part(int k) {
+    return (int) distance(part_windows.begin(), upper_bound(part_windows.begin(), part_windows.end(), k)) - 1;
+}
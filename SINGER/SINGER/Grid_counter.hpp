@@ -0,0 +1,51 @@
+//
+//  Grid_counter.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Grid_counter_hpp
+#define Grid_counter_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include "Thread_team.hpp"
+
+using namespace std;
+
+// Spreads intervals of time (the branches of mutations or recombinations) over the windows of a
+// time grid, adding to each window the fraction of every interval that falls in it. The windows
+// are split into one contiguous part per thread, and so are the intervals. Each thread finds the
+// windows of its intervals and files them in one bucket per part they reach; each part then goes
+// over its buckets in the order of the intervals and only adds to its own windows. Every window
+// therefore sums its intervals in the order they were added, with the same rounding for any
+// number of threads.
+class Grid_counter {
+
+public:
+
+    vector<double> lower_bounds = {};
+    vector<double> upper_bounds = {};
+    vector<int> first_windows = {};
+    vector<int> end_windows = {};
+    int num_parts = 1;
+    vector<int> part_windows = {}; // part p covers windows [part_windows[p], part_windows[p + 1])
+    vector<vector<int>> buckets = {}; // intervals of part q reaching the windows of part p, at q*num_parts + p
+
+    void add(double lb, double ub) {
+        lower_bounds.push_back(lb);
+        upper_bounds.push_back(ub);
+    }
+
+    void count(const vector<double> &grid, vector<double> &counts, Thread_team *team);
+
+    void find_windows(const vector<double> &grid, int q);
+
+    void count_windows(const vector<double> &grid, vector<double> &counts, int p);
+
+    int find_part(int k); // part containing window k
+};
+
+#endif /* Grid_counter_hpp */
@@ -102,6 +102,32 @@ shared_ptr<Interval> create_interval(Branch b, double tl, double tu, int init_po
     return make_shared<Interval>(b, tl, tu, init_pos);
 }
 
+Interval *Interval_pool::create(Branch b, double tl, double tu, int init_pos) {
+    if (num_intervals == intervals.size()) {
+        intervals.emplace_back();
+    }
+    Interval *interval = &intervals[num_intervals];
+    *interval = Interval(b, tl, tu, init_pos);
+    interval->index = num_intervals;
+    interval->source_begin = (int) source_indices.size();
+    interval->source_end = interval->source_begin;
+    num_intervals += 1;
+    return interval;
+}
+
+void Interval_pool::add_source(Interval *interval, Interval *source, double w) {
+    assert(interval->source_end == source_indices.size());
+    source_indices.push_back(source->index);
+    source_weights.push_back(w);
+    interval->source_end += 1;
+}
+
+void Interval_pool::clear() {
+    num_intervals = 0;
+    source_indices.clear();
+    source_weights.clear();
+}
+
 Interval_info::Interval_info() {
 }
 
@@ -157,3 +183,17 @@ bool Interval_info::operator<(const Interval_info& other) const {
     }
     return lb < other.lb;
 }
+
+void sort_transfers(vector<Interval_info> &infos, vector<int> &order) {
+    order.resize(infos.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&infos](int i, int j) {
+        if (infos[i] < infos[j]) {
+            return true;
+        }
+        if (infos[j] < infos[i]) {
+            return false;
+        }
+        return i < j;
+    });
+}
@@ -28,6 +28,9 @@ public:
     int source_pos = 0;
     Node_ptr node = nullptr;
     double reduction = 1.0;
+    int index = -1; // position in the Interval_pool
+    int source_begin = 0; // sources in the Interval_pool: [source_begin, source_end)
+    int source_end = 0;
     
     vector<double> source_weights = {};
     vector<Interval *> source_intervals = {};
@@ -54,6 +57,37 @@ public:
 
 shared_ptr<Interval> create_interval(Branch b, double tl, double tu, int init_pos);
 
+// Intervals of one BSP run, released together by clear(); the slots are reused by the next run.
+// The sources of every interval are kept as pool indices in flat arrays, so adding them has to
+// follow create() before the next interval is created.
+class Interval_pool {
+    
+public:
+    
+    deque<Interval> intervals = {};
+    int num_intervals = 0;
+    vector<int> source_indices = {};
+    vector<double> source_weights = {};
+    
+    Interval *create(Branch b, double tl, double tu, int init_pos);
+    
+    void add_source(Interval *interval, Interval *source, double w);
+    
+    void clear();
+    
+    int num_sources(Interval *interval) {
+        return interval->source_end - interval->source_begin;
+    }
+    
+    Interval *source(Interval *interval, int i) {
+        return &intervals[source_indices[interval->source_begin + i]];
+    }
+    
+    double source_weight(Interval *interval, int i) {
+        return source_weights[interval->source_begin + i];
+    }
+};
+
 struct compare_interval {
     
     bool operator()(const Interval *i1, const Interval *i2) const {
@@ -103,4 +137,6 @@ public:
     
 };
 
+void sort_transfers(vector<Interval_info> &infos, vector<int> &order); // order of infos as in a map, ties kept in insertion order
+
 #endif /* Interval_hpp */
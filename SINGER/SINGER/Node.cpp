@@ -6,6 +6,7 @@
 //
 
 #include "Node.hpp"
+#include <new>
 
 Node::Node(double t) {
     time = t;
@@ -16,30 +17,48 @@ void Node::set_index(int index) {
 }
 
 void Node::add_mutation(double pos) {
-    mutation_sites[pos] = 1;
+    write_state(site_index().add_site(pos), 1);
 }
- 
-double Node::get_state(double pos) {
-    move_iterator(pos);
-    if (it->first == pos) {
-        return it->second;
-    } else {
+
+double Node::get_state(int site) {
+    if (site < 0) {
         return 0;
     }
-    return 0;
+    size_t word = site >> 6;
+    if (word >= genotypes.size()) {
+        return 0;
+    }
+    return (genotypes[word] >> (site & 63)) & 1;
+}
+
+double Node::get_state(double pos) {
+    return get_state(site_index().get_id(pos));
+}
+
+void Node::write_state(int site, double s) {
+    size_t word = site >> 6;
+    uint64_t bit = (uint64_t) 1 << (site & 63);
+    if (s == 0) {
+        if (word < genotypes.size()) {
+            genotypes[word] &= ~bit;
+        }
+    } else if (s == 1) {
+        if (word >= genotypes.size()) {
+            genotypes.resize(word + 1, 0);
+        }
+        genotypes[word] |= bit;
+    }
 }
 
 void Node::write_state(double pos, double s) {
     if (s == 0) {
-        mutation_sites.erase(pos);
-        if (it->first == pos) {
-            it = mutation_sites.begin();
+        int site = site_index().get_id(pos);
+        if (site >= 0) {
+            write_state(site, s);
         }
-        return;
     } else if (s == 1) {
-        mutation_sites[pos] = s;
+        write_state(site_index().add_site(pos), s);
     }
-    return;
 }
 
 void Node::read_mutation(string filename) {
@@ -54,39 +73,89 @@ void Node::read_mutation(string filename) {
     }
 }
 
-shared_ptr<Node> new_node(double t) {
-    return make_shared<Node>(t);
+Node *Node_pool::allocate(double t) {
+    if (free_nodes.size() > 0) {
+        Node *n = free_nodes.back();
+        free_nodes.pop_back();
+        n->~Node(); // rebuild in place, so the recycled node starts from a fresh state
+        new (n) Node(t);
+        return n;
+    }
+    nodes.emplace_back(t);
+    return &nodes.back();
 }
 
-void Node::move_iterator(double m) {
-    if (it->first == m) {
-        return;
-    }
-    double next_pos = next(it)->first;
-    double prev_pos = prev(it)->first;
-    if (it->first < m) {
-        if (next_pos == m) {
-            ++it;
-            return;
-        } else if (next_pos > m) {
-            return;
+void Node_pool::sweep() {
+    for (Node &n : nodes) {
+        if (!n.marked and !n.released) {
+            n.~Node();
+            new (&n) Node(0);
+            n.released = true;
+            free_nodes.push_back(&n);
         }
-    } else if (it->first > m and prev_pos <= m) {
-        --it;
-        return;
+        n.marked = false;
     }
-    if (abs(it->first - m) < 20) {
-        while (it != mutation_sites.begin() and it->first > m) {
-            --it;
-        }
-        while (next(it) != mutation_sites.end() and next(it)->first <= m) {
-            ++it;
+}
+
+int Node_pool::num_live() {
+    return (int) (nodes.size() - free_nodes.size());
+}
+
+Node_pool &node_pool() {
+    thread_local Node_pool pool;
+    return pool;
+}
+
+Node *new_node(double t) {
+    return node_pool().allocate(t);
+}
+
+vector<double> Node::get_mutations() {
+    vector<double> mutations = {};
+    Site_index &sites = site_index();
+    for (size_t i = 0; i < genotypes.size(); i++) {
+        uint64_t word = genotypes[i];
+        while (word != 0) {
+            int site = (int) (i*64 + __builtin_ctzll(word));
+            mutations.push_back(sites.positions[site]);
+            word &= word - 1;
         }
-    } else {
-        it = mutation_sites.upper_bound(m);
-        --it;
     }
-    assert(it->first <= m and next(it)->first > m);
+    sort(mutations.begin(), mutations.end());
+    return mutations;
+}
+
+int Site_index::get_id(double pos) {
+    if (pos == last_pos) {
+        return last_id;
+    }
+    auto it = ids.find(pos);
+    if (it == ids.end()) {
+        return -1;
+    }
+    last_pos = pos;
+    last_id = it->second;
+    return last_id;
+}
+
+int Site_index::add_site(double pos) {
+    int site = get_id(pos);
+    if (site >= 0) {
+        return site;
+    }
+    site = (int) positions.size();
+    positions.push_back(pos);
+    ids[pos] = site;
+    return site;
+}
+
+int Site_index::size() {
+    return (int) positions.size();
+}
+
+Site_index &site_index() {
+    thread_local Site_index sites;
+    return sites;
 }
 
 /*
@@ -21,18 +21,42 @@
 #include <algorithm>
 #include <cmath>
 #include <memory>
+#include <deque>
+#include <limits>
 using namespace std;
 
+// Dense ids for mutation positions, shared by all nodes of a thread so that a node's genotype is
+// a bit row indexed by site id instead of an ordered map keyed by position.
+class Site_index {
+    
+public:
+    
+    vector<double> positions = {};
+    unordered_map<double, int> ids = {};
+    double last_pos = numeric_limits<double>::quiet_NaN();
+    int last_id = -1;
+    
+    int get_id(double pos);
+    
+    int add_site(double pos);
+    
+    int size();
+};
+
+Site_index &site_index();
+
 class Node {
     
 public:
-    map<double, double> mutation_sites = {{-1, 0}, {INT_MAX, 0}};
-    map<double, double>::iterator it = next(mutation_sites.begin());
+    vector<uint64_t> genotypes = {}; // bit i is the state at site i of site_index()
     
     int index = 0;
     
     double time = 0;
     
+    bool marked = false; // reachability flag used by Node_pool::sweep
+    bool released = false;
+    
     Node(double t);
     
     void set_index(int index);
@@ -41,13 +65,17 @@ public:
     
     void add_mutation(double pos);
     
+    double get_state(int site);
+    
     double get_state(double pos);
     
+    void write_state(int site, double s);
+    
     void write_state(double pos, double s);
     
     void read_mutation(string filename);
     
-    void move_iterator(double m);
+    vector<double> get_mutations();
 
 /*
 public:
@@ -75,11 +103,31 @@ public:
  */
 };
 
-shared_ptr<Node> new_node(double t);
+// Nodes live in a chunked arena with stable addresses, so handles are plain pointers
+// and copying a Branch costs no reference counting. Nodes that are no longer reachable
+// from the ARG are recycled by a mark-sweep pass at safe points (see Sampler::collect_nodes).
+// Each thread has its own pool, so samplers on different threads never sweep each other's nodes.
+class Node_pool {
+    
+public:
+    
+    deque<Node> nodes = {};
+    vector<Node *> free_nodes = {};
+    
+    Node *allocate(double t);
+    
+    void sweep();
+    
+    int num_live();
+};
+
+Node_pool &node_pool();
+
+Node *new_node(double t);
 
 struct compare_node {
     
-    bool operator() (const shared_ptr<Node> n1, const shared_ptr<Node> n2) const {
+    bool operator() (const Node *n1, const Node *n2) const {
         if (n1->time != n2->time) {
             return n1->time < n2->time;
         } else if (n1->index != n2->index) {
@@ -0,0 +1,66 @@
+//
+//  Node_spans.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Node_spans.hpp"
+
+void Node_spans::reserve(size_t n) {
+    ids.reserve(n);
+    nodes.reserve(n);
+    starts.reserve(n);
+    open.reserve(n);
+    spans.reserve(n);
+}
+
+int Node_spans::get_id(Node_ptr n) {
+    auto it = ids.find(n);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    int id = (int) nodes.size();
+    ids[n] = id;
+    nodes.push_back(n);
+    starts.push_back(0);
+    open.push_back(false);
+    spans.push_back(0);
+    return id;
+}
+
+void Node_spans::start(Node_ptr n, double x) {
+    int id = get_id(n);
+    starts[id] = x;
+    open[id] = true;
+}
+
+void Node_spans::stop(Node_ptr n, double x) {
+    int id = get_id(n);
+    assert(open[id]);
+    spans[id] += x - starts[id];
+    open[id] = false;
+}
+
+void Node_spans::stop_all(double x) {
+    for (int id = 0; id < nodes.size(); id++) {
+        if (open[id]) {
+            spans[id] += x - starts[id];
+            open[id] = false;
+        }
+    }
+}
+
+void Node_spans::clear_starts() {
+    fill(open.begin(), open.end(), false);
+}
+
+vector<int> Node_spans::sorted_ids() {
+    vector<int> sorted = vector<int>(nodes.size());
+    iota(sorted.begin(), sorted.end(), 0);
+    compare_node cmp = compare_node();
+    sort(sorted.begin(), sorted.end(), [this, &cmp](int i, int j) {
+        return cmp(nodes[i], nodes[j]);
+    });
+    return sorted;
+}
@@ -0,0 +1,46 @@
+//
+//  Node_spans.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Node_spans_hpp
+#define Node_spans_hpp
+
+#include <stdio.h>
+#include <numeric>
+#include "Node.hpp"
+#include "Branch.hpp"
+
+// Lengths of sequence over which nodes stay in the local trees, added up while the recombinations
+// are walked from left to right. Nodes get dense ids when they are first seen, so the walk does
+// one hash lookup and a few array updates per recombination instead of inserting into maps
+// ordered by node time, and the nodes are sorted by time once at the end. Each span is added up
+// in the same order as with the maps, so the lengths are identical.
+class Node_spans {
+
+public:
+
+    unordered_map<Node_ptr, int> ids = {};
+    vector<Node_ptr> nodes = {};
+    vector<double> starts = {};
+    vector<char> open = {};
+    vector<double> spans = {};
+
+    void reserve(size_t n);
+
+    int get_id(Node_ptr n);
+
+    void start(Node_ptr n, double x);
+
+    void stop(Node_ptr n, double x);
+
+    void stop_all(double x); // closes the spans still open at x
+
+    void clear_starts();
+
+    vector<int> sorted_ids(); // by compare_node
+};
+
+#endif /* Node_spans_hpp */
@@ -24,13 +24,12 @@ void Normalizer::compute_max_time(ARG &a) {
 }
 
 void Normalizer::get_root_span(ARG &a) {
-    map<Node_ptr, double, compare_node> root_start = {};
-    map<Node_ptr, double, compare_node> root_span = {};
+    Node_spans root_spans = Node_spans();
     Branch prev_branch;
     Branch next_branch;
     Recombination &r = a.recombinations.begin()->second;
     prev_branch = *(r.inserted_branches.rbegin());
-    root_start[prev_branch.lower_node] = 0;
+    root_spans.start(prev_branch.lower_node, 0);
     auto r_it = a.recombinations.upper_bound(0);
     while (next(r_it)->first < a.sequence_length) {
         Recombination &r = r_it->second;
@@ -41,57 +40,44 @@ void Normalizer::get_root_span(ARG &a) {
             Node_ptr in = next_branch.lower_node;
             assert(dn != in);
             assert(next_branch.upper_node == a.root);
-            assert(root_start.count(dn) > 0);
-            root_span[dn] += r.pos - root_start[dn];
-            root_start.erase(dn);
-            root_start[in] = r.pos;
+            root_spans.stop(dn, r.pos);
+            root_spans.start(in, r.pos);
         } else {
             assert(next_branch.upper_node != a.root);
         }
         r_it++;
     }
-    for (auto &x : root_start) {
-        Node_ptr n = x.first;
-        root_span[n] += a.sequence_length - x.second;
-    }
-    all_root_nodes.resize(root_span.size());
-    all_root_spans.resize(root_span.size());
-    int index = 0;
-    for (auto &x : root_span) {
-        all_root_nodes[index] = x.first;
-        all_root_spans[index] = x.second;
-        index++;
+    root_spans.stop_all(a.sequence_length);
+    vector<int> sorted_ids = root_spans.sorted_ids();
+    all_root_nodes.resize(sorted_ids.size());
+    all_root_spans.resize(sorted_ids.size());
+    for (int i = 0; i < sorted_ids.size(); i++) {
+        all_root_nodes[i] = root_spans.nodes[sorted_ids[i]];
+        all_root_spans[i] = root_spans.spans[sorted_ids[i]];
     }
 }
 
 void Normalizer::get_node_span(ARG &a) {
-    map<Node_ptr, double, compare_node> node_start = {};
-    map<Node_ptr, double, compare_node> node_span = {};
+    Node_spans node_spans = Node_spans();
+    node_spans.reserve(a.recombinations.size() + 1);
     for (const Branch &b : a.recombinations.begin()->second.inserted_branches) {
-        node_start[b.upper_node] = 0;
+        if (b.upper_node != a.root) {
+            node_spans.start(b.upper_node, 0);
+        }
     }
-    node_start.erase(a.root);
     auto r_it = next(a.recombinations.begin());
     while (next(r_it) != a.recombinations.end()) {
-        Node_ptr dn = r_it->second.deleted_node;
-        Node_ptr in = r_it->second.inserted_node;
-        assert(node_start.count(dn) > 0);
-        node_span[dn] += r_it->first - node_start[dn];
-        node_start.erase(dn);
-        node_start[in] = r_it->first;
+        node_spans.stop(r_it->second.deleted_node, r_it->first);
+        node_spans.start(r_it->second.inserted_node, r_it->first);
         r_it++;
     }
-    for (auto &x : node_start) {
-        Node_ptr n = x.first;
-        node_span[n] += a.sequence_length - node_start[n];
-    }
-    all_nodes.resize(node_span.size());
-    all_spans.resize(node_span.size());
-    int index = 0;
-    for (auto &x : node_span) {
-        all_nodes[index] = x.first;
-        all_spans[index] = x.second;
-        index++;
+    node_spans.stop_all(a.sequence_length);
+    vector<int> sorted_ids = node_spans.sorted_ids();
+    all_nodes.resize(sorted_ids.size());
+    all_spans.resize(sorted_ids.size());
+    for (int i = 0; i < sorted_ids.size(); i++) {
+        all_nodes[i] = node_spans.nodes[sorted_ids[i]];
+        all_spans[i] = node_spans.spans[sorted_ids[i]];
     }
 }
 
@@ -149,10 +135,15 @@ void Normalizer::normalize(ARG &a, double theta) {
         }
         k++;
     }
+    a.tree_map.clear(); // stored trees are ordered by node times
     for (auto &x : a.recombinations) {
         x.second.start_time = -1;
     }
-    a.adjust_recombinations();
+    if (team != nullptr) {
+        a.adjust_recombinations(*team);
+    } else {
+        a.adjust_recombinations();
+    }
 }
 
 void Normalizer::partition_arg(ARG &a) {
@@ -205,16 +196,15 @@ void Normalizer::normalize_recombinations(ARG &a) {
 
 void Normalizer::count_mutations(ARG &a) {
     observed_mutation_counts.resize(expected_mutation_counts.size());
-    double lb, ub;
+    Grid_counter counter = Grid_counter();
     for (auto &x : a.mutation_branches) {
         for (auto &y : x.second) {
             if (y.upper_node != a.root) {
-                lb = y.lower_node->time;
-                ub = y.upper_node->time;
-                add_mutation(lb, ub);
+                counter.add(y.lower_node->time, y.upper_node->time);
             }
         }
     }
+    counter.count(old_grid, observed_mutation_counts, team);
     double num_muts = a.mutation_sites.size() - 1;
     double num_mapped_muts = accumulate(observed_mutation_counts.begin(), observed_mutation_counts.end(), 0.0);
     double r = num_muts/num_mapped_muts;
@@ -225,15 +215,14 @@ void Normalizer::count_mutations(ARG &a) {
 
 void Normalizer::count_recombinations(ARG &a) {
     observed_recombination_counts.resize(observed_mutation_counts.size());
-    double lb, ub;
+    Grid_counter counter = Grid_counter();
     for (auto &x : a.recombinations) {
         if (x.first > 0 and x.first < a.sequence_length) {
             Recombination &r = x.second;
-            lb = r.source_branch.lower_node->time;
-            ub = min(r.inserted_node->time, r.deleted_node->time);
-            add_recombination(lb, ub);
+            counter.add(r.source_branch.lower_node->time, min(r.inserted_node->time, r.deleted_node->time));
         }
     }
+    counter.count(old_grid, observed_recombination_counts, team);
     double num_recs = accumulate(observed_recombination_counts.begin(), observed_recombination_counts.end(), 0.0f);
     num_recs /= observed_recombination_counts.size();
     recombination_density.resize(observed_recombination_counts.size());
@@ -242,36 +231,6 @@ void Normalizer::count_recombinations(ARG &a) {
     }
 }
 
-void Normalizer::add_mutation(double lb, double ub) {
-    double x, y, l;
-    int index;
-    auto it = upper_bound(old_grid.begin(), old_grid.end(), lb);
-    it--;
-    index = (int) distance(old_grid.begin(), it);
-    while (old_grid[index] < ub) {
-        x = old_grid[index];
-        y = old_grid[index + 1];
-        l = min(ub, y) - max(lb, x);
-        observed_mutation_counts[index] += l/(ub - lb);
-        index++;
-    }
-}
-
-void Normalizer::add_recombination(double lb, double ub) {
-    double x, y, l;
-    int index;
-    auto it = upper_bound(old_grid.begin(), old_grid.end(), lb);
-    it--;
-    index = (int) distance(old_grid.begin(), it);
-    while (old_grid[index] < ub) {
-        x = old_grid[index];
-        y = old_grid[index + 1];
-        l = min(ub, y) - max(lb, x);
-        observed_recombination_counts[index] += l/(ub - lb);
-        index++;
-    }
-}
-
 /*
 void Normalizer::calculate_branch_length(ARG &a, double Ne) {
     observed_branch_length.resize(expected_mutation_counts.size());
@@ -11,6 +11,8 @@
 #include <stdio.h>
 #include "random_utils.hpp"
 #include "ARG.hpp"
+#include "Node_spans.hpp"
+#include "Grid_counter.hpp"
 
 class Normalizer {
     
@@ -19,6 +21,7 @@ public:
     int num_windows = 100;
     double ls = 0;
     double max_time = 20;
+    Thread_team *team = nullptr; // shares the mutation and recombination counts and the recombination times
     
     vector<Node_ptr> all_root_nodes = {};
     vector<double> all_root_spans = {};
@@ -56,10 +59,6 @@ public:
     
     void count_recombinations(ARG &a);
     
-    void add_mutation(double lb, double ub);
-    
-    void add_recombination(double lb, double ub);
-    
     double sample_recombination_time(double lb, double ub);
     
     void sample_recombinations(ARG &a);
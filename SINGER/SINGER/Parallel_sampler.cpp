@@ -0,0 +1,94 @@
+//
+//  Parallel_sampler.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Parallel_sampler.hpp"
+
+Parallel_sampler::Parallel_sampler(Sampler &s, int n, double l) : prototype(s) {
+    num_threads = n;
+    block_length = l;
+}
+
+void Parallel_sampler::load_vcf(string prefix) {
+    cout << get_time() << " Loading VCF" << endl;
+    cache.load(prefix, false);
+    cout << get_time() << " Loaded " << cache.header.num_sites << " sites" << endl;
+}
+
+void Parallel_sampler::find_blocks() {
+    // the segments index_vcf.py writes, from the positions of all the VCF lines
+    set<double> segments = {};
+    for (int i = 0; i < cache.header.num_sites; i++) {
+        segments.insert(floor(cache.positions[i]/block_length)*block_length);
+    }
+    for (int i = 0; i < cache.header.num_removed; i++) {
+        segments.insert(floor(cache.removed[i]/block_length)*block_length);
+    }
+    block_starts.clear();
+    block_ids.clear();
+    int id = 0;
+    for (double x : segments) {
+        if (x + block_length > start and x < end) {
+            block_starts.push_back(x);
+            block_ids.push_back(id);
+        }
+        id++;
+    }
+    num_blocks = (int) block_starts.size();
+}
+
+void Parallel_sampler::run(double x, double y, int num_iters, int spacing) {
+    start = x;
+    end = y;
+    find_blocks();
+    next_block = 0;
+    vector<thread> threads = {};
+    for (int i = 0; i < min(num_threads, num_blocks); i++) {
+        threads.emplace_back([this, num_iters, spacing]() {
+            int k = next_block++;
+            while (k < num_blocks) {
+                run_block(k, num_iters, spacing);
+                k = next_block++;
+            }
+        });
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+}
+
+void Parallel_sampler::run_block(int k, int num_iters, int spacing) {
+    reset_thread_state();
+    double block_start = max(start, block_starts[k]);
+    double block_end = min(end, block_starts[k] + block_length);
+    string block_prefix = prototype.output_prefix + "_" + to_string(block_ids[k]) + "_" + to_string(block_ids[k] + 1);
+    cout << get_time() << " Block " << block_ids[k] << ": [" << block_start << ", " << block_end << ")" << endl;
+    Sampler sampler = prototype;
+    sampler.set_output_file_prefix(block_prefix);
+    sampler.start = block_start;
+    sampler.end = block_end;
+    sampler.load_vcf(cache, block_start, block_end);
+    if (sampler.num_valid_sites < 100) {
+        cout << "Block " << block_ids[k] << ": number of mutations too few (<100), SINGER won't run for such regions" << endl;
+        return;
+    }
+    if (sampler.fast_mode) {
+        sampler.fast_iterative_start();
+        sampler.fast_internal_sample(num_iters, spacing);
+    } else {
+        sampler.iterative_start();
+        sampler.internal_sample(num_iters, spacing);
+    }
+    cout << get_time() << " Block " << block_ids[k] << " finished" << endl;
+}
+
+void Parallel_sampler::reset_thread_state() {
+    // the nodes of the previous block on this thread are no longer referenced
+    node_pool() = Node_pool();
+    site_index() = Site_index();
+    TSP::counter = 0;
+    TSP_smc::counter = 0;
+}
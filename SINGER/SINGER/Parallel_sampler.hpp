@@ -0,0 +1,53 @@
+//
+//  Parallel_sampler.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Parallel_sampler_hpp
+#define Parallel_sampler_hpp
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include "Sampler.hpp"
+#include "Genotype_cache.hpp"
+
+// Splits [start, end) into blocks and samples each block with its own Sampler on a pool of
+// threads, with the VCF parsed (or its genotype cache mapped) once for all of them. The blocks
+// are the segments of index_vcf.py, multiples of the block length holding at least one VCF line,
+// numbered over the whole file as parallel_singer does: block i writes to <output>_i_<i+1>, and
+// only the first and last blocks are clipped to [start, end). Each block starts from the same
+// global state as a separate process would (random seed, node pool, site ids and counters are
+// per thread and reset for every block), so given the same seed its outputs match a
+// single-block run of that region.
+class Parallel_sampler {
+
+public:
+
+    Sampler prototype; // settings shared by the samplers of all blocks
+    int num_threads = 1;
+    double block_length = 1e6;
+    double start = 0;
+    double end = 0;
+    int num_blocks = 0;
+    vector<double> block_starts = {}; // segment start of every block in [start, end)
+    vector<int> block_ids = {}; // its number among all segments of the file
+    Genotype_cache cache;
+    atomic<int> next_block = 0;
+
+    Parallel_sampler(Sampler &s, int n, double l);
+
+    void load_vcf(string prefix);
+
+    void find_blocks();
+    
+    void run(double x, double y, int num_iters, int spacing);
+
+    void run_block(int k, int num_iters, int spacing);
+
+    void reset_thread_state();
+};
+
+#endif /* Parallel_sampler_hpp */
@@ -0,0 +1,247 @@
+//
+//  Persistent_map.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Persistent_map_hpp
+#define Persistent_map_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+// Ordered map as a treap whose entries are shared between copies. Copying the map only copies
+// the root, and an update copies the entries on its search path that are still shared with
+// another copy (entries owned by this map alone are updated in place), so taking a snapshot
+// costs O(1) and every later change O(log n).
+template<class Key, class Value, class Compare>
+class Persistent_map {
+
+public:
+
+    struct Entry {
+        pair<Key, Value> item;
+        unsigned priority = 0;
+        shared_ptr<Entry> left = nullptr;
+        shared_ptr<Entry> right = nullptr;
+    };
+
+    using Entry_ptr = shared_ptr<Entry>;
+
+    class iterator {
+
+    public:
+
+        vector<const Entry *> path = {};
+
+        iterator() {}
+
+        iterator(const Entry *e) {
+            push_left(e);
+        }
+
+        void push_left(const Entry *e) {
+            while (e != nullptr) {
+                path.push_back(e);
+                e = e->left.get();
+            }
+        }
+
+        const pair<Key, Value> &operator*() const {
+            return path.back()->item;
+        }
+
+        const pair<Key, Value> *operator->() const {
+            return &path.back()->item;
+        }
+
+        iterator &operator++() {
+            const Entry *e = path.back();
+            path.pop_back();
+            push_left(e->right.get());
+            return *this;
+        }
+
+        bool operator!=(const iterator &other) const {
+            if (path.size() != other.path.size()) {
+                return true;
+            }
+            return path.size() > 0 and path.back() != other.path.back();
+        }
+    };
+
+    Entry_ptr root = nullptr;
+    size_t count = 0;
+    Compare comp;
+
+    iterator begin() const {
+        return iterator(root.get());
+    }
+
+    iterator end() const {
+        return iterator();
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    void clear() {
+        root = nullptr;
+        count = 0;
+    }
+
+    // value at k, or a default value if k is absent (never inserts)
+    Value operator[](const Key &k) const {
+        const Entry *e = root.get();
+        while (e != nullptr) {
+            if (comp(k, e->item.first)) {
+                e = e->left.get();
+            } else if (comp(e->item.first, k)) {
+                e = e->right.get();
+            } else {
+                return e->item.second;
+            }
+        }
+        return Value();
+    }
+
+    bool contains(const Key &k) const {
+        const Entry *e = root.get();
+        while (e != nullptr) {
+            if (comp(k, e->item.first)) {
+                e = e->left.get();
+            } else if (comp(e->item.first, k)) {
+                e = e->right.get();
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // value at k for modification in place, copying the shared entries on its path; nullptr if k is absent
+    Value *find_mutable(const Key &k) {
+        Entry_ptr *e = &root;
+        while (*e != nullptr) {
+            make_unique(*e);
+            if (comp(k, (*e)->item.first)) {
+                e = &(*e)->left;
+            } else if (comp((*e)->item.first, k)) {
+                e = &(*e)->right;
+            } else {
+                return &(*e)->item.second;
+            }
+        }
+        return nullptr;
+    }
+
+    const pair<Key, Value> &last() const {
+        assert(root != nullptr);
+        const Entry *e = root.get();
+        while (e->right != nullptr) {
+            e = e->right.get();
+        }
+        return e->item;
+    }
+
+    void insert(const Key &k, const Value &v) {
+        insert_helper(root, k, v);
+    }
+
+    void erase(const Key &k) {
+        erase_helper(root, k);
+    }
+
+    static unsigned next_priority() {
+        thread_local unsigned state = 2463534242u;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    static void make_unique(Entry_ptr &e) {
+        if (e.use_count() > 1) {
+            e = make_shared<Entry>(*e);
+        }
+    }
+
+    static void rotate_right(Entry_ptr &e) {
+        Entry_ptr l = move(e->left);
+        e->left = move(l->right);
+        l->right = move(e);
+        e = move(l);
+    }
+
+    static void rotate_left(Entry_ptr &e) {
+        Entry_ptr r = move(e->right);
+        e->right = move(r->left);
+        r->left = move(e);
+        e = move(r);
+    }
+
+    void insert_helper(Entry_ptr &e, const Key &k, const Value &v) {
+        if (e == nullptr) {
+            e = make_shared<Entry>();
+            e->item = {k, v};
+            e->priority = next_priority();
+            count += 1;
+            return;
+        }
+        make_unique(e);
+        if (comp(k, e->item.first)) {
+            insert_helper(e->left, k, v);
+            if (e->left->priority > e->priority) {
+                rotate_right(e);
+            }
+        } else if (comp(e->item.first, k)) {
+            insert_helper(e->right, k, v);
+            if (e->right->priority > e->priority) {
+                rotate_left(e);
+            }
+        } else {
+            e->item.second = v;
+        }
+    }
+
+    void erase_helper(Entry_ptr &e, const Key &k) {
+        if (e == nullptr) {
+            return;
+        }
+        make_unique(e);
+        if (comp(k, e->item.first)) {
+            erase_helper(e->left, k);
+        } else if (comp(e->item.first, k)) {
+            erase_helper(e->right, k);
+        } else {
+            e = merge(move(e->left), move(e->right));
+            count -= 1;
+        }
+    }
+
+    static Entry_ptr merge(Entry_ptr a, Entry_ptr b) {
+        if (a == nullptr) {
+            return b;
+        }
+        if (b == nullptr) {
+            return a;
+        }
+        if (a->priority > b->priority) {
+            make_unique(a);
+            a->right = merge(move(a->right), move(b));
+            return a;
+        } else {
+            make_unique(b);
+            b->left = merge(move(a), move(b->left));
+            return b;
+        }
+    }
+};
+
+#endif /* Persistent_map_hpp */
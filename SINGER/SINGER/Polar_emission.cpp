@@ -101,6 +101,109 @@ double Polar_emission::emit(Branch &branch, double time, double theta, double bi
     return emit_prob;
 }
 
+// Batched kernels: the same arithmetic as the scalar versions above, laid out over arrays of intervals
+
+EMISSION_KERNEL
+static void polar_null_exponents(int dim, const double *times, const double *lower_times, const double *upper_times, double node_time, double theta, double *exponents) {
+    for (int i = 0; i < dim; i++) {
+        double ll = times[i] - lower_times[i];
+        double l0 = times[i] - node_time;
+        exponents[i] = isinf(upper_times[i]) ? theta*(ll + l0) : theta*l0;
+    }
+}
+
+static inline double unit_prob(double theta, double bin_size, double s) {
+    return (isinf(theta) or s == 0) ? 1.0 : theta/bin_size;
+}
+
+EMISSION_KERNEL
+static void polar_mut_kernel(int dim, int num_muts, const double *times, const double *lower_times, const double *upper_times,
+                             const double *lower_states, const double *upper_states, const double *query_states,
+                             double node_time, double theta, double bin_size, double penalty, double reward,
+                             double *emit_probs, double *old_probs, double *root_rewards, double *exponents) {
+    for (int i = 0; i < dim; i++) {
+        emit_probs[i] = 1;
+        old_probs[i] = 1;
+        root_rewards[i] = 1;
+    }
+    for (int j = 0; j < num_muts; j++) {
+        const double *ls = lower_states + j*dim;
+        const double *us = upper_states + j*dim;
+        double s0 = query_states[j];
+        for (int i = 0; i < dim; i++) {
+            double ll = times[i] - lower_times[i];
+            double lu = upper_times[i] - times[i];
+            double l0 = times[i] - node_time;
+            double sl = ls[i];
+            double su = us[i];
+            double sm = (sl + su + s0 > 1.5) ? 1 : 0;
+            double prob = 1;
+            prob *= unit_prob(ll*theta, bin_size, sl - sm);
+            prob *= unit_prob(lu*theta, bin_size, sm - su);
+            prob *= unit_prob(l0*theta, bin_size, s0 - sm);
+            prob *= (s0 - sm >= 1) ? penalty : 1.0;
+            emit_probs[i] *= prob;
+            old_probs[i] *= unit_prob(theta*(ll + lu), bin_size, sl - su);
+            // only the last mutation of the bin decides the root reward, as in the scalar version
+            root_rewards[i] = (isinf(upper_times[i]) and sm == 0 and sl == 1) ? reward : 1.0;
+        }
+    }
+    for (int i = 0; i < dim; i++) {
+        double ll = times[i] - lower_times[i];
+        double l0 = times[i] - node_time;
+        exponents[i] = isinf(upper_times[i]) ? theta*(l0 + ll) : theta*l0;
+    }
+}
+
+EMISSION_KERNEL
+static void polar_combine(int dim, const double *null_probs, const double *old_probs, const double *root_rewards, double *emit_probs) {
+    for (int i = 0; i < dim; i++) {
+        double p = emit_probs[i]*null_probs[i];
+        p /= old_probs[i];
+        p *= root_rewards[i];
+        emit_probs[i] = max(p, 1e-20);
+    }
+}
+
+void Polar_emission::null_emit(vector<double> &times, vector<double> &lower_times, vector<double> &upper_times, double theta, Node_ptr node, vector<double> &emit_probs) {
+    int dim = (int) times.size();
+    prepare_null_emit(dim, emit_probs);
+    null_emit(0, dim, times, lower_times, upper_times, theta, node, emit_probs);
+}
+
+void Polar_emission::prepare_null_emit(int dim, vector<double> &emit_probs) {
+    exponents.resize(dim);
+    emit_probs.resize(dim);
+}
+
+void Polar_emission::null_emit(int begin, int end, vector<double> &times, vector<double> &lower_times, vector<double> &upper_times, double theta, Node_ptr node, vector<double> &emit_probs) {
+    polar_null_exponents(end - begin, times.data() + begin, lower_times.data() + begin, upper_times.data() + begin, node->time, theta, exponents.data() + begin);
+    compute_null_probs(end - begin, exponents.data() + begin, emit_probs.data() + begin);
+}
+
+void Polar_emission::mut_emit(vector<double> &times, vector<Node_ptr> &lower_nodes, vector<Node_ptr> &upper_nodes, double theta, double bin_size, set<double> &mut_set, Node_ptr node, vector<double> &emit_probs) {
+    int dim = (int) times.size();
+    get_states(lower_nodes, upper_nodes, mut_set, node);
+    old_probs.resize(dim);
+    exponents.resize(dim);
+    diff_rewards.resize(dim);
+    emit_probs.resize(dim);
+    polar_mut_kernel(dim, (int) mut_set.size(), times.data(), lower_times.data(), upper_times.data(),
+                     lower_states.data(), upper_states.data(), query_states.data(),
+                     node->time, theta, bin_size, penalty, ancestral_prob/(1 - ancestral_prob),
+                     emit_probs.data(), old_probs.data(), diff_rewards.data(), exponents.data());
+    compute_null_probs(exponents, null_probs);
+    polar_combine(dim, null_probs.data(), old_probs.data(), diff_rewards.data(), emit_probs.data());
+}
+
+void Polar_emission::emit(vector<double> &times, Branch &branch, double theta, double bin_size, vector<double> &emissions, Node_ptr node, vector<double> &emit_probs) {
+    int dim = (int) times.size();
+    emit_probs.resize(dim);
+    for (int i = 0; i < dim; i++) {
+        emit_probs[i] = emit(branch, times[i], theta, bin_size, emissions, node);
+    }
+}
+
 double Polar_emission::mut_prob(double theta, double bin_size, double ll, double lu, double l0, int sl, int su, int s0) {
     double prob = 1;
     prob *= mut_prob(ll*theta, bin_size, sl);
@@ -142,9 +245,10 @@ void Polar_emission::get_diff(double m, Branch branch, Node_ptr node) {
     double su = 0;
     double s0 = 0;
     double sm = 0;
-    sl = branch.lower_node->get_state(m);
-    su = branch.upper_node->get_state(m);
-    s0 = node->get_state(m);
+    int site = site_index().get_id(m);
+    sl = branch.lower_node->get_state(site);
+    su = branch.upper_node->get_state(site);
+    s0 = node->get_state(site);
     if (sl + su + s0 > 1.5) {
         sm = 1;
     } else {
@@ -30,7 +30,7 @@ double RSP_smc::sample_start_time(Branch b, int density, double join_time, doubl
         weights.push_back(w);
         weight_sum += w;
     }
-    p = uniform_random();
+    p = rng->uniform();
     weight_sum = weight_sum*p;
     for (int i = 0; i < density; i++) {
         weight_sum -= weights[i];
@@ -80,7 +80,7 @@ pair<Branch, double> RSP_smc::sample_start_time(Branch b1, Branch b2, int densit
         weight_sum += w;
         branch_indices.push_back(2);
     }
-    p = uniform_random();
+    p = rng->uniform();
     weight_sum = weight_sum*p;
     for (int i = 0; i < density; i++) {
         weight_sum -= weights[i];
@@ -152,7 +152,7 @@ void RSP_smc::approx_sample_recombination(Recombination &r, double cut_time) {
         return;
     }
     vector<Branch> source_candidates;
-    for (Branch b : r.deleted_branches) {
+    for (const Branch &b : r.deleted_branches) {
         if (b.upper_node == r.deleted_node and b.lower_node->time < r.inserted_node->time) {
             Branch candidate_recombined_branch = Branch(b.lower_node, r.inserted_node);
             if (r.create(candidate_recombined_branch)) {
@@ -338,12 +338,12 @@ void RSP_smc::get_coalescence_rate(Tree &tree, Recombination &r, double cut_time
 }
 
 double RSP_smc::random_time(double lb, double ub) {
-    double t = (uniform_random()*0.01 + 0.99)*(ub - lb) + lb;
+    double t = (rng->uniform()*0.01 + 0.99)*(ub - lb) + lb;
     return t;
 }
 
 double RSP_smc::random_time(double lb, double ub, double q) {
-    double t = (q*uniform_random() + (1 - q))*(ub - lb) + lb;
+    double t = (q*rng->uniform() + (1 - q))*(ub - lb) + lb;
     return t;
 }
 
@@ -20,6 +20,8 @@ class RSP_smc {
     
 public:
     
+    Random_context *rng = &thread_random_context();
+    
     RSP_smc();
     
     void sample_recombination(Recombination &r, double cut_time, Tree &tree);
@@ -25,8 +25,8 @@ public:
     Branch lower_transfer_branch;
     Branch upper_transfer_branch;
     double start_time = -1;
-    Node_ptr deleted_node;
-    Node_ptr inserted_node;
+    Node_ptr deleted_node = nullptr;
+    Node_ptr inserted_node = nullptr;
     set<Branch> deleted_branches = {};
     set<Branch> inserted_branches = {};
     
@@ -0,0 +1,61 @@
+//
+//  Sample_writer.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Sample_writer.hpp"
+
+Sample_writer::Sample_writer() {
+    worker = thread([this]() {
+        run();
+    });
+}
+
+Sample_writer::~Sample_writer() {
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_changed.notify_all();
+    worker.join();
+}
+
+void Sample_writer::push(function<void()> job) {
+    unique_lock<mutex> lock(queue_mutex);
+    queue_changed.wait(lock, [this]() {
+        return jobs.size() < capacity;
+    });
+    jobs.push_back(move(job));
+    lock.unlock();
+    queue_changed.notify_all();
+}
+
+void Sample_writer::flush() {
+    unique_lock<mutex> lock(queue_mutex);
+    queue_changed.wait(lock, [this]() {
+        return jobs.size() == 0 and !writing;
+    });
+}
+
+void Sample_writer::run() {
+    unique_lock<mutex> lock(queue_mutex);
+    while (true) {
+        queue_changed.wait(lock, [this]() {
+            return jobs.size() > 0 or stopping;
+        });
+        if (jobs.size() == 0) {
+            return; // stopping, and everything queued has been written
+        }
+        function<void()> job = move(jobs.front());
+        jobs.pop_front();
+        writing = true;
+        lock.unlock();
+        queue_changed.notify_all();
+        job();
+        lock.lock();
+        writing = false;
+        queue_changed.notify_all();
+    }
+}
@@ -0,0 +1,47 @@
+//
+//  Sample_writer.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Sample_writer_hpp
+#define Sample_writer_hpp
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+using namespace std;
+
+// Writes samples on a background thread, so formatting and writing one sample overlaps the
+// rethreads of the next sweep. The sampler queues a job that owns a snapshot of the sample
+// (ARG_tables or a Checkpoint); push blocks while capacity jobs are waiting, and the destructor
+// returns only after every queued job has been written.
+class Sample_writer {
+
+public:
+
+    int capacity = 2;
+    deque<function<void()>> jobs = {};
+    bool writing = false;
+    bool stopping = false;
+    mutex queue_mutex;
+    condition_variable queue_changed;
+    thread worker;
+
+    Sample_writer();
+
+    ~Sample_writer();
+
+    void push(function<void()> job);
+
+    void flush(); // wait until the queue is empty and the last job is done
+
+    void run();
+};
+
+#endif /* Sample_writer_hpp */
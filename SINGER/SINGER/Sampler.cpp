@@ -14,6 +14,7 @@ Sampler::Sampler(double pop_size, double r, double m) {
 }
 
 Sampler::Sampler(double pop_size, Rate_map &rm, Rate_map &mm) {
+    Ne = pop_size;
     recomb_map = rm;
     mut_map = mm;
     mut_rate = mm.mean_rate()*pop_size;
@@ -50,76 +51,47 @@ void Sampler::set_num_samples(int n) {
 }
 
 void Sampler::naive_read_vcf(string prefix, double start_pos, double end_pos) {
-    string vcf_file = prefix + ".vcf";
-    ifstream file(vcf_file);
-    string line;
-    int num_individuals = 0;
-    int prev_pos = -1;
-    vector<Node_ptr> nodes = {};
     int valid_mutation = 0;
     int removed_mutation = 0;
-    vector<double> genotypes = {};
-    while (getline(file, line)) {
-        if (line.substr(0, 6) == "#CHROM") {
-            istringstream iss(line);
-            vector<string> fields;
-            string field;
-            while (iss >> field) {
-                fields.push_back(field);
-            }
-            num_individuals = (int) fields.size() - 9;
-            nodes.resize(2*num_individuals);
-            for (int i = 0; i < 2*num_individuals; i++) {
-                nodes[i] = new_node(0.0);
-                nodes[i]->set_index(i);
-                sample_nodes.insert(nodes[i]);
-            }
-            genotypes.resize(2*num_individuals);
-            continue;
-        } else if (line[0] == '#') {
-            continue; // skip these header lines
-        }
-        istringstream iss(line);
-        string chrom, id, ref, alt, qual, filter, info, format, genotype;
-        int pos;
-        iss >> chrom >> pos >> id >> ref >> alt >> qual >> filter >> info >> format;
-        
+    Genotype_cache cache = Genotype_cache();
+    if (cache.map(Vcf_reader::find(prefix))) {
+        vector<Node_ptr> nodes = add_sample_nodes(cache.num_haplotypes());
+        pair<int, int> sites = cache.site_range(start_pos, end_pos, true);
+        valid_mutation = add_cached_sites(cache, nodes, sites.first, sites.second, start_pos);
+        removed_mutation = cache.count_removed(start_pos, end_pos, true);
+    } else {
+        read_vcf_lines(prefix, start_pos, end_pos, valid_mutation, removed_mutation);
+    }
+    sequence_length = end_pos - start_pos;
+    num_samples = (int) sample_nodes.size();
+    ordered_sample_nodes = vector<Node_ptr>(sample_nodes.begin(), sample_nodes.end());
+    shuffle(ordered_sample_nodes.begin(), ordered_sample_nodes.end(), rng);
+    cout << "valid mutations: " << valid_mutation << endl;
+    cout << "removed mutations: " << removed_mutation << endl;
+    num_valid_sites = valid_mutation;
+}
+
+void Sampler::read_vcf_lines(string prefix, double start_pos, double end_pos, int &valid_mutation, int &removed_mutation) {
+    Vcf_reader reader = Vcf_reader(prefix);
+    int prev_pos = -1;
+    vector<Node_ptr> nodes = add_sample_nodes(2*reader.num_individuals);
+    vector<double> genotypes = vector<double>(nodes.size());
+    reader.seek(start_pos);
+    while (reader.next()) {
+        int pos = reader.position;
         if (pos < start_pos) {continue;}
         if (pos > end_pos) {break;}
         if (pos == prev_pos) {continue;} // skip multi-allelic sites
-        if (ref.size() > 1 or alt.size() > 1) {
+        if (reader.ref_length > 1 or reader.alt_length > 1) {
             removed_mutation += 1;
             continue;
         } // skip multi-allelic sites or structural variant
-        
-        streampos old_pos = file.tellg();
-        string next_line;
-        if (getline(file, next_line)) {
-            istringstream next_iss(next_line);
-            string next_chrom;
-            int next_pos;
-            next_iss >> next_chrom >> next_pos;
-            if (next_pos == pos) {
-                removed_mutation += 1;
-                prev_pos = pos;
-                continue;
-            }
-            file.seekg(old_pos);
-        }
-        int individual_index = 0;
-        while (iss >> genotype) {
-            if (genotype[0] == '1') {
-                genotypes[2*individual_index] = 1;
-            } else {
-                genotypes[2*individual_index] = 0;
-            }
-            if (genotype[2] == '1') {
-                genotypes[2*individual_index + 1] = 1;
-            } else {
-                genotypes[2*individual_index + 1] = 0;
-            }
-            individual_index += 1;
+        if (reader.next_position == pos) {
+            removed_mutation += 1;
+            prev_pos = pos;
+            continue;
         }
+        reader.read_genotypes(genotypes);
         int genotype_sum = accumulate(genotypes.begin(), genotypes.end(), 0.0);
         if (genotype_sum >= 1 and genotype_sum < genotypes.size()) {
             valid_mutation += 1;
@@ -130,92 +102,36 @@ void Sampler::naive_read_vcf(string prefix, double start_pos, double end_pos) {
             }
         }
     }
-    sequence_length = end_pos - start_pos;
-    num_samples = (int) sample_nodes.size();
-    ordered_sample_nodes = vector<Node_ptr>(sample_nodes.begin(), sample_nodes.end());
-    shuffle(ordered_sample_nodes.begin(), ordered_sample_nodes.end(), random_engine);
-    cout << "valid mutations: " << valid_mutation << endl;
-    cout << "removed mutations: " << removed_mutation << endl;
-    num_valid_sites = valid_mutation;
 }
 
 void Sampler::guide_read_vcf(string prefix, double start, double end) {
-    random_engine.seed(random_seed);
-    string vcf_file = prefix + ".vcf";
-    string index_file = prefix + ".index";
-    ifstream idx_stream(index_file);
-    if (!idx_stream.is_open()) {
-        cerr << "Index file not found: " + index_file << endl;
-        exit(1);
-    }
-    string line;
-    long byte_offset = -1;
-    while (getline(idx_stream, line)) {
-        istringstream iss(line);
-        double segment_start;
-        long offset;
-        iss >> segment_start >> offset;
-        if (segment_start == start) {
-            byte_offset = offset;
-            break;
-        }
-    }
-    if (byte_offset == -1) {
-        cerr << "Start position not found in index file: " + index_file << endl;
-        exit(1);
-    }
-    ifstream vcf_stream(vcf_file, ios::binary);
-    if (!vcf_stream.is_open()) {
-        cerr << "VCF file not found: " + vcf_file << endl;
+    Genotype_cache cache = Genotype_cache();
+    if (cache.map(Vcf_reader::find(prefix))) {
+        load_vcf(cache, start, end);
+        return;
     }
-    vcf_stream.seekg(byte_offset, ios::beg);
+    rng.seed(random_seed);
+    Vcf_reader reader = Vcf_reader(prefix);
+    reader.seek(start);
     int prev_pos = -1;
     vector<Node_ptr> nodes = {};
     int valid_mutation = 0;
     int removed_mutation = 0;
     vector<double> genotypes = {};
-    while (getline(vcf_stream, line)) {
-        istringstream iss(line);
-        string chrom, id, ref, alt, qual, filter, info, format, genotype;
-        int pos;
-        iss >> chrom >> pos >> id >> ref >> alt >> qual >> filter >> info >> format;
+    while (reader.next()) {
+        int pos = reader.position;
         if (pos == prev_pos) {continue;} // skip multi-allelic sites
         if (pos >= end) {break;} // variant out of scope
-        if (ref.size() > 1 or alt.size() > 1) {
+        if (reader.ref_length > 1 or reader.alt_length > 1) {
             removed_mutation += 1;
             continue;
         } // skip multi-allelic sites or structural variant
-        streampos old_pos = vcf_stream.tellg();
-        string next_line;
-        if (getline(vcf_stream, next_line)) {
-            istringstream next_iss(next_line);
-            string next_chrom;
-            int next_pos;
-            next_iss >> next_chrom >> next_pos;
-            if (next_pos == pos) {
-                removed_mutation += 1;
-                prev_pos = pos;
-                continue;
-            }
-            vcf_stream.seekg(old_pos);
-        }
-        int individual_index = 0;
-        while (iss >> genotype) {
-            if (genotypes.size() < 2*individual_index + 2) {
-                genotypes.resize(2*individual_index + 2);
-            }
-            if (genotype[0] == '1') {
-                genotypes[2*individual_index] = 1;
-            } else {
-                genotypes[2*individual_index] = 0;
-            }
-            if (genotype[2] == '1') {
-                genotypes[2*individual_index + 1] = 1;
-            } else {
-                genotypes[2*individual_index + 1] = 0;
-            }
-            individual_index += 1;
+        if (reader.next_position == pos) {
+            removed_mutation += 1;
+            prev_pos = pos;
+            continue;
         }
+        reader.read_genotypes(genotypes);
         if (nodes.size() == 0) {
             nodes.resize(genotypes.size());
             for (int i = 0; i < nodes.size(); i++) {
@@ -249,16 +165,89 @@ void Sampler::guide_read_vcf(string prefix, double start, double end) {
 }
 
 void Sampler::load_vcf(string prefix, double start, double end) {
-    string index_file = prefix + ".index";
-    ifstream idx_stream(index_file);
-    if (idx_stream.is_open()) {
+    if (block_window) {
         guide_read_vcf(prefix, start, end);
     } else {
         naive_read_vcf(prefix, start, end);
     }
 }
 
+void Sampler::load_vcf(Genotype_cache &cache, double start, double end) {
+    rng.seed(random_seed);
+    pair<int, int> sites = cache.site_range(start, end, false);
+    vector<Node_ptr> nodes = {};
+    if (sites.first < sites.second) {
+        nodes = add_sample_nodes(cache.num_haplotypes());
+    }
+    int valid_mutation = add_cached_sites(cache, nodes, sites.first, sites.second, start);
+    int removed_mutation = cache.count_removed(start, end, false);
+    if (valid_mutation < 3) {
+        cerr << "there are too few variants in this region, algorithm not run" << endl;
+    }
+    num_samples = (int) sample_nodes.size();
+    ordered_sample_nodes = vector<Node_ptr>(sample_nodes.begin(), sample_nodes.end());
+    sequence_length = end - start;
+    cout << "valid mutations: " << valid_mutation << endl;
+    cout << "removed mutations: " << removed_mutation << endl;
+    num_valid_sites = valid_mutation;
+}
+
+vector<Node_ptr> Sampler::add_sample_nodes(int n) {
+    vector<Node_ptr> nodes = vector<Node_ptr>(n);
+    for (int i = 0; i < n; i++) {
+        nodes[i] = new_node(0.0);
+        nodes[i]->set_index(i);
+        sample_nodes.insert(nodes[i]);
+    }
+    return nodes;
+}
+
+int Sampler::add_cached_sites(Genotype_cache &cache, vector<Node_ptr> &nodes, int x, int y, double start) {
+    int valid_mutation = 0;
+    int n = cache.num_haplotypes();
+    for (int i = x; i < y; i++) {
+        int count = cache.count_derived(i);
+        if (count < 1 or count >= n) {
+            continue;
+        }
+        valid_mutation += 1;
+        double pos = cache.positions[i];
+        const uint64_t *row = cache.bits + i*cache.header.words_per_site;
+        for (int j = 0; j < cache.header.words_per_site; j++) {
+            uint64_t word = row[j];
+            while (word != 0) {
+                nodes[j*64 + __builtin_ctzll(word)]->add_mutation(pos - start);
+                word &= word - 1;
+            }
+        }
+    }
+    return valid_mutation;
+}
+
 void Sampler::load_haps(string prefix, double start, double end) {
+    int valid_mutation = 0;
+    int removed_mutation = 0;
+    Genotype_cache cache = Genotype_cache();
+    if (cache.map(prefix + ".haps")) {
+        pair<int, int> sites = cache.site_range(start, end, true);
+        vector<Node_ptr> nodes = {};
+        if (sites.first < sites.second) {
+            nodes = add_sample_nodes(cache.num_haplotypes());
+        }
+        valid_mutation = add_cached_sites(cache, nodes, sites.first, sites.second, start);
+        removed_mutation = sites.second - sites.first - valid_mutation;
+    } else {
+        read_haps_lines(prefix, start, end, valid_mutation, removed_mutation);
+    }
+    num_samples = (int)sample_nodes.size();
+    ordered_sample_nodes = vector<Node_ptr>(sample_nodes.begin(), sample_nodes.end());
+    sequence_length = end - start;
+    cout << "Valid mutations: " << valid_mutation << endl;
+    cout << "Removed mutations: " << removed_mutation << endl;
+    num_valid_sites = valid_mutation;
+}
+
+void Sampler::read_haps_lines(string prefix, double start, double end, int &valid_mutation, int &removed_mutation) {
     string haps_file = prefix + ".haps";
     ifstream file(haps_file);
     if (!file.is_open()) {
@@ -266,8 +255,6 @@ void Sampler::load_haps(string prefix, double start, double end) {
         return;
     }
     string line;
-    int valid_mutation = 0;
-    int removed_mutation = 0;
     vector<Node_ptr> nodes = {};
 
     while (getline(file, line)) {
@@ -311,12 +298,6 @@ void Sampler::load_haps(string prefix, double start, double end) {
             removed_mutation++;
         }
     }
-    num_samples = (int)sample_nodes.size();
-    ordered_sample_nodes = vector<Node_ptr>(sample_nodes.begin(), sample_nodes.end());
-    sequence_length = end - start;
-    cout << "Valid mutations: " << valid_mutation << endl;
-    cout << "Removed mutations: " << removed_mutation << endl;
-    num_valid_sites = valid_mutation;
 }
 
 void Sampler::optimal_ordering() {
@@ -383,19 +364,26 @@ void Sampler::iterative_start() {
     build_singleton_arg();
     auto it = ordered_sample_nodes.begin();
     it++;
+    Threader_smc threader = Threader_smc(bsp_c, tsp_q);
+    threader.pe->penalty = penalty;
+    threader.pe->ancestral_prob = polar;
+    threader.checkpoint = checkpoint;
+    threader.exact_coalescent = exact_coalescent;
+    threader.set_random_context(rng);
+    threader.set_bsp_threads(bsp_threads);
     while (it != ordered_sample_nodes.end()) {
-        random_engine.seed(random_seed);
-        Threader_smc threader = Threader_smc(bsp_c, tsp_q);
-        threader.pe->penalty = penalty;
-        threader.pe->ancestral_prob = polar;
+        rng.seed(random_seed);
+        threader.reset();
         Node_ptr n = *it;
         threader.thread(arg, n);
+        record_bsp_cost(threader);
         arg.check_incompatibility();
         cout << "Number of flippings: " << arg.count_flipping() << endl;
         it++;
-        random_seed = random_engine();
+        random_seed = rng();
         write_iterative_start();
     }
+    report_bsp_cost();
     cout << "orignal ARG length: " << arg.get_arg_length() << endl;
     // normalize();
     rescale();
@@ -404,7 +392,11 @@ void Sampler::iterative_start() {
     string branch_file= output_prefix + "_start_branches_" + to_string(sample_index) + ".txt";
     string recomb_file = output_prefix + "_start_recombs_" + to_string(sample_index) + ".txt";
     string mut_file = output_prefix + "_start_muts_" + to_string(sample_index) + ".txt";
-    arg.write(node_file, branch_file, recomb_file, mut_file);
+    if (binary_output) {
+        write_checkpoint(output_prefix + "_start_arg_" + to_string(sample_index) + ".bin");
+    } else {
+        arg.write(node_file, branch_file, recomb_file, mut_file);
+    }
     string coord_file = output_prefix + "_coordinates.txt";
     arg.write_coordinates(coord_file);
 }
@@ -414,23 +406,30 @@ void Sampler::fast_iterative_start() {
     build_singleton_arg();
     auto it = ordered_sample_nodes.begin();
     it++;
+    Threader_smc threader = Threader_smc(bsp_c, tsp_q);
+    threader.pe->penalty = penalty;
+    threader.pe->ancestral_prob = polar;
+    threader.checkpoint = checkpoint;
+    threader.exact_coalescent = exact_coalescent;
+    threader.set_random_context(rng);
+    threader.set_bsp_threads(bsp_threads);
     while (it != ordered_sample_nodes.end()) {
-        random_engine.seed(random_seed);
-        Threader_smc threader = Threader_smc(bsp_c, tsp_q);
-        threader.pe->penalty = penalty;
-        threader.pe->ancestral_prob = polar;
+        rng.seed(random_seed);
+        threader.reset();
         Node_ptr n = *it;
         if (arg.sample_nodes.size() > 1) {
             threader.fast_thread(arg, n);
         } else {
             threader.thread(arg, n);
         }
+        record_bsp_cost(threader);
         arg.check_incompatibility();
         cout << "Number of flippings: " << arg.count_flipping() << endl;
         it++;
-        random_seed = random_engine();
+        random_seed = rng();
         write_iterative_start();
     }
+    report_bsp_cost();
     cout << "orignal ARG length: " << arg.get_arg_length() << endl;
     // normalize();
     rescale();
@@ -439,7 +438,11 @@ void Sampler::fast_iterative_start() {
     string branch_file= output_prefix + "_fast_start_branches_" + to_string(sample_index) + ".txt";
     string recomb_file = output_prefix + "_fast_start_recombs_" + to_string(sample_index) + ".txt";
     string mut_file = output_prefix + "_fast_start_muts_" + to_string(sample_index) + ".txt";
-    arg.write(node_file, branch_file, recomb_file, mut_file);
+    if (binary_output) {
+        write_checkpoint(output_prefix + "_fast_start_arg_" + to_string(sample_index) + ".bin");
+    } else {
+        arg.write(node_file, branch_file, recomb_file, mut_file);
+    }
     string coord_file = output_prefix + "_fast_coordinates.txt";
     arg.write_coordinates(coord_file);
 }
@@ -594,64 +597,100 @@ void Sampler::fast_terminal_sample(int num_iters) {
 */
 
 void Sampler::internal_sample(int num_iters, int spacing) {
+    Threader_smc threader = Threader_smc(bsp_c, tsp_q);
+    threader.pe->penalty = penalty;
+    threader.pe->ancestral_prob = polar;
+    threader.checkpoint = checkpoint;
+    threader.exact_coalescent = exact_coalescent;
+    threader.set_random_context(rng);
+    threader.set_bsp_threads(bsp_threads);
+    Sample_writer writer = Sample_writer();
+    shared_ptr<Cut_scheduler> scheduler = nullptr;
+    if (cut_threads > 1) {
+        scheduler = make_shared<Cut_scheduler>(threader, cut_threads, false);
+    }
     while (sample_index < num_iters) {
         cout << get_time() << " Iteration: " << to_string(sample_index) << endl;
         double updated_length = 0;
         cout << "Random seed: " << random_seed << endl;
-        random_engine.seed(random_seed);
+        rng.seed(random_seed);
+        if (scheduler != nullptr) {
+            scheduler->start(arg);
+        }
         while (updated_length < spacing*arg.sequence_length) {
-            Threader_smc threader = Threader_smc(bsp_c, tsp_q);
-            threader.pe->penalty = penalty;
-            threader.pe->ancestral_prob = polar;
-            tuple<double, Branch, double> cut_point = arg.sample_internal_cut();
+            if (scheduler != nullptr) {
+                updated_length += scheduler->rethread(arg, rng);
+                continue;
+            }
+            threader.reset();
+            tuple<double, Branch, double> cut_point = arg.sample_internal_cut(rng);
             threader.internal_rethread(arg, cut_point);
+            record_bsp_cost(threader);
             updated_length += arg.coordinates[threader.end_index] - arg.coordinates[threader.start_index];
             arg.clear_remove_info();
         }
+        if (scheduler != nullptr) {
+            record_bsp_cost(*scheduler);
+        }
+        collect_nodes();
+        report_bsp_cost();
         // normalize();
         rescale();
-        random_seed = random_engine();
-        write_sample();
+        random_seed = rng();
         arg.check_incompatibility();
         cout << "Start: " << arg.start << " , End: " << arg.end << endl;
-        string node_file = output_prefix + "_nodes_" + to_string(sample_index) + ".txt";
-        string branch_file= output_prefix + "_branches_" + to_string(sample_index) + ".txt";
-        string recomb_file = output_prefix + "_recombs_" + to_string(sample_index) + ".txt";
-        string mut_file = output_prefix + "_muts_" + to_string(sample_index) + ".txt";
+        write_sample(writer, "");
         sample_index += 1;
-        arg.write(node_file, branch_file, recomb_file, mut_file);
         cout << "Number of trees: " << arg.recombinations.size() << endl;
         cout << "Number of flippings: " << arg.count_flipping() << endl;
     }
 }
 
 void Sampler::fast_internal_sample(int num_iters, int spacing) {
+    Threader_smc threader = Threader_smc(bsp_c, tsp_q);
+    threader.pe->penalty = penalty;
+    threader.pe->ancestral_prob = polar;
+    threader.checkpoint = checkpoint;
+    threader.exact_coalescent = exact_coalescent;
+    threader.set_random_context(rng);
+    threader.set_bsp_threads(bsp_threads);
+    Sample_writer writer = Sample_writer();
+    shared_ptr<Cut_scheduler> scheduler = nullptr;
+    if (cut_threads > 1) {
+        scheduler = make_shared<Cut_scheduler>(threader, cut_threads, true);
+    }
     while (sample_index < num_iters) {
         cout << get_time() << " Iteration: " << to_string(sample_index) << endl;
         double updated_length = 0;
         cout << "Random seed: " << random_seed << endl;
-        random_engine.seed(random_seed);
+        rng.seed(random_seed);
+        if (scheduler != nullptr) {
+            scheduler->start(arg);
+        }
         while (updated_length < spacing*arg.sequence_length) {
-            Threader_smc threader = Threader_smc(bsp_c, tsp_q);
-            threader.pe->penalty = penalty;
-            threader.pe->ancestral_prob = polar;
-            tuple<double, Branch, double> cut_point = arg.sample_internal_cut();
+            if (scheduler != nullptr) {
+                updated_length += scheduler->rethread(arg, rng);
+                continue;
+            }
+            threader.reset();
+            tuple<double, Branch, double> cut_point = arg.sample_internal_cut(rng);
             threader.fast_internal_rethread(arg, cut_point);
+            record_bsp_cost(threader);
             updated_length += arg.coordinates[threader.end_index] - arg.coordinates[threader.start_index];
             arg.clear_remove_info();
         }
+        if (scheduler != nullptr) {
+            record_bsp_cost(*scheduler);
+        }
+        collect_nodes();
+        report_bsp_cost();
         // normalize();
         rescale();
-        random_seed = random_engine();
-        write_sample();
+        random_seed = rng();
         arg.check_incompatibility();
         cout << "Start: " << arg.start << " , End: " << arg.end << endl;
-        string node_file = output_prefix + "_fast_nodes_" + to_string(sample_index) + ".txt";
-        string branch_file= output_prefix + "_fast_branches_" + to_string(sample_index) + ".txt";
-        string recomb_file = output_prefix + "_fast_recombs_" + to_string(sample_index) + ".txt";
-        string mut_file = output_prefix + "_fast_muts_" + to_string(sample_index) + ".txt";
+        write_sample(writer, "fast_");
         sample_index += 1;
-        arg.write(node_file, branch_file, recomb_file, mut_file);
         cout << "Number of trees: " << arg.recombinations.size() << endl;
         cout << "Number of flippings: " << arg.count_flipping() << endl;
     }
@@ -756,14 +795,97 @@ void Sampler::debug_resume_fast_internal_sample(int num_iters, int spacing) {
 
 void Sampler::normalize() {
     Normalizer nm = Normalizer();
+    nm.team = rescale_team();
     nm.normalize(arg, mut_rate);
 }
 
 void Sampler::rescale() {
     Scaler scaler = Scaler();
+    scaler.team = rescale_team();
     scaler.rescale(arg, mut_rate);
 }
 
+Thread_team *Sampler::rescale_team() {
+    int n = max(bsp_threads, cut_threads);
+    if (n <= 1) {
+        return nullptr;
+    }
+    if (team == nullptr) {
+        team = make_shared<Thread_team>(n);
+    }
+    return team.get();
+}
+
+void Sampler::collect_nodes() {
+    arg.mark_nodes();
+    for (Node_ptr n : sample_nodes) {
+        n->marked = true;
+    }
+    for (Node_ptr n : ordered_sample_nodes) {
+        n->marked = true;
+    }
+    node_pool().sweep();
+}
+
+void Sampler::record_bsp_cost(Threader_smc &threader) {
+    pruner_time += threader.pruner_time;
+    forward_time += threader.forward_time;
+    traceback_time += threader.traceback_time;
+    tsp_time += threader.tsp_time;
+    add_time += threader.add_time;
+    recombination_time += threader.recombination_time;
+    forward_memory = max(forward_memory, threader.forward_memory);
+}
+
+void Sampler::record_bsp_cost(Cut_scheduler &scheduler) {
+    pruner_time += scheduler.pruner_time;
+    forward_time += scheduler.forward_time;
+    traceback_time += scheduler.traceback_time;
+    tsp_time += scheduler.tsp_time;
+    add_time += scheduler.add_time;
+    recombination_time += scheduler.recombination_time;
+    forward_memory = max(forward_memory, scheduler.forward_memory);
+    cout << "Cuts rethreaded concurrently: " << scheduler.num_batched << ", after an overlap: " << scheduler.num_deferred << endl;
+    scheduler.pruner_time = 0;
+    scheduler.forward_time = 0;
+    scheduler.traceback_time = 0;
+    scheduler.tsp_time = 0;
+    scheduler.add_time = 0;
+    scheduler.recombination_time = 0;
+    scheduler.forward_memory = 0;
+    scheduler.num_batched = 0;
+    scheduler.num_deferred = 0;
+}
+
+void Sampler::report_bsp_cost() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    double max_rss = usage.ru_maxrss/1048576.0;
+#else
+    double max_rss = usage.ru_maxrss/1024.0;
+#endif
+    cout << "Pruner time: " << pruner_time << " s, BSP forward time: " << forward_time << " s, traceback time: " << traceback_time << " s" << endl;
+    cout << "TSP time: " << tsp_time << " s, adding time: " << add_time << " s, recombination time: " << recombination_time << " s" << endl;
+    cout << "BSP forward storage: " << forward_memory/1048576.0 << " MB (checkpoint " << checkpoint << "), max RSS: " << max_rss << " MB" << endl;
+    pruner_time = 0;
+    forward_time = 0;
+    traceback_time = 0;
+    tsp_time = 0;
+    add_time = 0;
+    recombination_time = 0;
+    forward_memory = 0;
+}
+
+static void append_line(string filename, string line) {
+    ofstream file(filename, ios::out|ios::app);
+    if (!file) {
+        cerr << "Error opening the file: " << filename << endl;
+        return;
+    }
+    file << line << endl;
+}
+
 void Sampler::start_log() {
     string filename = output_prefix + ".log";
     ofstream file(filename, ios::out|ios::trunc);
@@ -800,14 +922,10 @@ void Sampler::write_iterative_start() {
     << TSP_smc::counter << endl;
 }
 
-void Sampler::write_sample() {
-    string filename = output_prefix + ".log";
-    ofstream file(filename, ios::out|ios::app);
-    if (!file) {
-        cerr << "Error opening the file: " << filename << endl;
-        return;
-    }
-    file << get_time() << "\t"
+void Sampler::write_sample(Sample_writer &writer, string tag) {
+    string log_file = output_prefix + ".log";
+    ostringstream line;
+    line << get_time() << "\t"
     << sample_index << "\t"
     << "rethread" << "\t"
     << arg.recombinations.size() - 2 << "\t"
@@ -815,7 +933,29 @@ void Sampler::write_sample() {
     << setprecision(numeric_limits<double>::max_digits10)
     << arg.end << "\t"
     << random_seed << "\t"
-    << TSP::counter << endl;
+    << TSP::counter;
+    string log_line = line.str();
+    // the log line goes in after the sample, so a resume never finds a sample that is not all there
+    if (binary_output) {
+        shared_ptr<Checkpoint> c = make_shared<Checkpoint>();
+        save_state(*c);
+        string filename = checkpoint_file(sample_index);
+        writer.push([c, filename, log_file, log_line]() {
+            c->write(filename);
+            append_line(log_file, log_line);
+        });
+    } else {
+        shared_ptr<ARG_tables> tables = make_shared<ARG_tables>(arg.get_tables());
+        string index = to_string(sample_index);
+        string node_file = output_prefix + "_" + tag + "nodes_" + index + ".txt";
+        string branch_file = output_prefix + "_" + tag + "branches_" + index + ".txt";
+        string recomb_file = output_prefix + "_" + tag + "recombs_" + index + ".txt";
+        string mut_file = output_prefix + "_" + tag + "muts_" + index + ".txt";
+        writer.push([tables, node_file, branch_file, recomb_file, mut_file, log_file, log_line]() {
+            tables->write(node_file, branch_file, recomb_file, mut_file);
+            append_line(log_file, log_line);
+        });
+    }
 }
 
 void Sampler::write_cut(tuple<double, Branch, double> cut_point) {
@@ -896,15 +1036,68 @@ vector<string> Sampler::read_last_line(string filename) {
     return words;
 }
 
+string Sampler::checkpoint_file(int index) {
+    if (!fast_mode) {
+        return output_prefix + "_arg_" + to_string(index) + ".bin";
+    } else {
+        return output_prefix + "_fast_arg_" + to_string(index) + ".bin";
+    }
+}
+
+void Sampler::save_state(Checkpoint &c) {
+    arg.write_checkpoint(c);
+    c.header.sample_index = sample_index;
+    c.header.random_seed = random_seed;
+    c.header.counter = TSP::counter;
+    ostringstream rng_state;
+    rng_state << rng;
+    c.rng_state = rng_state.str();
+}
+
+void Sampler::restore_state(Checkpoint &c) {
+    arg = ARG(Ne, sequence_length);
+    arg.read_checkpoint(c);
+    arg.compute_rhos_thetas(recomb_map, mut_map);
+    arg.end = c.header.end;
+    sample_index = (int) c.header.sample_index;
+    random_seed = (int) c.header.random_seed;
+    TSP::counter = (int) c.header.counter;
+    istringstream rng_state(c.rng_state);
+    rng_state >> rng;
+    sample_nodes = arg.sample_nodes;
+    ordered_sample_nodes = vector<Node_ptr>(sample_nodes.begin(), sample_nodes.end());
+}
+
+void Sampler::write_checkpoint(string filename) {
+    Checkpoint c = Checkpoint();
+    save_state(c);
+    c.write(filename);
+}
+
+void Sampler::load_checkpoint(string filename) {
+    Checkpoint c = Checkpoint();
+    c.read(filename);
+    if (c.header.Ne != Ne or c.header.sequence_length != sequence_length) {
+        cerr << "checkpoint does not match the population size or region: " << filename << endl;
+        exit(1);
+    }
+    restore_state(c);
+}
+
 void Sampler::read_resume_point(string filename) {
     vector<string> words = read_last_line(filename);
     int log_length = (int) words.size();
-    TSP::counter = stoi(words[log_length - 1]);
-    // random_seed = stoi(words[log_length - 2]);
     sample_index = stoi(words[1]);
-    load_resume_arg();
-    arg.sequence_length = sequence_length;
-    arg.end = stof(words[log_length - 3]);
+    string resume_file = checkpoint_file(sample_index);
+    if (ifstream(resume_file).good()) { // the checkpoint also restores the seed, so the chain continues as if never stopped
+        load_checkpoint(resume_file);
+    } else {
+        TSP::counter = stoi(words[log_length - 1]);
+        // random_seed = stoi(words[log_length - 2]);
+        load_resume_arg();
+        arg.sequence_length = sequence_length;
+        arg.end = stof(words[log_length - 3]);
+    }
     arg.end_tree = arg.get_tree_at(arg.end);
 }
 
@@ -11,13 +11,17 @@
 #include <stdio.h>
 #include <chrono>
 #include <sstream>
+#include <sys/resource.h>
 #include "ARG.hpp"
 #include "Threader_smc.hpp"
+#include "Cut_scheduler.hpp"
+#include "Sample_writer.hpp"
 #include "Binary_emission.hpp"
 #include "Emission.hpp"
 #include "Normalizer.hpp"
 #include "Scaler.hpp"
 #include "Rate_map.hpp"
+#include "Genotype_cache.hpp"
 
 class Sampler {
     
@@ -41,6 +45,7 @@ public:
     double bsp_c = 0.01;
     double tsp_q = 0.05;
     int random_seed = 0;
+    Random_context rng; // reseeded from random_seed at every iteration, so a chain does not depend on the thread running it
     double penalty = 0.01;
     double polar = 0.99;
     int sample_index = 0;
@@ -51,6 +56,21 @@ public:
     
     int num_valid_sites = 0;
     
+    int checkpoint = 0;
+    int bsp_threads = 1;
+    int cut_threads = 1; // cuts in disjoint intervals rethreaded at the same time, see Cut_scheduler
+    shared_ptr<Thread_team> team = nullptr; // shares the rescaling passes, started at the first one
+    bool binary_output = false; // write each sample as one binary checkpoint instead of text files
+    bool block_window = false; // read the VCF window as parallel_singer blocks do: [start, end), samples in input order
+    bool exact_coalescent = false; // BSP prior from the exact coalescence times instead of the approximation
+    double pruner_time = 0;
+    double forward_time = 0;
+    double traceback_time = 0;
+    double tsp_time = 0;
+    double add_time = 0;
+    double recombination_time = 0;
+    size_t forward_memory = 0;
+    
     Sampler(double pop_size, double r, double m);
     
     Sampler(double pop_size, Rate_map &recomb_map, Rate_map &mut_map);
@@ -71,12 +91,22 @@ public:
     
     void naive_read_vcf(string prefix, double start_pos, double end_pos);
     
+    void read_vcf_lines(string prefix, double start_pos, double end_pos, int &valid_mutation, int &removed_mutation);
+    
     void guide_read_vcf(string prefix, double start, double end);
     
     void load_vcf(string prefix, double start, double end);
     
+    void load_vcf(Genotype_cache &cache, double start, double end); // same sites as guide_read_vcf, from a genotype cache
+    
     void load_haps(string prefix, double start, double end);
     
+    void read_haps_lines(string prefix, double start, double end, int &valid_mutation, int &removed_mutation);
+    
+    vector<Node_ptr> add_sample_nodes(int n);
+    
+    int add_cached_sites(Genotype_cache &cache, vector<Node_ptr> &nodes, int x, int y, double start); // polymorphic sites in [x, y), returns their number
+    
     void optimal_ordering();
     
     Node_ptr build_node(int index, double time);
@@ -119,16 +149,36 @@ public:
     
     void rescale();
     
+    Thread_team *rescale_team(); // null unless -bsp_threads or -cut_threads asks for threads
+    
+    void collect_nodes();
+    
+    void record_bsp_cost(Threader_smc &threader);
+    
+    void record_bsp_cost(Cut_scheduler &scheduler);
+    
+    void report_bsp_cost();
+    
     void start_log();
     
     void write_iterative_start();
     
-    void write_sample();
+    void write_sample(Sample_writer &writer, string tag); // queue the sample and its log line, tag is "fast_" in fast mode
     
     void write_cut(tuple<double, Branch, double> cut_point);
     
     void load_resume_arg();
     
+    string checkpoint_file(int index);
+    
+    void save_state(Checkpoint &c); // ARG, sample index, seed and generator state
+    
+    void restore_state(Checkpoint &c); // the nodes are rebuilt in this thread's pool
+    
+    void write_checkpoint(string filename);
+    
+    void load_checkpoint(string filename);
+    
     vector<string> read_last_line(string filename);
     
     void read_resume_point(string filename);
@@ -10,35 +10,29 @@
 Scaler::Scaler() {}
 
 void Scaler::compute_deltas(ARG &a) {
+    Node_spans node_spans = Node_spans();
+    node_spans.reserve(a.recombinations.size() + 1);
     // the base case
-    map<Node_ptr, double, compare_node> node_start = {};
-    map<Node_ptr, double, compare_node> node_span = {};
     for (const Branch &b : a.recombinations.begin()->second.inserted_branches) {
-        node_start[b.upper_node] = 0;
+        if (b.upper_node != a.root) {
+            node_spans.start(b.upper_node, 0);
+        }
     }
-    node_start.erase(a.root);
     auto r_it = next(a.recombinations.begin());
     while (next(r_it) != a.recombinations.end()) {
         Recombination &r = r_it->second;
-        Node_ptr dn = r.deleted_node;
-        Node_ptr in = r.inserted_node;
-        assert(node_start.count(dn) > 0);
-        node_span[dn] += r.pos - node_start[dn];
-        node_start.erase(dn);
-        node_start[in] = r_it->first;
+        node_spans.stop(r.deleted_node, r.pos);
+        node_spans.start(r.inserted_node, r_it->first);
         r_it++;
     }
-    for (auto &x : node_start) {
-        Node_ptr n = x.first;
-        node_span[n] += a.sequence_length - node_start[n];
-    }
+    node_spans.stop_all(a.sequence_length);
     // the root case
-    map<Node_ptr, double, compare_node> root_start = {};
+    node_spans.clear_starts();
     Branch prev_branch;
     Branch next_branch;
     Recombination &r = a.recombinations.begin()->second;
     prev_branch = *(r.inserted_branches.rbegin());
-    root_start[prev_branch.lower_node] = 0;
+    node_spans.start(prev_branch.lower_node, 0);
     r_it = next(a.recombinations.begin());
     while (next(r_it)->first < a.sequence_length) {
         Recombination &r = r_it->second;
@@ -49,26 +43,22 @@ void Scaler::compute_deltas(ARG &a) {
             Node_ptr in = next_branch.lower_node;
             assert(dn != in);
             assert(next_branch.upper_node == a.root);
-            assert(root_start.count(dn) > 0);
-            node_span[dn] += r.pos - root_start[dn];
-            root_start.erase(dn);
-            root_start[in] = r.pos;
+            node_spans.stop(dn, r.pos);
+            node_spans.start(in, r.pos);
         } else {
             assert(next_branch.upper_node != a.root);
         }
         r_it++;
     }
-    for (auto &x : root_start) {
-        Node_ptr n = x.first;
-        node_span[n] += a.sequence_length - x.second;
-    }
+    node_spans.stop_all(a.sequence_length);
+    vector<int> sorted_ids = node_spans.sorted_ids();
     int num_samples = (int) a.sample_nodes.size();
-    sorted_nodes.resize(node_span.size() + num_samples);
-    node_deltas.resize(node_span.size() + num_samples);
+    sorted_nodes.resize(sorted_ids.size() + num_samples);
+    node_deltas.resize(sorted_ids.size() + num_samples);
     int index = num_samples;
-    for (auto &x : node_span) {
-        sorted_nodes[index] = x.first;
-        node_deltas[index] = -x.second;
+    for (int id : sorted_ids) {
+        sorted_nodes[index] = node_spans.nodes[id];
+        node_deltas[index] = -node_spans.spans[id];
         index++;
     }
     index = 0;
@@ -126,13 +116,17 @@ void Scaler::compute_new_grid(double theta) {
 
 void Scaler::map_mutations(ARG &a) {
     observed_arg_length.resize(num_windows);
+    Grid_counter counter = Grid_counter();
     for (auto &x : a.mutation_branches) {
         if (x.first > 0 and x.first < a.sequence_length) {
             for (auto &y : x.second) {
-                add_mutation(1.0, y.lower_node->time, y.upper_node->time);
+                if (!isinf(y.upper_node->time)) {
+                    counter.add(y.lower_node->time, y.upper_node->time);
+                }
             }
         }
     }
+    counter.count(old_grid, observed_arg_length, team);
     double num_sites = a.mutation_sites.size() - 2;
     double num_muts = accumulate(observed_arg_length.begin(), observed_arg_length.end(), 0.0);
     double r = num_sites/num_muts;
@@ -141,24 +135,6 @@ void Scaler::map_mutations(ARG &a) {
     }
 }
 
-void Scaler::add_mutation(double w, double lb, double ub) {
-    if (isinf(ub)) {
-        return;
-    }
-    double x, y, l;
-    int index;
-    auto it = upper_bound(old_grid.begin(), old_grid.end(), lb);
-    it--;
-    index = (int) distance(old_grid.begin(), it);
-    while (old_grid[index] < ub) {
-        x = old_grid[index];
-        y = old_grid[index + 1];
-        l = min(ub, y) - max(lb, x);
-        observed_arg_length[index] += w*l/(ub - lb);
-        index++;
-    }
-}
-
 void Scaler::rescale(ARG &a, double theta) {
     compute_deltas(a);
     compute_old_grid();
@@ -180,8 +156,13 @@ void Scaler::rescale(ARG &a, double theta) {
     for (int i = 0; i < sorted_nodes.size() - 1; i++) {
         assert(sorted_nodes[i]->time <= sorted_nodes[i+1]->time);
     }
+    a.tree_map.clear(); // stored trees are ordered by node times
     for (auto &x : a.recombinations) {
         x.second.start_time = -1;
     }
-    a.adjust_recombinations();
+    if (team != nullptr) {
+        a.adjust_recombinations(*team);
+    } else {
+        a.adjust_recombinations();
+    }
 }
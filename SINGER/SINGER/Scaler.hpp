@@ -11,12 +11,15 @@
 #include <stdio.h>
 #include "random_utils.hpp"
 #include "ARG.hpp"
+#include "Node_spans.hpp"
+#include "Grid_counter.hpp"
 
 class Scaler {
     
 public:
     
     int num_windows = 100;
+    Thread_team *team = nullptr; // shares the mutation counts and the recombination times
     vector<Node_ptr> sorted_nodes = {};
     vector<double> node_deltas = {};
     vector<double> rates = {};
@@ -37,8 +40,6 @@ public:
     
     void map_mutations(ARG &a);
     
-    void add_mutation(double w, double lb, double ub);
-    
     void rescale(ARG &a, double theta);
     
 };
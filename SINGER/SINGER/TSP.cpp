@@ -7,7 +7,7 @@
 
 #include "TSP.hpp"
 
-int TSP::counter = 0;
+thread_local int TSP::counter = 0;
 
 TSP::TSP() {
 }
@@ -18,11 +18,38 @@ TSP::~TSP() {
             delete interval;
         }
     }
-    vector<vector<double>>().swap(forward_probs);
     map<Interval *, Interval *>().swap(source_interval);
     map<int, vector<Interval *>>().swap(state_spaces);
 }
 
+void TSP::reset() {
+    for (auto &x : state_spaces) {
+        for (Interval *interval : x.second) {
+            delete interval;
+        }
+    }
+    cut_time = 0;
+    lower_bound = 0;
+    check_points.clear();
+    curr_index = 0;
+    curr_branch = Branch();
+    curr_intervals.clear();
+    state_spaces.clear();
+    state_spaces[INT_MAX] = {};
+    source_interval.clear();
+    rhos.clear();
+    thetas.clear();
+    prev_rho = -1;
+    prev_theta = -1;
+    prev_node = nullptr;
+    dim = 0;
+    clear_kernels();
+    temp.clear();
+    sample_index = -1;
+    trace_back_probs.clear();
+    forward_probs.clear();
+}
+
 void TSP::set_gap(double q) {
     gap = q;
 }
@@ -48,11 +75,12 @@ void TSP::start(Branch &branch, double t) {
     generate_intervals(branch, branch.lower_node->time, branch.upper_node->time);
     set_dimensions();
     compute_factors();
+    compute_kernel_terms();
     for (int i = 0; i < curr_intervals.size(); i++) {
-        temp[i] = exp(-curr_intervals[i]->lb) - exp(-curr_intervals[i]->ub);
+        temp[i] = interval_masses[i];
     }
     state_spaces[0] = curr_intervals;
-    forward_probs.emplace_back(temp);
+    forward_probs.add_row(temp);
     temp.clear();
 }
 
@@ -98,10 +126,12 @@ void TSP::transfer(Recombination &r, Branch &prev_branch, Branch &next_branch) {
         generate_intervals(next_branch, lb, ub);
     }
     state_spaces[curr_index] = curr_intervals;
-    forward_probs.emplace_back(temp);
+    forward_probs.add_row(temp);
     temp.clear();
     set_dimensions();
     compute_factors();
+    compute_kernel_terms();
+    clear_kernels();
 }
 
 void TSP::recombine(Branch &prev_branch, Branch &next_branch) {
@@ -116,10 +146,12 @@ void TSP::recombine(Branch &prev_branch, Branch &next_branch) {
     curr_index += 1;
     lower_bound = max(cut_time, next_branch.lower_node->time);
     generate_intervals(next_branch, next_branch.lower_node->time, next_branch.upper_node->time);
-    forward_probs.emplace_back(temp);
+    forward_probs.add_row(temp);
     state_spaces[curr_index] = curr_intervals;
     set_dimensions();
     compute_factors();
+    compute_kernel_terms();
+    clear_kernels();
     double new_prob;
     double base;
     for (int i = 0; i < prev_intervals.size(); i++) {
@@ -134,7 +166,7 @@ void TSP::recombine(Branch &prev_branch, Branch &next_branch) {
             forward_probs[curr_index][j] += new_prob + epsilon;
         }
     }
-    for (int i = 0; i < forward_probs[curr_index].size(); i++) {
+    for (int i = 0; i < forward_probs.dim(curr_index); i++) {
         assert(forward_probs[curr_index][i] >= 0);
     }
     temp.clear();
@@ -188,21 +220,52 @@ double TSP::recomb_cdf(double s, double t) {
 
 void TSP::forward(double rho) {
     rhos.emplace_back(rho);
-    compute_diagonals(rho);
-    compute_lower_diagonals(rho);
-    compute_upper_diagonals(rho);
+    if (rho != prev_rho and next_kernel < kernel_rhos.size() and kernel_rhos[next_kernel] == rho) {
+        const double *kernel = kernels.data() + 3*dim*next_kernel;
+        copy(kernel, kernel + dim, diagonals.begin());
+        copy(kernel + dim, kernel + 2*dim, lower_diagonals.begin());
+        copy(kernel + 2*dim, kernel + 3*dim, upper_diagonals.begin());
+        next_kernel += 1;
+    } else if (rho != prev_rho) {
+        compute_kernel(rho, diagonals.data(), lower_diagonals.data(), upper_diagonals.data(), kernel_exps.data());
+    }
     compute_lower_sums();
     compute_upper_sums();
     curr_index += 1;
     prev_rho = rho;
-    forward_probs.emplace_back(lower_sums);
+    double *curr_probs = forward_probs.add_row(lower_sums);
+    double *prev_probs = forward_probs[curr_index - 1];
     for (int i = 0; i < dim; i++) {
-        assert(forward_probs[curr_index][i] >= 0);
-        forward_probs[curr_index][i] += diagonals[i]*forward_probs[curr_index-1][i] + lower_diagonals[i]*upper_sums[i];
-        if (curr_intervals[i]->lb != curr_intervals[i]->ub or forward_probs[curr_index][i] > 0) {
-            forward_probs[curr_index][i] = max(epsilon, forward_probs[curr_index][i]);
+        assert(curr_probs[i] >= 0);
+        curr_probs[i] += diagonals[i]*prev_probs[i] + lower_diagonals[i]*upper_sums[i];
+        if (curr_intervals[i]->lb != curr_intervals[i]->ub or curr_probs[i] > 0) {
+            curr_probs[i] = max(epsilon, curr_probs[i]);
+        }
+    }
+}
+
+void TSP::prepare_forward(const double *bin_rhos, int n) {
+    clear_kernels();
+    double rho = prev_rho;
+    for (int i = 0; i < n; i++) {
+        if (bin_rhos[i] != rho) {
+            kernel_rhos.push_back(bin_rhos[i]);
         }
+        rho = bin_rhos[i];
+    }
+    int num_kernels = (int) kernel_rhos.size();
+    if (team == nullptr or num_kernels < 2 or num_kernels*dim < min_team_work) {
+        kernel_rhos.clear(); // not worth a hand-off, forward computes them
+        return;
     }
+    kernels.resize(3*dim*num_kernels);
+    team->run_parts(num_kernels, [this](int x, int y) {
+        vector<double> exps(kernel_exps.size());
+        for (int k = x; k < y; k++) {
+            double *kernel = kernels.data() + 3*dim*k;
+            compute_kernel(kernel_rhos[k], kernel, kernel + dim, kernel + 2*dim, exps.data());
+        }
+    });
 }
 
 void TSP::null_emit(double theta, Node_ptr query_node) {
@@ -210,19 +273,20 @@ void TSP::null_emit(double theta, Node_ptr query_node) {
     prev_theta = theta;
     prev_node = query_node;
     double ws = 0;
-    assert(dim == forward_probs[curr_index].size());
+    assert(dim == forward_probs.dim(curr_index));
+    double *curr_probs = forward_probs[curr_index];
     for (int i = 0; i < dim; i++) {
-        assert(forward_probs[curr_index][i] >= 0);
-        forward_probs[curr_index][i] *= null_emit_probs[i];
-        ws += forward_probs[curr_index][i];
+        assert(curr_probs[i] >= 0);
+        curr_probs[i] *= null_emit_probs[i];
+        ws += curr_probs[i];
     }
     if (ws > 0) {
         for (int i = 0; i < dim; i++) {
-            forward_probs[curr_index][i] /= ws;
+            curr_probs[i] /= ws;
         }
     } else {
         for (int i = 0; i < dim; i++) {
-            forward_probs[curr_index][i] = 1.0/forward_probs[curr_index].size();
+            curr_probs[i] = 1.0/dim;
         }
     }
 }
@@ -230,13 +294,14 @@ void TSP::null_emit(double theta, Node_ptr query_node) {
 void TSP::mut_emit(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node) {
     compute_mut_emit_probs(theta, bin_size, mut_set, query_node);
     double ws = 0;
+    double *curr_probs = forward_probs[curr_index];
     for (int i = 0; i < dim; i++) {
-        forward_probs[curr_index][i] *= mut_emit_probs[i];
-        ws += forward_probs[curr_index][i];
+        curr_probs[i] *= mut_emit_probs[i];
+        ws += curr_probs[i];
     }
     assert(ws > 0);
     for (int i = 0; i < dim; i++) {
-        forward_probs[curr_index][i] /= ws;
+        curr_probs[i] /= ws;
     }
 }
 
@@ -312,8 +377,12 @@ double TSP::psmc_cdf(double rho, double s, double t) {
     } else {
         pre_factor = (1 - exp(-rho*l))/l;
     }
+    double cdf = pre_factor*psmc_integral(s, t);
+    return cdf;
+}
+
+double TSP::psmc_integral(double s, double t) {
     double integral;
-    double cdf;
     if (t == cut_time and t == lower_bound) {
         return 0;
     } else if (t <= s) {
@@ -321,8 +390,7 @@ double TSP::psmc_cdf(double rho, double s, double t) {
     } else {
         integral = 2*s + exp(cut_time - t) + exp(lower_bound - t) - 2*exp(s-t) - cut_time - lower_bound;
     }
-    cdf = pre_factor*integral;
-    return cdf;
+    return integral;
 }
 
 double TSP::standard_recomb_cdf(double rho, double s, double t) {
@@ -437,12 +505,12 @@ void TSP::set_dimensions() {
     upper_sums.resize(dim); upper_sums.assign(dim, 0);
     null_emit_probs.resize(dim); null_emit_probs.assign(dim, 0);
     mut_emit_probs.resize(dim); mut_emit_probs.assign(dim, 0);
+    time_points.resize(dim);
     factors.resize(dim); factors.assign(dim, 0);
 }
 
 double TSP::random() {
-    double p = uniform_random();
-    return p;
+    return rng->uniform();
 }
 
 double TSP::get_prop(double lb1, double ub1, double lb2, double ub2) {
@@ -462,74 +530,132 @@ void TSP::compute_null_emit_probs(double theta, Node_ptr query_node) {
         return;
     }
     for (int i = 0; i < dim; i++) {
-        null_emit_probs[i] = eh->null_emit(curr_branch, curr_intervals[i]->time, theta, query_node);
+        time_points[i] = curr_intervals[i]->time;
     }
+    lower_times.assign(dim, curr_branch.lower_node->time);
+    upper_times.assign(dim, curr_branch.upper_node->time);
+    eh->null_emit(time_points, lower_times, upper_times, theta, query_node, null_emit_probs);
 }
 
 void TSP::compute_mut_emit_probs(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node) {
     compute_emissions(mut_set, curr_branch, query_node);
     for (int i = 0; i < dim; i++) {
-        mut_emit_probs[i] = eh->emit(curr_branch, curr_intervals[i]->time, theta, bin_size, emissions, query_node);
+        time_points[i] = curr_intervals[i]->time;
     }
+    eh->emit(time_points, curr_branch, theta, bin_size, emissions, query_node, mut_emit_probs);
 }
 
-void TSP::compute_diagonals(double rho) {
-    if (rho == prev_rho) {
-        return;
-    }
-    double t;
-    double base;
+void TSP::compute_kernel_terms() {
+    // row i of the diagonals stays in or jumps to interval i from its own time, row i of the lower
+    // diagonals jumps to it from interval i + 1 and row i of the upper diagonals from interval i - 1
     double lb = curr_intervals.front()->lb;
+    double jump_lb = max(cut_time, lb);
     double ub = curr_intervals.back()->ub;
-    Interval *curr_interval = nullptr;
-    double diag = 0;
-    double stay_prob = 0;
-    double jump_prob = 0;
-    double full_jump_prob = 0;
+    vector<double> points = {};
+    cdf_integrals.clear();
+    empty_jumps.clear();
+    for (int i = 0; i < dim; i++) {
+        double s = curr_intervals[i]->time;
+        points.push_back(s);
+        add_jump_terms(s, lb, ub, points);
+        add_jump_terms(s, curr_intervals[i]->lb, curr_intervals[i]->ub, points);
+    }
     for (int i = 0; i < dim; i++) {
-        curr_interval = curr_intervals[i];
-        t = curr_interval->time;
-        stay_prob = non_recomb_prob(rho, t);
-        full_jump_prob = psmc_prob(rho, t, lb, ub);
-        base = stay_prob + full_jump_prob;
-        jump_prob = psmc_prob(rho, t, curr_interval->lb, curr_interval->ub);
-        diag = stay_prob + jump_prob;
-        diagonals[i] = diag/base;
-        assert(!isnan(diagonals[i]));
+        double s = curr_intervals[min(i + 1, dim - 1)]->time;
+        points.push_back(s);
+        add_jump_terms(s, jump_lb, i < dim - 1 ? ub : jump_lb, points);
+        add_jump_terms(s, curr_intervals[i]->lb, curr_intervals[i]->ub, points);
     }
+    for (int i = 0; i < dim; i++) {
+        double s = curr_intervals[max(i - 1, 0)]->time;
+        points.push_back(s);
+        add_jump_terms(s, jump_lb, i > 0 ? ub : jump_lb, points);
+        add_jump_terms(s, curr_intervals[i]->lb, curr_intervals[i]->ub, points);
+    }
+    vector<double> xs = points;
+    sort(xs.begin(), xs.end());
+    xs.erase(unique(xs.begin(), xs.end()), xs.end());
+    kernel_lengths.resize(xs.size());
+    for (int p = 0; p < xs.size(); p++) {
+        kernel_lengths[p] = 2*xs[p] - lower_bound - cut_time;
+    }
+    stay_points.resize(3*dim);
+    cdf_points.resize(4*3*dim);
+    for (int r = 0; r < 3*dim; r++) {
+        for (int j = 0; j < 5; j++) {
+            double x = points[5*r + j];
+            int p = (int) (std::lower_bound(xs.begin(), xs.end(), x) - xs.begin());
+            if (j == 0) {
+                stay_points[r] = p;
+            } else {
+                cdf_points[4*r + j - 1] = p;
+            }
+        }
+    }
+    kernel_exps.resize(2*xs.size());
 }
 
-void TSP::compute_lower_diagonals(double rho) {
-    if (rho == prev_rho) {
-        return;
+void TSP::add_jump_terms(double s, double t1, double t2, vector<double> &points) {
+    assert(s != numeric_limits<double>::infinity());
+    assert(t1 <= t2);
+    assert(t1 >= lower_bound and s >= lower_bound);
+    empty_jumps.push_back(t1 == t2);
+    points.push_back(t2 <= s ? t2 : s);
+    cdf_integrals.push_back(psmc_integral(s, t2));
+    points.push_back(t1 <= s ? t1 : s);
+    cdf_integrals.push_back(psmc_integral(s, t1));
+}
+
+void TSP::compute_kernel(double rho, double *diagonal_values, double *lower_values, double *upper_values, double *exps) {
+    int n = (int) kernel_lengths.size();
+    double *stay_probs = exps;
+    double *pre_factors = exps + n;
+    for (int p = 0; p < n; p++) {
+        stay_probs[p] = exp(-rho*kernel_lengths[p]);
+    }
+    for (int p = 0; p < n; p++) {
+        double l = kernel_lengths[p];
+        pre_factors[p] = l == 0 ? rho : (1 - stay_probs[p])/l;
     }
-    double t;
     double base;
-    lower_diagonals[dim-1] = 0;
-    double lb = max(cut_time, curr_intervals.front()->lb);
-    double ub = curr_intervals.back()->ub;
+    for (int i = 0; i < dim; i++) {
+        int r = i;
+        double stay_prob = stay_probs[stay_points[r]];
+        base = stay_prob + kernel_jump_prob(2*r, pre_factors);
+        diagonal_values[i] = (stay_prob + kernel_jump_prob(2*r + 1, pre_factors))/base;
+        assert(!isnan(diagonal_values[i]));
+    }
     for (int i = 0; i < dim - 1; i++) {
-        t = curr_intervals[i+1]->time;
-        base = psmc_prob(rho, t, lb, ub) + non_recomb_prob(rho, t);
-        lower_diagonals[i] = psmc_prob(rho, t, curr_intervals[i]->lb, curr_intervals[i]->ub)/base;
+        int r = dim + i;
+        base = kernel_jump_prob(2*r, pre_factors) + stay_probs[stay_points[r]];
+        lower_values[i] = kernel_jump_prob(2*r + 1, pre_factors)/base;
+    }
+    lower_values[dim - 1] = 0;
+    upper_values[0] = 0;
+    for (int i = 1; i < dim; i++) {
+        int r = 2*dim + i;
+        base = kernel_jump_prob(2*r, pre_factors) + stay_probs[stay_points[r]];
+        upper_values[i] = kernel_jump_prob(2*r + 1, pre_factors)/base;
+        assert(!isnan(upper_values[i]));
     }
 }
 
-void TSP::compute_upper_diagonals(double rho) {
-    if (rho == prev_rho) {
-        return;
-    }
-    upper_diagonals[0] = 0;
-    double lb = max(cut_time, curr_intervals.front()->lb);
-    double ub = curr_intervals.back()->ub;
-    double t;
-    double base;
-    for (int i = 1; i < dim; i++) {
-        t = curr_intervals[i-1]->time;
-        base = psmc_prob(rho, t, lb, ub) + non_recomb_prob(rho, t);
-        upper_diagonals[i] = psmc_prob(rho, t, curr_intervals[i]->lb, curr_intervals[i]->ub)/base;
-        assert(!isnan(upper_diagonals[i]));
+double TSP::kernel_jump_prob(int k, const double *pre_factors) {
+    if (empty_jumps[k]) {
+        return 0;
     }
+    double uq = pre_factors[cdf_points[2*k]]*cdf_integrals[2*k];
+    double lq = pre_factors[cdf_points[2*k + 1]]*cdf_integrals[2*k + 1];
+    double prob = uq - lq;
+    assert(!isnan(prob));
+    prob = max(prob, epsilon);
+    assert(prob <= 1);
+    return prob;
+}
+
+void TSP::clear_kernels() {
+    kernel_rhos.clear();
+    next_kernel = 0;
 }
 
 void TSP::compute_lower_sums() {
@@ -541,10 +667,16 @@ void TSP::compute_lower_sums() {
 }
 
 void TSP::compute_upper_sums() {
-    partial_sum(forward_probs[curr_index].rbegin(), forward_probs[curr_index].rend()-1, upper_sums.rbegin()+1);
+    double *curr_probs = forward_probs[curr_index];
+    int n = forward_probs.dim(curr_index);
+    partial_sum(reverse_iterator<double *>(curr_probs + n), reverse_iterator<double *>(curr_probs + 1), upper_sums.rbegin()+1);
 }
 
 void TSP::compute_factors() {
+    interval_masses.resize(dim);
+    for (int i = 0; i < dim; i++) {
+        interval_masses[i] = exp(-curr_intervals[i]->lb) - exp(-curr_intervals[i]->ub);
+    }
     factors[0] = 0;
     for (int i = 1; i < dim; i++) {
         if (curr_intervals[i-1]->ub == curr_intervals[i-1]->lb) {
@@ -552,7 +684,7 @@ void TSP::compute_factors() {
         } else if (curr_intervals[i-1]->ub - curr_intervals[i-1]->lb < 1e-4) {
             factors[i] = 5;
         } else {
-            factors[i] = (exp(-curr_intervals[i]->lb) - exp(-curr_intervals[i]->ub))/(exp(-curr_intervals[i-1]->lb) - exp(-curr_intervals[i-1]->ub));
+            factors[i] = interval_masses[i]/interval_masses[i-1];
             factors[i] = min(factors[i], 5.0);
         }
         assert(!isnan(factors[i]) and !isinf(factors[i]));
@@ -562,10 +694,12 @@ void TSP::compute_factors() {
 void TSP::compute_emissions(set<double> &mut_set, Branch branch, Node_ptr node) {
     fill(emissions.begin(), emissions.end(), 0);
     double sl, su, s0, sm = 0;
+    Site_index &sites = site_index();
     for (double x : mut_set) {
-        sl = branch.lower_node->get_state(x);
-        su = branch.upper_node->get_state(x);
-        s0 = node->get_state(x);
+        int site = sites.get_id(x);
+        sl = branch.lower_node->get_state(site);
+        su = branch.upper_node->get_state(site);
+        s0 = node->get_state(site);
         if (sl + su + s0 > 1.5) {
             sm = 1;
         } else {
@@ -624,11 +758,12 @@ int TSP::get_prev_breakpoint(int x) {
 
 Interval *TSP::sample_curr_interval(int x) {
     vector<Interval *> intervals = get_state_space(x);
-    double ws = accumulate(forward_probs[x].begin(), forward_probs[x].end(), 0.0f);
+    double *probs = forward_probs[x];
+    double ws = accumulate(probs, probs + forward_probs.dim(x), 0.0f);
     double q = random();
     double w = ws*q;
     for (int i = 0; i < intervals.size(); i++) {
-        w -= forward_probs[x][i];
+        w -= probs[i];
         if (w <= 0) {
             sample_index = i;
             return intervals[i];
@@ -644,7 +779,7 @@ Interval *TSP::sample_prev_interval(Interval *interval, int x) {
     double ws = 0;
     double rho = rhos[x];
     compute_trace_back_probs(rho, interval, intervals);
-    vector<double> &probs = forward_probs[x];
+    double *probs = forward_probs[x];
     for (int i = 0; i < intervals.size(); i++) {
         if (intervals[i] != interval) {
             ws += trace_back_probs[i]*probs[i];
@@ -715,8 +850,8 @@ int TSP::trace_back_helper(Interval *interval, int x) {
         rho = rhos[x-1];
         compute_trace_back_probs(rho, interval, intervals);
         prev_rho = rho;
-        vector<double> &prev_probs = forward_probs[x - 1];
-        all_prob = inner_product(trace_back_probs.begin(), trace_back_probs.end(), prev_probs.begin(), 0.0);
+        double *prev_probs = forward_probs[x - 1];
+        all_prob = inner_product(trace_back_probs.begin(), trace_back_probs.end(), prev_probs, 0.0);
         assert(all_prob > 0);
         non_recomb_prob = trace_back_probs[sample_index]*forward_probs[x - 1][sample_index];
         shrinkage = non_recomb_prob/all_prob;
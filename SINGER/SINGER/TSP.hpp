@@ -11,7 +11,9 @@
 #include <stdio.h>
 #include "random_utils.hpp"
 #include "Interval.hpp"
+#include "Forward_buffer.hpp"
 #include "Emission.hpp"
+#include "Thread_team.hpp"
 
 class TSP {
     
@@ -24,12 +26,17 @@ public:
     double epsilon = 1e-7;
     set<double> check_points = {};
     shared_ptr<Emission> eh;
-    static int counter;
+    static thread_local int counter;
+    Random_context *rng = &thread_random_context();
+    Thread_team *team = nullptr; // computes the transition kernels of the bins before the next change of state space
+    int min_team_work = 32; // kernels times states below which forward computes them one bin at a time
     
     TSP();
     
     ~TSP();
     
+    void reset(); // clear all hmm state but keep allocated capacity, so the engine can be reused
+    
     void set_gap(double q);
     
     void set_emission(shared_ptr<Emission> e);
@@ -52,6 +59,8 @@ public:
     
     void forward(double rho);
     
+    void prepare_forward(const double *bin_rhos, int n); // kernels of the next n calls of forward, which share the state space
+    
     void null_emit(double theta, Node_ptr query_node);
     
     void mut_emit(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node);
@@ -81,12 +90,25 @@ public:
     Node_ptr prev_node = nullptr;
     
     int dim = 0;
+    vector<double> kernel_rhos = {}; // rho of each prepared kernel, in the order forward uses them
+    vector<double> kernels = {}; // diagonals, lower and upper diagonals of each prepared kernel, 3*dim values each
+    int next_kernel = 0;
+    vector<double> kernel_lengths = {}; // 2*x - lower_bound - cut_time for each distinct x = min(s, t) in the kernels of the state space
+    vector<int> stay_points = {}; // length of the non recombination prob of each kernel row, 3*dim rows
+    vector<int> cdf_points = {}; // length of each psmc_cdf term, upper then lower end of the full and the own jump of each row
+    vector<double> cdf_integrals = {}; // the rate free integral of each psmc_cdf term
+    vector<char> empty_jumps = {}; // jumps into a point, which have no mass
+    vector<double> kernel_exps = {}; // exp(-rho*l) and the psmc pre factor of each length, for the current rho
+    vector<double> interval_masses = {}; // exp(-lb) - exp(-ub) of each interval
     vector<double> temp = {};
     vector<double> null_emit_probs = {};
     vector<double> mut_emit_probs = {};
+    vector<double> time_points = {};
+    vector<double> lower_times = {};
+    vector<double> upper_times = {};
     int sample_index = -1;
     vector<double> trace_back_probs = {};
-    vector<vector<double>> forward_probs = {};
+    Forward_buffer forward_probs;
     vector<double> emissions = vector<double>(4);
     
     double recomb_cdf(double s, double t);
@@ -99,6 +121,8 @@ public:
     
     double psmc_cdf(double rho, double s, double t);
     
+    double psmc_integral(double s, double t);
+    
     double psmc_prob(double rho, double s, double t1, double t2);
     
     double get_exp_quantile(double p);
@@ -115,11 +139,15 @@ public:
     
     void compute_mut_emit_probs(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node);
     
-    void compute_diagonals(double rho);
+    void compute_kernel_terms(); // tabulates the parts of the kernels that do not depend on rho, once per state space
+    
+    void add_jump_terms(double s, double t1, double t2, vector<double> &points);
+    
+    void compute_kernel(double rho, double *diagonal_values, double *lower_values, double *upper_values, double *exps);
     
-    void compute_lower_diagonals(double rho);
+    double kernel_jump_prob(int k, const double *pre_factors);
     
-    void compute_upper_diagonals(double rho);
+    void clear_kernels();
     
     void compute_lower_sums();
     
@@ -7,7 +7,7 @@
 
 #include "TSP_smc.hpp"
 
-int TSP_smc::counter = 0;
+thread_local int TSP_smc::counter = 0;
 
 TSP_smc::TSP_smc() {
 }
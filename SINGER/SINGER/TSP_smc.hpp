@@ -24,7 +24,7 @@ public:
     double epsilon = 1e-7;
     set<double> check_points = {};
     shared_ptr<Emission> eh;
-    static int counter;
+    static thread_local int counter;
     
     TSP_smc();
     
@@ -7,6 +7,29 @@
 
 #include "Test.hpp"
 
+#ifdef COUNT_ALLOCATIONS
+static size_t num_allocations = 0;
+
+void *operator new(size_t size) {
+    num_allocations += 1;
+    void *p = malloc(size);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+#else
+static size_t num_allocations = 0;
+#endif
+
 void test_read_arg() {
     ARG a = ARG(2e4, 1e6);
     a.read("/Users/yun_deng/Desktop/SINGER/arg_files/continuous_ts_nodes.txt", "/Users/yun_deng/Desktop/SINGER/arg_files/continuous_ts_branches.txt");
@@ -29,7 +52,7 @@ void test_trace_pruner() {
     ARG a = ARG(2e4, 1e6);
     a.read("/Users/yun_deng/Desktop/SINGER/arg_files/continuous_ts_100_nodes.txt", "/Users/yun_deng/Desktop/SINGER/arg_files/continuous_ts_100_branches.txt");
     a.discretize(100);
-    a.smc_sample_recombinations();
+    a.smc_sample_recombinations(thread_random_context());
     for (Node_ptr n : a.sample_nodes) {
         int index = n->index;
         string mutation_file = "/Users/yun_deng/Desktop/SINGER/arg_files/continuous_sample_100_" + to_string(index) + ".txt";
@@ -248,19 +271,18 @@ void test_tsp() {
     ARG a = ARG(2e4, 1e6);
     a.read("/Users/yun_deng/Desktop/SINGER/arg_files/continuous_ts_10_nodes.txt", "/Users/yun_deng/Desktop/SINGER/arg_files/continuous_ts_10_branches.txt");
     a.discretize(10);
-    a.smc_sample_recombinations();
+    a.smc_sample_recombinations(thread_random_context());
     a.remove_leaf(9);
     a.compute_rhos_thetas(4e-4, 0.0);
     shared_ptr<Binary_emission> e = make_shared<Binary_emission>();
     Threader_smc threader = Threader_smc(0.01, 0.05);
-    Node_ptr n = a.removed_branches.begin()->second.lower_node;
     threader.end_index = (int) a.coordinates.size();
     threader.new_joining_branches = a.joining_branches;
     threader.bsp.simplify(threader.new_joining_branches);
     threader.run_TSP(a);
     threader.sample_joining_points(a);
     a.add(threader.new_joining_branches, threader.added_branches);
-    a.smc_sample_recombinations();
+    a.smc_sample_recombinations(thread_random_context());
     a.write("/Users/yun_deng/Desktop/SINGER/arg_files/new_continuous_ts_10_nodes.txt", "/Users/yun_deng/Desktop/SINGER/arg_files/new_continuous_ts_10_branches.txt");
 }
 
@@ -302,3 +324,349 @@ void test_resume_african_dataset() {
     sampler.set_output_file_prefix("/Users/yun_deng/Desktop/SINGER/arg_files/african_16");
     // sampler.resume_fast_internal_sample(500, 1, 1079, 913090935);
 }
+
+void benchmark_fast_internal_sampling() {
+    // 1 Mb window with 200 haplotypes, reports the average wall time of an MCMC iteration
+    Rate_map recomb_map = Rate_map();
+    recomb_map.load_map("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb_recomb_map.txt");
+    Rate_map mut_map = Rate_map();
+    mut_map.load_map("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb_mut_map.txt");
+    Sampler sampler = Sampler(1e4, recomb_map, mut_map);
+    sampler.set_precision(0.01, 0.05);
+    sampler.random_seed = 93;
+    sampler.start = 0;
+    sampler.end = 1e6;
+    sampler.set_output_file_prefix("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb");
+    sampler.load_vcf("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb", 0, 1e6);
+    sampler.fast_iterative_start();
+    int num_iters = 20;
+    auto start_time = chrono::steady_clock::now();
+    sampler.fast_internal_sample(num_iters, 1);
+    auto end_time = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(end_time - start_time).count();
+    cout << "Time per iteration: " << seconds/num_iters << " s" << endl;
+    cout << "Live nodes in arena: " << node_pool().num_live() << endl;
+}
+
+void benchmark_rethread_allocations() {
+    // fresh Threader_smc per cut versus one Threader_smc reused through reset();
+    // build Test.cpp with -DCOUNT_ALLOCATIONS to also count heap allocations per rethread
+    Rate_map recomb_map = Rate_map();
+    recomb_map.load_map("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb_recomb_map.txt");
+    Rate_map mut_map = Rate_map();
+    mut_map.load_map("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb_mut_map.txt");
+    Sampler sampler = Sampler(1e4, recomb_map, mut_map);
+    sampler.set_precision(0.01, 0.05);
+    sampler.random_seed = 93;
+    sampler.start = 0;
+    sampler.end = 1e6;
+    sampler.set_output_file_prefix("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb");
+    sampler.load_vcf("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb", 0, 1e6);
+    sampler.fast_iterative_start();
+    int num_cuts = 200;
+    Threader_smc threader = Threader_smc(sampler.bsp_c, sampler.tsp_q);
+    threader.pe->penalty = sampler.penalty;
+    threader.pe->ancestral_prob = sampler.polar;
+    for (int k = 0; k < 2; k++) {
+        bool reuse = k == 1;
+        size_t allocations = 0;
+        double seconds = 0;
+        for (int i = 0; i < num_cuts; i++) {
+            tuple<double, Branch, double> cut_point = sampler.arg.sample_internal_cut(sampler.rng);
+            size_t prev_allocations = num_allocations;
+            auto start_time = chrono::steady_clock::now();
+            if (reuse) {
+                threader.reset();
+                threader.fast_internal_rethread(sampler.arg, cut_point);
+            } else {
+                Threader_smc fresh_threader = Threader_smc(sampler.bsp_c, sampler.tsp_q);
+                fresh_threader.pe->penalty = sampler.penalty;
+                fresh_threader.pe->ancestral_prob = sampler.polar;
+                fresh_threader.fast_internal_rethread(sampler.arg, cut_point);
+            }
+            auto end_time = chrono::steady_clock::now();
+            seconds += chrono::duration<double>(end_time - start_time).count();
+            allocations += num_allocations - prev_allocations;
+            if ((i + 1) % 50 == 0) {
+                sampler.collect_nodes();
+            }
+        }
+        cout << (reuse ? "Reused" : "Fresh") << " Threader_smc: " << allocations/num_cuts << " allocations, " << 1000*seconds/num_cuts << " ms per rethread" << endl;
+    }
+}
+
+void benchmark_random_tree_access() {
+    // random access to the trees of a ~10k-tree ARG, replayed from position 0 versus from the tree checkpoints
+    Rate_map recomb_map = Rate_map();
+    recomb_map.load_map("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_3Mb_recomb_map.txt");
+    Rate_map mut_map = Rate_map();
+    mut_map.load_map("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_3Mb_mut_map.txt");
+    Sampler sampler = Sampler(1e4, recomb_map, mut_map);
+    sampler.set_precision(0.01, 0.05);
+    sampler.random_seed = 93;
+    sampler.start = 0;
+    sampler.end = 3e6;
+    sampler.set_output_file_prefix("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_3Mb");
+    sampler.load_vcf("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_3Mb", 0, 3e6);
+    sampler.fast_iterative_start();
+    ARG &arg = sampler.arg;
+    cout << "Number of trees: " << arg.recombinations.size() << endl;
+    int num_queries = 1000;
+    vector<double> positions = {};
+    for (int i = 0; i < num_queries; i++) {
+        positions.push_back(arg.sequence_length*uniform_random());
+    }
+    for (int spacing : {INT_MAX, 64}) {
+        arg.tree_map.clear();
+        arg.tree_spacing = spacing;
+        auto start_time = chrono::steady_clock::now();
+        for (double x : positions) {
+            Tree tree = arg.get_tree_at(x);
+        }
+        auto end_time = chrono::steady_clock::now();
+        double seconds = chrono::duration<double>(end_time - start_time).count();
+        cout << "Tree spacing " << spacing << ": " << 1000*seconds/num_queries << " ms per tree, " << arg.tree_map.size() << " checkpoints" << endl;
+    }
+    // checkpoints outside of the rethreaded region have to stay valid
+    Threader_smc threader = Threader_smc(sampler.bsp_c, sampler.tsp_q);
+    threader.pe->penalty = sampler.penalty;
+    threader.pe->ancestral_prob = sampler.polar;
+    for (int i = 0; i < 200; i++) {
+        threader.reset();
+        tuple<double, Branch, double> cut_point = arg.sample_internal_cut(thread_random_context());
+        threader.fast_internal_rethread(arg, cut_point);
+        double x = positions[i];
+        Tree tree = arg.get_tree_at(x);
+        Tree replayed_tree = Tree();
+        auto recomb_it = arg.recombinations.begin();
+        while (recomb_it->first <= x) {
+            replayed_tree.forward_update(recomb_it->second);
+            recomb_it++;
+        }
+        if (tree.parents.size() != replayed_tree.parents.size()) {
+            cerr << "tree checkpoint out of date at " << x << endl;
+            exit(1);
+        }
+        auto it = tree.parents.begin();
+        for (auto &y : replayed_tree.parents) {
+            if (y.first != it->first or y.second != it->second) {
+                cerr << "tree checkpoint out of date at " << x << endl;
+                exit(1);
+            }
+            ++it;
+        }
+    }
+    cout << "Tree checkpoints consistent after rethreading" << endl;
+}
+
+void benchmark_checkpoint_io() {
+    // write and read a ~10k-tree ARG as text files versus as one binary checkpoint
+    string prefix = "/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_3Mb";
+    ARG arg = ARG(1e4, 3e6);
+    arg.read(prefix + "_fast_start_nodes_0.txt", prefix + "_fast_start_branches_0.txt", prefix + "_fast_start_recombs_0.txt", prefix + "_fast_start_muts_0.txt");
+    arg.read_coordinates(prefix + "_fast_coordinates.txt");
+    cout << "Number of trees: " << arg.recombinations.size() << endl;
+    auto start_time = chrono::steady_clock::now();
+    arg.write(prefix + "_text_nodes.txt", prefix + "_text_branches.txt", prefix + "_text_recombs.txt", prefix + "_text_muts.txt");
+    arg.write_coordinates(prefix + "_text_coordinates.txt");
+    auto write_time = chrono::steady_clock::now();
+    ARG text_arg = ARG(1e4, 3e6);
+    text_arg.read(prefix + "_text_nodes.txt", prefix + "_text_branches.txt", prefix + "_text_recombs.txt", prefix + "_text_muts.txt");
+    text_arg.read_coordinates(prefix + "_text_coordinates.txt");
+    auto read_time = chrono::steady_clock::now();
+    cout << "Text: write " << chrono::duration<double>(write_time - start_time).count() << " s, read " << chrono::duration<double>(read_time - write_time).count() << " s" << endl;
+    start_time = chrono::steady_clock::now();
+    Checkpoint c = Checkpoint();
+    arg.write_checkpoint(c);
+    c.write(prefix + "_arg.bin");
+    write_time = chrono::steady_clock::now();
+    Checkpoint d = Checkpoint();
+    d.read(prefix + "_arg.bin");
+    ARG binary_arg = ARG(1e4, 3e6);
+    binary_arg.read_checkpoint(d);
+    read_time = chrono::steady_clock::now();
+    cout << "Binary: write " << chrono::duration<double>(write_time - start_time).count() << " s, read " << chrono::duration<double>(read_time - write_time).count() << " s" << endl;
+    // the checkpoint has to give back the same ARG
+    binary_arg.write(prefix + "_binary_nodes.txt", prefix + "_binary_branches.txt", prefix + "_binary_recombs.txt", prefix + "_binary_muts.txt");
+    for (string f : {"_nodes.txt", "_branches.txt", "_recombs.txt", "_muts.txt"}) {
+        ifstream text_file(prefix + "_text" + f);
+        ifstream binary_file(prefix + "_binary" + f);
+        string text_content((istreambuf_iterator<char>(text_file)), istreambuf_iterator<char>());
+        string binary_content((istreambuf_iterator<char>(binary_file)), istreambuf_iterator<char>());
+        if (text_content != binary_content) {
+            cerr << "checkpoint round trip differs in " << f << endl;
+            exit(1);
+        }
+    }
+    if (binary_arg.coordinates != arg.coordinates) {
+        cerr << "checkpoint round trip differs in coordinates" << endl;
+        exit(1);
+    }
+    cout << "Checkpoint round trip consistent" << endl;
+}
+
+void test_mutation_counters() {
+    // num_incompatible and num_flipped, kept up to date by every mapping change, against a full scan of mutation_branches
+    Rate_map recomb_map = Rate_map();
+    recomb_map.load_map("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb_recomb_map.txt");
+    Rate_map mut_map = Rate_map();
+    mut_map.load_map("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb_mut_map.txt");
+    Sampler sampler = Sampler(1e4, recomb_map, mut_map);
+    sampler.set_precision(0.01, 0.05);
+    sampler.random_seed = 93;
+    sampler.start = 0;
+    sampler.end = 1e6;
+    sampler.set_output_file_prefix("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb");
+    sampler.load_vcf("/Users/yun_deng/Desktop/SINGER/arg_files/benchmark_200_1Mb", 0, 1e6);
+    sampler.fast_iterative_start();
+    ARG &arg = sampler.arg;
+    Threader_smc threader = Threader_smc(sampler.bsp_c, sampler.tsp_q);
+    threader.pe->penalty = sampler.penalty;
+    threader.pe->ancestral_prob = sampler.polar;
+    for (int i = 0; i <= 200; i++) {
+        if (i > 0) {
+            threader.reset();
+            tuple<double, Branch, double> cut_point = arg.sample_internal_cut(sampler.rng);
+            threader.fast_internal_rethread(arg, cut_point);
+        }
+        int num_incompatible = 0;
+        int num_flipped = 0;
+        for (auto &x : arg.mutation_branches) {
+            set<Branch> &branches = x.second;
+            if (branches.size() > 1 and branches.rbegin()->upper_node == arg.root) {
+                num_flipped += 1;
+                if (branches.size() > 2) {
+                    num_incompatible += 1;
+                }
+            } else if (branches.size() > 1) {
+                num_incompatible += 1;
+            }
+        }
+        if (arg.count_incompatibility() != num_incompatible or arg.count_flipping() != num_flipped) {
+            cerr << "mutation counters out of date after " << i << " rethreads: " << arg.count_incompatibility() << " and " << arg.count_flipping() << " incompatibilities and flips, " << num_incompatible << " and " << num_flipped << " in a full scan" << endl;
+            exit(1);
+        }
+    }
+    cout << "Mutation counters consistent after rethreading" << endl;
+}
+
+// the exact prior as computed before fast_coalescent_calculator kept partial sums, by walking the coalescence times
+
+static double reference_integral(multiset<double> &times, double x) {
+    double integral = 0;
+    double num_lineages = times.size() - 1;
+    auto it = times.begin();
+    while (*it < x) {
+        integral += num_lineages*(min(*next(it), x) - *it);
+        num_lineages -= 1;
+        it++;
+    }
+    return integral;
+}
+
+static pair<double, double> reference_prob_moment(multiset<double> &times, double cut_time, double x, double y) {
+    double integral = reference_integral(times, x);
+    auto it = times.upper_bound(x);
+    it--;
+    double num_lineages = times.size() - distance(times.begin(), times.upper_bound(x));
+    double p = 0, q = 0;
+    while (*it < y) {
+        double prev_prob = exp(-integral);
+        double prev_time = max(*it, x);
+        double next_time = min(*next(it), y);
+        integral += num_lineages*(next_time - prev_time);
+        double next_prob = exp(-integral);
+        p += (prev_prob - next_prob)/num_lineages;
+        if (!isinf(next_time)) {
+            q += ((prev_time - cut_time)*prev_prob - (next_time - cut_time)*next_prob)/num_lineages + (prev_prob - next_prob)/num_lineages/num_lineages;
+        } else {
+            q += (prev_time - cut_time)*prev_prob/num_lineages + (prev_prob - next_prob)/num_lineages/num_lineages;
+        }
+        num_lineages -= 1;
+        it++;
+    }
+    return {p, q};
+}
+
+void test_exact_coalescent_prior() {
+    // fast_coalescent_calculator against the reference walk, then the cost of an update and a query against approx_coalescent_calculator
+    set_seed(2423);
+    double cut_time = 0.3;
+    vector<Node_ptr> nodes = {};
+    set<Branch> branches = {};
+    multiset<double> times = {cut_time, numeric_limits<double>::infinity()};
+    Node_ptr root = new_node(numeric_limits<double>::infinity());
+    root->set_index(-1);
+    for (int i = 0; i < 300; i++) {
+        nodes.push_back(new_node(5*uniform_random()));
+        nodes.back()->set_index(i);
+        branches.insert(Branch(nodes.back(), root));
+        if (nodes.back()->time > cut_time) {
+            times.insert(nodes.back()->time);
+        }
+    }
+    vector<Recombination> updates = {};
+    for (int i = 0; i < 2000; i++) {
+        int k = (int) (nodes.size()*uniform_random());
+        Recombination r = Recombination();
+        r.deleted_node = nodes[k];
+        r.inserted_node = new_node(cut_time + 5*uniform_random()); // keeps n0 of the approximation positive
+        nodes[k] = r.inserted_node;
+        updates.push_back(r);
+    }
+    vector<pair<double, double>> queries = {};
+    for (int i = 0; i < 5*updates.size(); i++) {
+        double x = cut_time + 5*uniform_random();
+        double y = uniform_random() < 0.1 ? numeric_limits<double>::infinity() : x + 2*uniform_random();
+        queries.push_back({x, y});
+    }
+    fast_coalescent_calculator fcc = fast_coalescent_calculator(cut_time);
+    fcc.start(branches);
+    double max_error = 0;
+    for (int i = 0; i < updates.size(); i++) {
+        Recombination &r = updates[i];
+        fcc.update(r);
+        if (r.deleted_node->time > cut_time) {
+            times.erase(times.find(r.deleted_node->time));
+        }
+        if (r.inserted_node->time > cut_time) {
+            times.insert(r.inserted_node->time);
+        }
+        double first_moment = reference_prob_moment(times, cut_time, cut_time, numeric_limits<double>::infinity()).first;
+        for (int j = 5*i; j < 5*i + 5; j++) {
+            double x = queries[j].first;
+            double y = queries[j].second;
+            pair<double, double> pq = reference_prob_moment(times, cut_time, x, y);
+            max_error = max(max_error, abs(fcc.prob(x, y) - pq.first));
+            if (y - x >= 0.001) {
+                pair<double, double> tw = fcc.compute_time_weights(x, y);
+                max_error = max(max_error, abs(tw.second - pq.second/first_moment));
+            }
+        }
+    }
+    cout << "Largest difference from the reference walk: " << max_error << endl;
+    if (max_error > 1e-11) {
+        cerr << "fast_coalescent_calculator differs from the reference walk" << endl;
+        exit(1);
+    }
+    for (int k = 0; k < 2; k++) {
+        shared_ptr<Coalescent_prior> cc = nullptr;
+        if (k == 0) {
+            cc = make_shared<approx_coalescent_calculator>(cut_time);
+        } else {
+            cc = make_shared<fast_coalescent_calculator>(cut_time);
+        }
+        cc->start(branches);
+        double sum = 0;
+        auto start_time = chrono::steady_clock::now();
+        for (int i = 0; i < updates.size(); i++) {
+            cc->update(updates[i]);
+            for (int j = 5*i; j < 5*i + 5; j++) {
+                sum += cc->compute_time_weights(queries[j].first, queries[j].second).second;
+            }
+        }
+        auto end_time = chrono::steady_clock::now();
+        double seconds = chrono::duration<double>(end_time - start_time).count();
+        cout << (k == 0 ? "approx" : "exact") << "_coalescent_calculator: " << 1e6*seconds/updates.size() << " us per update and 5 queries (" << sum << ")" << endl;
+    }
+}
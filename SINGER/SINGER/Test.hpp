@@ -63,4 +63,16 @@ void test_start_african_sampling();
 
 void test_resume_african_dataset();
 
+void benchmark_fast_internal_sampling();
+
+void benchmark_rethread_allocations();
+
+void benchmark_random_tree_access();
+
+void benchmark_checkpoint_io();
+
+void test_mutation_counters();
+
+void test_exact_coalescent_prior();
+
 #endif /* Test_hpp */
@@ -0,0 +1,117 @@
+//
+//  Thread_team.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Thread_team.hpp"
+
+static const int spin_limit = 20000;
+
+Thread_team::Thread_team(int n) {
+    num_threads = n;
+    for (int i = 1; i < num_threads; i++) {
+        helpers.emplace_back([this]() {
+            help();
+        });
+    }
+}
+
+Thread_team::Thread_team(int n, const function<void()> &setup) {
+    num_threads = n;
+    for (int i = 1; i < num_threads; i++) {
+        helpers.emplace_back([this, setup]() {
+            setup();
+            num_ready++;
+            help();
+        });
+    }
+    while (num_ready < helpers.size()) {
+        this_thread::yield();
+    }
+}
+
+Thread_team::~Thread_team() {
+    {
+        lock_guard<mutex> lock(wake_mutex);
+        stopping = true;
+        generation++;
+    }
+    wake.notify_all();
+    for (thread &t : helpers) {
+        t.join();
+    }
+}
+
+void Thread_team::run(int n, const function<void(int, int)> &f) {
+    if (helpers.size() == 0 or n <= block_size) {
+        f(0, n);
+        return;
+    }
+    job = f;
+    job_size = n;
+    num_blocks = (n + block_size - 1)/block_size;
+    next_block = 0;
+    num_finished = 0;
+    {
+        lock_guard<mutex> lock(wake_mutex);
+        generation++;
+    }
+    if (num_sleeping > 0) {
+        wake.notify_all();
+    }
+    work();
+    // every helper passes every generation, so none can still be reading this job when the next one is set
+    int spins = 0;
+    while (num_finished < helpers.size()) {
+        if (++spins > 64) {
+            this_thread::yield();
+        }
+    }
+}
+
+void Thread_team::run_parts(int n, const function<void(int, int)> &f) {
+    int saved_block_size = block_size;
+    block_size = 1;
+    run(num_threads, [n, &f, this](int x, int y) {
+        for (int p = x; p < y; p++) {
+            f((int) ((long) n*p/num_threads), (int) ((long) n*(p + 1)/num_threads));
+        }
+    });
+    block_size = saved_block_size;
+}
+
+void Thread_team::work() {
+    int b = next_block++;
+    while (b < num_blocks) {
+        job(b*block_size, min(job_size, (b + 1)*block_size));
+        b = next_block++;
+    }
+}
+
+void Thread_team::help() {
+    int seen = 0;
+    while (true) {
+        int spins = 0;
+        while (generation == seen and spins < spin_limit) {
+            if (++spins > 64) {
+                this_thread::yield();
+            }
+        }
+        if (generation == seen) {
+            unique_lock<mutex> lock(wake_mutex);
+            num_sleeping++;
+            wake.wait(lock, [this, seen]() {
+                return generation != seen;
+            });
+            num_sleeping--;
+        }
+        seen = generation;
+        if (stopping) {
+            return;
+        }
+        work();
+        num_finished++;
+    }
+}
@@ -0,0 +1,60 @@
+//
+//  Thread_team.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Thread_team_hpp
+#define Thread_team_hpp
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+// A fixed team of helper threads that share loops over the states of one HMM bin with the
+// calling thread. run(n, f) hands [0, n) out in blocks and returns when all of them are done.
+// Every element is computed by the same code as in a sequential loop, so results do not depend
+// on the number of threads. Bins follow each other within microseconds, so idle helpers spin
+// for a while before they sleep.
+class Thread_team {
+
+public:
+
+    int num_threads = 1;
+    int block_size = 64;
+    vector<thread> helpers = {};
+    function<void(int, int)> job;
+    int job_size = 0;
+    int num_blocks = 0;
+    atomic<int> generation = 0;
+    atomic<int> next_block = 0;
+    atomic<int> num_finished = 0; // helpers done with the current generation
+    atomic<int> num_sleeping = 0;
+    atomic<int> num_ready = 0; // helpers done with their setup
+    atomic<bool> stopping = false;
+    mutex wake_mutex;
+    condition_variable wake;
+
+    Thread_team(int n);
+    
+    Thread_team(int n, const function<void()> &setup); // each helper runs setup once, before the constructor returns
+
+    ~Thread_team();
+
+    void run(int n, const function<void(int, int)> &f);
+
+    void run_parts(int n, const function<void(int, int)> &f); // f on num_threads contiguous parts of [0, n)
+
+    void work();
+
+    void help();
+};
+
+#endif /* Thread_team_hpp */
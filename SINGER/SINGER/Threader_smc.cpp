@@ -15,6 +15,48 @@ Threader_smc::Threader_smc(double c, double q) {
 Threader_smc::~Threader_smc() {
 }
 
+void Threader_smc::reset() {
+    cut_time = 0;
+    start = 0;
+    end = 0;
+    start_index = 0;
+    end_index = 0;
+    pruner.reset();
+    bsp.reset();
+    fbsp.reset();
+    tsp.reset();
+    removed_branches.clear();
+    new_joining_branches.clear();
+    added_branches.clear();
+    pruner_time = 0;
+    forward_time = 0;
+    traceback_time = 0;
+    tsp_time = 0;
+    add_time = 0;
+    recombination_time = 0;
+    forward_memory = 0;
+}
+
+void Threader_smc::set_random_context(Random_context &r) {
+    rng = &r;
+    pruner.rng = &r;
+    bsp.rng = &r;
+    fbsp.rng = &r;
+    tsp.rng = &r;
+}
+
+void Threader_smc::set_bsp_threads(int n) {
+    if (n > 1) {
+        team = make_shared<Thread_team>(n);
+    } else {
+        team = nullptr;
+    }
+    bsp.team = team.get();
+    tsp.team = team.get();
+    // fbsp keeps its loops inline: its pruned bins almost never reach 32 states, so a bin is
+    // shorter than handing a loop to the team
+}
+
 void Threader_smc::thread(ARG &a, Node_ptr n) {
     cout << "Iteration: " << a.sample_nodes.size() << endl;
     cut_time = 0;
@@ -31,9 +73,9 @@ void Threader_smc::thread(ARG &a, Node_ptr n) {
     cout << get_time() << " : begin sampling points" << endl;
     sample_joining_points(a);
     cout << get_time() << " : begin adding" << endl;
-    a.add(new_joining_branches, added_branches);
+    add_branches(a, new_joining_branches, added_branches);
     cout << get_time() << " : begin sampling recombination" << endl;
-    a.approx_sample_recombinations();
+    sample_recombinations(a);
     a.clear_remove_info();
     cout << get_time() << " : finish" << endl;
     cout << a.recombinations.size() << endl;
@@ -57,9 +99,9 @@ void Threader_smc::fast_thread(ARG &a, Node_ptr n) {
     cout << get_time() << " : begin sampling points" << endl;
     sample_joining_points(a);
     cout << get_time() << " : begin adding" << endl;
-    a.add(new_joining_branches, added_branches);
+    add_branches(a, new_joining_branches, added_branches);
     cout << get_time() << " : begin sampling recombination" << endl;
-    a.approx_sample_recombinations();
+    sample_recombinations(a);
     a.clear_remove_info();
     cout << get_time() << " : finish" << endl;
     cout << a.recombinations.size() << endl;
@@ -80,11 +122,11 @@ void Threader_smc::internal_rethread(ARG &a, tuple<double, Branch, double> cut_p
     double ar = acceptance_ratio(a);
     double q = random();
     if (q < ar) {
-        a.add(new_joining_branches, added_branches);
+        add_branches(a, new_joining_branches, added_branches);
     } else {
-        a.add(a.joining_branches, a.removed_branches);
+        add_branches(a, a.joining_branches, a.removed_branches);
     }
-    a.approx_sample_recombinations();
+    sample_recombinations(a);
     a.clear_remove_info();
 }
 
@@ -101,7 +143,7 @@ void Threader_smc::terminal_rethread(ARG &a, tuple<double, Branch, double> cut_p
     run_TSP(a);
     sample_joining_points(a);
     a.add(new_joining_branches, added_branches);
-    a.smc_sample_recombinations();
+    a.smc_sample_recombinations(*rng);
     a.clear_remove_info();
 }
 
@@ -121,11 +163,11 @@ void Threader_smc::fast_internal_rethread(ARG &a, tuple<double, Branch, double>
     double ar = acceptance_ratio(a);
     double q = random();
     if (q < ar) {
-        a.add(new_joining_branches, added_branches);
+        add_branches(a, new_joining_branches, added_branches);
     } else {
-        a.add(a.joining_branches, a.removed_branches);
+        add_branches(a, a.joining_branches, a.removed_branches);
     }
-    a.approx_sample_recombinations();
+    sample_recombinations(a);
     a.clear_remove_info();
     // a.write("/Users/yun_deng/Desktop/SINGER/arg_files/full_ts_nodes.txt", "/Users/yun_deng/Desktop/SINGER/arg_files/full_ts_branches.txt", "/Users/yun_deng/Desktop/SINGER/arg_files/full_ts_recombs.txt");
 }
@@ -142,7 +184,42 @@ void Threader_smc::fast_terminal_rethread(ARG &a, tuple<double, Branch, double>
     run_TSP(a);
     sample_joining_points(a);
     a.add(new_joining_branches, added_branches);
-    a.smc_sample_recombinations();
+    a.smc_sample_recombinations(*rng);
+    a.clear_remove_info();
+}
+
+void Threader_smc::remove_cut(ARG &a, tuple<double, Branch, double> cut_point) {
+    cut_time = get<2>(cut_point);
+    a.remove(cut_point);
+    get_boundary(a);
+    set_check_points(a);
+}
+
+void Threader_smc::sample_threading(ARG &a) {
+    run_BSP(a);
+    sample_joining_branches(a);
+    run_TSP(a);
+}
+
+void Threader_smc::fast_sample_threading(ARG &a) {
+    run_pruner(a);
+    run_fast_BSP(a);
+    sample_fast_joining_branches(a);
+    run_TSP(a);
+}
+
+void Threader_smc::commit_cut(ARG &a) {
+    sample_joining_points(a);
+    double ar = acceptance_ratio(a);
+    double q = random();
+    if (q < ar) {
+        add_branches(a, new_joining_branches, added_branches);
+    } else {
+        add_branches(a, a.joining_branches, a.removed_branches);
+    }
+    auto start_time = chrono::steady_clock::now();
+    a.approx_sample_recombinations(start, end);
+    recombination_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
     a.clear_remove_info();
 }
 
@@ -151,6 +228,8 @@ void Threader_smc::get_boundary(ARG &a) {
     end = a.end;
     start_index = a.get_index(start);
     end_index = a.get_index(end);
+    start_tree = a.start_tree;
+    removed_branches = a.removed_branches;
 }
 
 void Threader_smc::set_check_points(ARG &a) {
@@ -162,17 +241,29 @@ void Threader_smc::set_check_points(ARG &a) {
 }
 
 void Threader_smc::run_pruner(ARG &a) {
-    pruner.prune_arg(a);
+    auto start_time = chrono::steady_clock::now();
+    pruner.prune_arg(a, start_tree, removed_branches, cut_time);
+    pruner_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+int Threader_smc::checkpoint_spacing() {
+    if (checkpoint < 0) {
+        return max(2, (int) sqrt(end_index - start_index));
+    }
+    return checkpoint;
 }
 
 void Threader_smc::run_BSP(ARG &a) {
+    auto start_time = chrono::steady_clock::now();
+    bsp.set_checkpoint(checkpoint_spacing());
     bsp.reserve_memory(end_index - start_index);
     bsp.set_cutoff(cutoff);
+    bsp.exact_coalescent = exact_coalescent;
     bsp.set_emission(pe);
-    bsp.start(a.start_tree, cut_time);
+    bsp.start(start_tree, cut_time);
     auto recomb_it = a.recombinations.upper_bound(start);
     auto mut_it = a.mutation_sites.lower_bound(start);
-    auto query_it = a.removed_branches.begin();
+    auto query_it = removed_branches.begin();
     vector<double> mutations;
     set<double> mut_set = {};
     set<Branch> deletions = {};
@@ -202,21 +293,25 @@ void Threader_smc::run_BSP(ARG &a) {
         }
     }
     if (bsp.check_points.count(end) > 0) {
-        Recombination &r = a.recombinations[end];
+        Recombination &r = a.recombinations.at(end);
         bsp.sanity_check(r);
     }
+    forward_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
 }
 
 
 void Threader_smc::run_fast_BSP(ARG &a) {
+    auto start_time = chrono::steady_clock::now();
+    fbsp.set_checkpoint(checkpoint_spacing());
     fbsp.reserve_memory(end_index - start_index);
     fbsp.set_cutoff(cutoff);
+    fbsp.exact_coalescent = exact_coalescent;
     fbsp.set_emission(pe);
     set<Interval_info> start_intervals = pruner.insertions.begin()->second;
-    fbsp.start(a.start_tree, start_intervals, cut_time);
+    fbsp.start(start_tree, start_intervals, cut_time);
     auto recomb_it = a.recombinations.upper_bound(start);
     auto mut_it = a.mutation_sites.lower_bound(start);
-    auto query_it = a.removed_branches.begin();
+    auto query_it = removed_branches.begin();
     auto delete_it = pruner.deletions.upper_bound(start);
     auto insert_it = pruner.insertions.upper_bound(start);
     vector<double> mutations;
@@ -251,12 +346,14 @@ void Threader_smc::run_fast_BSP(ARG &a) {
         }
     }
     if (fbsp.check_points.count(end) > 0) {
-        Recombination &r = a.recombinations[end];
+        Recombination &r = a.recombinations.at(end);
         fbsp.sanity_check(r);
     }
+    forward_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
 }
 
 void Threader_smc::run_TSP(ARG &a) {
+    auto start_time = chrono::steady_clock::now();
     tsp.reserve_memory(end_index - start_index);
     tsp.set_gap(gap);
     tsp.set_emission(be);
@@ -265,11 +362,12 @@ void Threader_smc::run_TSP(ARG &a) {
     auto recomb_it = a.recombinations.upper_bound(start);
     auto join_it = new_joining_branches.upper_bound(start);
     auto mut_it = a.mutation_sites.lower_bound(start);
-    auto query_it = a.removed_branches.lower_bound(start);
+    auto query_it = removed_branches.lower_bound(start);
     Branch prev_branch = start_branch;
     Branch next_branch = start_branch;
     Node_ptr query_node = nullptr;
     set<double> mut_set = {};
+    int prepared_index = start_index; // bins before it are covered by prepared kernels
     for (int i = start_index; i < end_index; i++) {
         if (a.coordinates[i] == query_it->first) {
             query_node = query_it->second.lower_node;
@@ -288,6 +386,15 @@ void Threader_smc::run_TSP(ARG &a) {
             tsp.recombine(prev_branch, next_branch);
             prev_branch = next_branch;
         } else if (a.coordinates[i] != start) {
+            if (tsp.team != nullptr and i >= prepared_index) {
+                // the state space stays the same until the next recombination or joining branch
+                double x = recomb_it->first;
+                if (join_it != new_joining_branches.end()) {
+                    x = min(x, join_it->first);
+                }
+                prepared_index = (int) (lower_bound(a.coordinates.begin() + i, a.coordinates.begin() + end_index, x) - a.coordinates.begin());
+                tsp.prepare_forward(&a.rhos[i], prepared_index - i);
+            }
             double rho = a.rhos[i];
             tsp.forward(rho);
         }
@@ -303,20 +410,28 @@ void Threader_smc::run_TSP(ARG &a) {
         }
     }
     if (tsp.check_points.count(end) > 0) {
-        Recombination &r = a.recombinations[end];
+        Recombination &r = a.recombinations.at(end);
         tsp.sanity_check(r);
     }
+    tsp_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
 }
 
 void Threader_smc::sample_joining_branches(ARG &a) {
+    auto start_time = chrono::steady_clock::now();
     new_joining_branches = bsp.sample_joining_branches(start_index, a.coordinates);
+    traceback_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    forward_memory = max(forward_memory, bsp.forward_probs.memory());
 }
 
 void Threader_smc::sample_fast_joining_branches(ARG &a) {
+    auto start_time = chrono::steady_clock::now();
     new_joining_branches = fbsp.sample_joining_branches(start_index, a.coordinates);
+    traceback_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    forward_memory = max(forward_memory, fbsp.forward_probs.memory());
 }
 
 void Threader_smc::sample_joining_points(ARG &a) {
+    auto start_time = chrono::steady_clock::now();
     map<double, Node_ptr> added_nodes = tsp.sample_joining_nodes(start_index, a.coordinates);
     auto add_it = added_nodes.begin();
     auto end_it = added_nodes.end();
@@ -330,10 +445,23 @@ void Threader_smc::sample_joining_points(ARG &a) {
         added_branches[x] = Branch(query_node, added_node);
         add_it++;
     }
+    tsp_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+void Threader_smc::add_branches(ARG &a, map<double, Branch> &joining_branches, map<double, Branch> &added_branches) {
+    auto start_time = chrono::steady_clock::now();
+    a.add(joining_branches, added_branches);
+    add_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+void Threader_smc::sample_recombinations(ARG &a) {
+    auto start_time = chrono::steady_clock::now();
+    a.approx_sample_recombinations();
+    recombination_time += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
 }
 
 double Threader_smc::acceptance_ratio(ARG &a) {
-    double cut_height = a.cut_tree.parents.rbegin()->first->time;
+    double cut_height = a.cut_tree.parents.last().first->time;
     double old_height = cut_height;
     double new_height = cut_height;
     auto old_join_it = a.joining_branches.upper_bound(a.cut_pos);
@@ -354,7 +482,7 @@ double Threader_smc::acceptance_ratio(ARG &a) {
 }
 
 double Threader_smc::random() {
-    return uniform_random();
+    return rng->uniform();
 }
 
 vector<double> Threader_smc::expected_diff(double m) {
@@ -387,11 +515,11 @@ vector<double> Threader_smc::observed_diff(ARG &a) {
         Branch &joining_branch = join_it->second;
         Branch &added_branch = add_it->second;
         while (*mut_it < next(add_it)->first) {
-            double m = *mut_it;
-            sl = joining_branch.lower_node->get_state(m);
-            su = joining_branch.upper_node->get_state(m);
-            sm = added_branch.upper_node->get_state(m);
-            s0 = added_branch.lower_node->get_state(m);
+            int site = site_index().get_id(*mut_it);
+            sl = joining_branch.lower_node->get_state(site);
+            su = joining_branch.upper_node->get_state(site);
+            sm = added_branch.upper_node->get_state(site);
+            s0 = added_branch.lower_node->get_state(site);
             diff[0] += abs(sm - sl);
             if (join_it->second.upper_node->index != -1) {
                 diff[1] += abs(su - sm);
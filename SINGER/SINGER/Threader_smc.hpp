@@ -35,6 +35,12 @@ public:
     
     ~Threader_smc();
     
+    void reset(); // prepare for the next rethread, engines keep their allocated capacity
+    
+    void set_random_context(Random_context &r); // draw from r instead of the thread's default context
+    
+    void set_bsp_threads(int n); // threads sharing the per-bin loops of the approx_BSP forward pass and the TSP transition kernels
+    
     void thread(ARG &a, Node_ptr n);
     
     void internal_rethread(ARG &a, tuple<double, Branch, double> cut_point);
@@ -47,6 +53,18 @@ public:
     
     void fast_terminal_rethread(ARG &a, tuple<double, Branch, double> cut_point);
     
+    // an internal rethread in three steps, so that the threadings of several removed cuts can be
+    // sampled at the same time: only sample_threading and fast_sample_threading may run concurrently,
+    // and they read nothing of the ARG outside [start, end]
+    
+    void remove_cut(ARG &a, tuple<double, Branch, double> cut_point);
+    
+    void sample_threading(ARG &a);
+    
+    void fast_sample_threading(ARG &a);
+    
+    void commit_cut(ARG &a); // a must hold the remove info of this cut again
+    
 // private:
     
     double cut_time = 0;
@@ -54,12 +72,25 @@ public:
     double end = 0;
     int start_index = 0;
     int end_index = 0;
+    Tree start_tree;
+    map<double, Branch> removed_branches = {}; // copied from the ARG, which may move on to another cut before the threading is sampled
     Trace_pruner pruner = Trace_pruner();
     approx_BSP bsp = approx_BSP();
     fast_BSP fbsp = fast_BSP();
     TSP tsp = TSP();
     double gap;
     double cutoff;
+    Random_context *rng = &thread_random_context();
+    shared_ptr<Thread_team> team = nullptr;
+    int checkpoint = 0; // BSP checkpoint spacing, 0 stores every bin, -1 uses sqrt(number of bins)
+    bool exact_coalescent = false; // BSP prior from the exact coalescence times, see fast_coalescent_calculator
+    double pruner_time = 0; // Trace_pruner, which restricts the fast BSP to the candidate branches
+    double forward_time = 0;
+    double traceback_time = 0;
+    double tsp_time = 0; // TSP forward pass and joining points
+    double add_time = 0; // adding the branches and mapping the mutations
+    double recombination_time = 0;
+    size_t forward_memory = 0;
     shared_ptr<Binary_emission> be = make_shared<Binary_emission>();
     shared_ptr<Polar_emission> pe = make_shared<Polar_emission>();
     map<double, Branch> new_joining_branches = {};
@@ -71,6 +102,8 @@ public:
     
     void run_pruner(ARG &a);
     
+    int checkpoint_spacing();
+    
     void run_BSP(ARG &a);
     
     void run_fast_BSP(ARG &a);
@@ -83,6 +116,10 @@ public:
     
     void sample_joining_points(ARG &a);
     
+    void add_branches(ARG &a, map<double, Branch> &joining_branches, map<double, Branch> &added_branches);
+    
+    void sample_recombinations(ARG &a);
+    
     double acceptance_ratio(ARG &a);
     
     double random();
@@ -12,13 +12,17 @@
 Trace_pruner::Trace_pruner() {}
 
 void Trace_pruner::prune_arg(ARG &a) {
-    cut_time = a.cut_time;
-    queries = a.removed_branches;
-    start = a.removed_branches.begin()->first;
-    end = a.removed_branches.rbegin()->first;
+    prune_arg(a, a.start_tree, a.removed_branches, a.cut_time);
+}
+
+void Trace_pruner::prune_arg(ARG &a, Tree &start_tree, map<double, Branch> &removed_branches, double t) {
+    cut_time = t;
+    queries = removed_branches;
+    start = removed_branches.begin()->first;
+    end = removed_branches.rbegin()->first;
     segments.insert({start, end});
     used_seeds = {start, end};
-    seed_trees[start] = a.start_tree;
+    seed_trees[start] = start_tree;
     seed_trees[start].internal_cut(cut_time);
     deletions[end] = {};
     insertions[end] = {};
@@ -31,42 +35,72 @@ void Trace_pruner::prune_arg(ARG &a) {
     assert(segments.size() == 0);
 }
 
+void Trace_pruner::reset() {
+    start = 0;
+    end = 0;
+    cut_time = 0;
+    length = 0;
+    queries.clear();
+    private_mutations.clear();
+    seed_trees.clear();
+    match_map.clear();
+    potential_seeds.clear();
+    used_seeds.clear();
+    seed_match.clear();
+    seed_states.clear();
+    seed_scores.clear();
+    curr_states.clear();
+    curr_scores.clear();
+    check_points.clear();
+    reductions.clear();
+    deletions.clear();
+    insertions.clear();
+    transition_states.clear();
+    transition_scores.clear();
+    transition_kept.clear();
+    segments.clear();
+}
+
 void Trace_pruner::set_check_points(set<double> &p) {
     check_points = p;
 }
 
 void Trace_pruner::start_search(ARG &a, double m) {
+    seed_states.clear();
     seed_scores.clear();
     Node_ptr n = get_node_at(m);
+    int site = site_index().get_id(m);
     double mismatch = 0;
     double lb, ub;
     Interval_info interval;
     double x0 = find_closest_reference(m);
-    seed_trees[m] = a.internal_modify_tree_to(m, seed_trees[x0], x0);
+    seed_trees[m] = a.internal_modify_tree_to(m, seed_trees[x0], x0, cut_time);
     length += abs(m - x0);
     double min_mismatch = INT_MAX;
     for (auto &x : seed_trees[m].parents) {
         if (x.second->time > cut_time) {
-            mismatch = count_mismatch(Branch(x.first, x.second), n, m);
+            mismatch = count_mismatch(Branch(x.first, x.second), n, site);
             min_mismatch = min(mismatch, min_mismatch);
         }
     }
     for (auto &x : seed_trees[m].parents) {
         if (x.second->time > cut_time) {
             Branch b = Branch(x.first, x.second);
-            mismatch = count_mismatch(b, n, m);
+            mismatch = count_mismatch(b, n, site);
             if (mismatch == min_mismatch) {
                 lb = max(cut_time, b.lower_node->time);
                 ub = b.upper_node->time;
                 interval = Interval_info(b, lb, ub);
                 interval.seed_pos = m;
-                seed_scores[interval] = 1;
+                seed_states.push_back(interval);
+                seed_scores.push_back(1);
             }
         }
     }
+    sort_states(seed_states, seed_scores);
     restrict_search();
     potential_seeds.erase(m);
-    assert(seed_scores.size() > 0 and seed_scores.size() <= band_width);
+    assert(seed_states.size() > 0 and seed_states.size() <= band_width);
 }
 
 void Trace_pruner::write_reduction_distance(ARG &a, string filename) {
@@ -174,9 +208,13 @@ Node_ptr Trace_pruner::get_node_at(double x) {
 }
 
 double Trace_pruner::count_mismatch(Branch branch, Node_ptr n, double m) {
-    double s0 = n->get_state(m);
-    double sl = branch.lower_node->get_state(m);
-    double su = branch.upper_node->get_state(m);
+    return count_mismatch(branch, n, site_index().get_id(m));
+}
+
+double Trace_pruner::count_mismatch(const Branch &branch, Node_ptr n, int site) {
+    double s0 = n->get_state(site);
+    double sl = branch.lower_node->get_state(site);
+    double su = branch.upper_node->get_state(site);
     if (branch.upper_node->index != -1) {
         if (abs(sl - s0) > 0.5 and abs(su - s0) > 0.5) {
             return 1;
@@ -289,8 +327,8 @@ void Trace_pruner::extend_forward(ARG &a, double x) {
     Node_ptr n;
     double bin_start = 0;
     double bin_end = 0;
-    set<double> mutations = {};
-    while (a.coordinates[index] < ub and curr_scores.size() > 0) {
+    vector<double> mutations = {};
+    while (a.coordinates[index] < ub and curr_states.size() > 0) {
         for (double y : mutations) {
             potential_seeds.erase(y);
         }
@@ -306,7 +344,7 @@ void Trace_pruner::extend_forward(ARG &a, double x) {
             m = match_it->first;
             n = get_node_at(m);
             mutation_update(n, m);
-            mutations.insert(m);
+            mutations.push_back(m);
             ++match_it;
         }
         if (a.recombinations.count(bin_end) == 0) {
@@ -314,7 +352,7 @@ void Trace_pruner::extend_forward(ARG &a, double x) {
         }
         ++index;
     }
-    if (curr_scores.size() > 0) {
+    if (curr_states.size() > 0) {
         if (ub == a.sequence_length) {
             bin_end = ub;
         } else {
@@ -339,8 +377,8 @@ void Trace_pruner::extend_backward(ARG &a, double x) {
     Node_ptr n;
     double bin_start = 0;
     double bin_end = 0;
-    set<double> mutations = {};
-    while (a.coordinates[index + 1] > lb and curr_scores.size() > 0) {
+    vector<double> mutations = {};
+    while (a.coordinates[index + 1] > lb and curr_states.size() > 0) {
         for (double y : mutations) {
             potential_seeds.erase(y);
         }
@@ -356,7 +394,7 @@ void Trace_pruner::extend_backward(ARG &a, double x) {
             m = match_it->first;
             n = get_node_at(m);
             mutation_update(n, m);
-            mutations.insert(m);
+            mutations.push_back(m);
             if (match_it == match_map.begin()) {
                 break;
             }
@@ -367,7 +405,7 @@ void Trace_pruner::extend_backward(ARG &a, double x) {
         }
         --index;
     }
-    if (curr_scores.size() > 0) {
+    if (curr_states.size() > 0) {
         index = a.get_index(lb);
         bin_start = a.coordinates[index];
         insert_all(bin_start);
@@ -378,8 +416,10 @@ void Trace_pruner::extend_backward(ARG &a, double x) {
 
 void Trace_pruner::extend(ARG &a, double x) {
     start_search(a, x);
+    curr_states = seed_states;
     curr_scores = seed_scores;
     extend_forward(a, x);
+    curr_states = seed_states;
     curr_scores = seed_scores;
     extend_backward(a, x);
     used_seeds.insert(x); // when extending later seeds, don't go beyond previous seeds (to save computation)
@@ -389,44 +429,72 @@ void Trace_pruner::mutation_update(Node_ptr n, double m) {
     if (n == nullptr) {
         return;
     }
-    double mismatch = 0;
-    double penalty = 0;
-    for (auto &[i, s] : curr_scores) {
-        mismatch = count_mismatch(i.branch, n, m);
-        penalty = pow(mut_prob, mismatch);
-        s *= penalty;
+    int site = site_index().get_id(m);
+    for (int k = 0; k < curr_states.size(); k++) {
+        if (count_mismatch(curr_states[k].branch, n, site) > 0) {
+            curr_scores[k] *= mut_prob;
+        }
     }
 }
 
 void Trace_pruner::recombination_forward(Recombination &r) {
+    transition_states.clear();
     transition_scores.clear();
-    for (auto &[i, s] : curr_scores) {
-        forward_transition(r, i);
-        assert(!r.affect(i.branch) or deletions[r.pos].count(i) > 0);
+    transition_kept.clear();
+    for (int k = 0; k < curr_states.size(); k++) {
+        forward_transition(r, k);
+        assert(!r.affect(curr_states[k].branch) or deletions[r.pos].count(curr_states[k]) > 0);
     }
-    curr_scores = transition_scores;
+    collect_transitions();
 }
 
 void Trace_pruner::recombination_backward(Recombination &r) {
+    transition_states.clear();
     transition_scores.clear();
-    for (auto &[i, s] : curr_scores) {
-        backward_transition(r, i);
-        assert(!r.affect(i.branch) or insertions[r.pos].count(i) > 0);
+    transition_kept.clear();
+    for (int k = 0; k < curr_states.size(); k++) {
+        backward_transition(r, k);
+        assert(!r.affect(curr_states[k].branch) or insertions[r.pos].count(curr_states[k]) > 0);
     }
-    curr_scores = transition_scores;
+    collect_transitions();
+}
+
+void Trace_pruner::add_transition(const Interval_info &interval, double p, bool kept) {
+    transition_states.push_back(interval);
+    transition_scores.push_back(p);
+    transition_kept.push_back(kept);
 }
 
-void Trace_pruner::forward_transition(Recombination &r, const Interval_info &interval) {
+void Trace_pruner::collect_transitions() {
+    sort_transfers(transition_states, transition_order);
+    curr_states.clear();
+    curr_scores.clear();
+    for (int i : transition_order) {
+        const Interval_info &interval = transition_states[i];
+        if (curr_states.size() == 0 or curr_states.back() != interval) {
+            curr_states.push_back(interval);
+            curr_scores.push_back(0);
+        }
+        if (transition_kept[i]) {
+            curr_scores.back() = transition_scores[i];
+        } else {
+            curr_scores.back() += transition_scores[i];
+        }
+    }
+}
+
+void Trace_pruner::forward_transition(Recombination &r, int k) {
     double lb, ub;
     double w0, w1, w2;
     Interval_info new_interval;
     Branch b;
-    double p = curr_scores[interval];
+    const Interval_info &interval = curr_states[k];
+    double p = curr_scores[k];
     p = max(p, cutoff*0.1f);
     double l = interval.lb;
     double u = interval.ub;
     if (!r.affect(interval.branch)) {
-        transition_scores[interval] = curr_scores[interval];
+        add_transition(interval, curr_scores[k], true);
     } else if (interval.branch == r.source_branch) {
         if (l <= r.start_time) {
             lb = min(l, r.start_time);
@@ -471,18 +539,19 @@ void Trace_pruner::forward_transition(Recombination &r, const Interval_info &int
     assert(!r.affect(interval.branch) or deletions[r.pos].count(interval) > 0);
 }
 
-void Trace_pruner::backward_transition(Recombination &r, const Interval_info &interval) {
+void Trace_pruner::backward_transition(Recombination &r, int k) {
     double lb, ub;
     double w0, w1, w2;
     Interval_info new_interval;
     Branch b;
-    double p = curr_scores[interval];
+    const Interval_info &interval = curr_states[k];
+    double p = curr_scores[k];
     p = max(p, cutoff*0.1f);
     double l = interval.lb;
     double u = interval.ub;
     double x = r.pos;
     if (!r.create(interval.branch)) {
-        transition_scores[interval] = curr_scores[interval];
+        add_transition(interval, curr_scores[k], true);
     } else if (interval.branch == r.recombined_branch) {
         if (l <= r.start_time) {
             lb = min(l, r.start_time);
@@ -537,7 +606,7 @@ void Trace_pruner::forward_transition_helper(Interval_info prev_interval, Interv
     }
     assert(prev_interval.lb >= cut_time and next_interval.lb >= cut_time);
     next_interval.seed_pos = prev_interval.seed_pos;
-    transition_scores[next_interval] += p;
+    add_transition(next_interval, p, false);
     deletions[x].insert(prev_interval);
     insertions[x].insert(next_interval);
 }
@@ -548,46 +617,52 @@ void Trace_pruner::backward_transition_helper(Interval_info next_interval, Inter
     }
     assert(prev_interval.lb >= cut_time and next_interval.lb >= cut_time);
     prev_interval.seed_pos = next_interval.seed_pos;
-    transition_scores[prev_interval] += p;
+    add_transition(prev_interval, p, false);
     deletions[x].insert(prev_interval);
     insertions[x].insert(next_interval);
 }
 
 void Trace_pruner::forward_prune_states(double x) {
-    auto it = curr_scores.begin();
-    while (it != curr_scores.end()) {
-        if (it->second < cutoff) {
-            deletions[x].insert(it->first);
-            it = curr_scores.erase(it);
+    int j = 0;
+    for (int k = 0; k < curr_states.size(); k++) {
+        if (curr_scores[k] < cutoff) {
+            deletions[x].insert(curr_states[k]);
             insertions[x];
         } else {
-            ++it;
+            curr_states[j] = curr_states[k];
+            curr_scores[j] = curr_scores[k];
+            j += 1;
         }
     }
+    curr_states.resize(j);
+    curr_scores.resize(j);
 }
 
 void Trace_pruner::backward_prune_states(double x) {
-    auto it = curr_scores.begin();
-    while (it != curr_scores.end()) {
-        if (it->second < cutoff) {
-            insertions[x].insert(it->first);
-            it = curr_scores.erase(it);
+    int j = 0;
+    for (int k = 0; k < curr_states.size(); k++) {
+        if (curr_scores[k] < cutoff) {
+            insertions[x].insert(curr_states[k]);
             deletions[x];
         } else {
-            ++it;
+            curr_states[j] = curr_states[k];
+            curr_scores[j] = curr_scores[k];
+            j += 1;
         }
     }
+    curr_states.resize(j);
+    curr_scores.resize(j);
 }
 
 void Trace_pruner::delete_all(double x) {
-    for (auto &[i, s] : curr_scores) {
+    for (const Interval_info &i : curr_states) {
         deletions[x].insert(i);
         insertions[x];
     }
 }
 
 void Trace_pruner::insert_all(double x) {
-    for (auto &[i, s] : curr_scores) {
+    for (const Interval_info &i : curr_states) {
         insertions[x].insert(i);
         deletions[x];
     }
@@ -751,17 +826,27 @@ double Trace_pruner::get_match_time(set<Branch> &branches, double m, Node_ptr n)
  */
 
 void Trace_pruner::restrict_search() {
-    if (seed_scores.size() <= band_width) {
+    if (seed_states.size() <= band_width) {
         return; // If size is less than or equal to band_with, do nothing
     }
-    vector<Interval_info> seeds;
-    transform(seed_scores.begin(), seed_scores.end(), back_inserter(seeds),
-                       [](const auto& pair) { return pair.first; });
-    // Shuffle using existing random_engine
-    shuffle(seeds.begin(), seeds.end(), random_engine);
-
-    for (int i = band_width; i < seeds.size(); ++i) {
-        seed_scores.erase(seeds[i]);
-    }
-    assert(seed_scores.size() <= band_width);
+    vector<Interval_info> seeds = seed_states;
+    shuffle(seeds.begin(), seeds.end(), *rng);
+    seeds.resize(band_width);
+    seed_states = seeds;
+    seed_scores.assign(band_width, 1);
+    sort_states(seed_states, seed_scores);
+    assert(seed_states.size() <= band_width);
+}
+
+void Trace_pruner::sort_states(vector<Interval_info> &states, vector<double> &scores) {
+    vector<int> order;
+    sort_transfers(states, order);
+    vector<Interval_info> sorted_states(states.size());
+    vector<double> sorted_scores(scores.size());
+    for (int i = 0; i < order.size(); i++) {
+        sorted_states[i] = states[order[i]];
+        sorted_scores[i] = scores[order[i]];
+    }
+    states = sorted_states;
+    scores = sorted_scores;
 }
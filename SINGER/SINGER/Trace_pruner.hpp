@@ -25,6 +25,7 @@ public:
     double end = 0;
     double cut_time = 0;
     int band_width = 10;
+    Random_context *rng = &thread_random_context();
     
     double length = 0;
     
@@ -38,8 +39,10 @@ public:
     set<double> used_seeds = {};
     
     map<Branch, double> seed_match = {};
-    map<Interval_info, double> seed_scores = {};
-    map<Interval_info, double> curr_scores = {};
+    vector<Interval_info> seed_states = {}; // sorted as in a map of Interval_info, with the score of each state alongside
+    vector<double> seed_scores = {};
+    vector<Interval_info> curr_states = {};
+    vector<double> curr_scores = {};
     
     set<double> check_points;
     
@@ -47,14 +50,21 @@ public:
     map<double, set<Interval_info>> deletions = {};
     map<double, set<Interval_info>> insertions = {};
     
-    map<Interval_info, double> transition_scores = {};
+    vector<Interval_info> transition_states = {}; // in the order the transitions produce them
+    vector<double> transition_scores = {};
+    vector<char> transition_kept = {}; // an unaffected state, whose score replaces instead of adding up
+    vector<int> transition_order = {};
     
     set<pair<double, double>> segments = {};
     
     Trace_pruner();
     
+    void reset();
+    
     void prune_arg(ARG &a);
     
+    void prune_arg(ARG &a, Tree &start_tree, map<double, Branch> &removed_branches, double t); // a cut that is not the one held by a
+    
     void set_check_points(set<double> &p);
     
     void start_search(ARG &a, double m);
@@ -91,6 +101,8 @@ public:
     
     double count_mismatch(Branch branch, Node_ptr n, double m);
     
+    double count_mismatch(const Branch &branch, Node_ptr n, int site);
+    
     void forward_prune_states(double x);
     
     void backward_prune_states(double x);
@@ -99,9 +111,13 @@ public:
     
     void insert_all(double x);
     
-    void forward_transition(Recombination &r, const Interval_info &interval);
+    void forward_transition(Recombination &r, int k); // the k-th current state
     
-    void backward_transition(Recombination &r, const Interval_info &interval);
+    void backward_transition(Recombination &r, int k);
+    
+    void add_transition(const Interval_info &interval, double p, bool kept);
+    
+    void collect_transitions(); // merges the transitions into the current states, as a map would
     
     void forward_transition_helper(Interval_info prev_interval, Interval_info next_interval, double x, double p);
     
@@ -120,6 +136,8 @@ public:
     void remove_segment(double x, double y);
     
     void restrict_search();
+    
+    void sort_states(vector<Interval_info> &states, vector<double> &scores);
 };
 
 #endif /* Trace_pruner_hpp */
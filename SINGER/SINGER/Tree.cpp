@@ -23,26 +23,46 @@ double Tree::length() {
 void Tree::delete_branch(const Branch &b) {
     assert(b.upper_node != nullptr and b.lower_node != nullptr);
     parents.erase(b.lower_node);
-    unordered_set<Node_ptr> &children_nodes = children[b.upper_node];
-    if (children_nodes.size() == 1) {
-        children.erase(b.upper_node);
-    } else {
-        children_nodes.erase(b.lower_node);  
-    }
+    delete_child(b.upper_node, b.lower_node);
 }
 
 void Tree::insert_branch(const Branch &b) {
     assert(b.upper_node != nullptr and b.lower_node != nullptr);
-    parents[b.lower_node] = b.upper_node;
-    children[b.upper_node].insert(b.lower_node);
+    parents.insert(b.lower_node, b.upper_node);
+    insert_child(b.upper_node, b.lower_node);
+}
+
+void Tree::insert_child(Node_ptr p, Node_ptr c) {
+    pair<Node_ptr, Node_ptr> *children_nodes = children.find_mutable(p);
+    if (children_nodes == nullptr) {
+        children.insert(p, {c, nullptr});
+    } else if (children_nodes->first != c) {
+        assert(children_nodes->second == nullptr or children_nodes->second == c);
+        children_nodes->second = c;
+    }
+}
+
+void Tree::delete_child(Node_ptr p, Node_ptr c) {
+    pair<Node_ptr, Node_ptr> *children_nodes = children.find_mutable(p);
+    if (children_nodes == nullptr) {
+        return;
+    }
+    if (children_nodes->second == nullptr) {
+        children.erase(p);
+    } else if (children_nodes->first == c) {
+        children_nodes->first = children_nodes->second;
+        children_nodes->second = nullptr;
+    } else if (children_nodes->second == c) {
+        children_nodes->second = nullptr;
+    }
 }
 
 void Tree::internal_insert_branch(const Branch &b, double cut_time) {
     if (b.upper_node->time <= cut_time) {
         return;
     }
-    parents[b.lower_node] = b.upper_node;
-    children[b.upper_node].insert(b.lower_node);
+    parents.insert(b.lower_node, b.upper_node);
+    insert_child(b.upper_node, b.lower_node);
 }
 
 void Tree::internal_delete_branch(const Branch &b, double cut_time) {
@@ -50,12 +70,7 @@ void Tree::internal_delete_branch(const Branch &b, double cut_time) {
         return;
     }
     parents.erase(b.lower_node);
-    unordered_set<Node_ptr> &children_nodes = children[b.upper_node];
-    if (children_nodes.size() == 1) {
-        children.erase(b.upper_node);
-    } else {
-        children_nodes.erase(b.lower_node);
-    }
+    delete_child(b.upper_node, b.lower_node);
 }
 
 void Tree::forward_update(Recombination &r) {
@@ -132,15 +147,11 @@ Node_ptr Tree::find_sibling(Node_ptr n) {
 
 Node_ptr Tree::find_sibling(Node_ptr n) {
     Node_ptr p = parents[n];
-    unordered_set<Node_ptr> &candidates = children[p];
-    Node_ptr c;
-    auto c_it = candidates.begin();
-    if (*c_it != n) {
-        c = *c_it;
-    } else {
-        c = *(next(c_it));
-    }
-    return c;
+    pair<Node_ptr, Node_ptr> candidates = children[p];
+    if (candidates.first != n) {
+        return candidates.first;
+    }
+    return candidates.second;
 }
 
 Branch Tree::find_joining_branch(Branch removed_branch) {
@@ -153,28 +164,30 @@ Branch Tree::find_joining_branch(Branch removed_branch) {
     return Branch(c, p);
 }
 
-pair<Branch, double> Tree::sample_cut_point() {
-    double root_time = parents.rbegin()->first->time;
-    double cut_time = random()*root_time;
+pair<Branch, double> Tree::sample_cut_point(Random_context &rng) {
+    double root_time = parents.last().first->time;
+    double cut_time = rng.uniform()*root_time;
     vector<Branch> candidates = {};
     for (auto &x : parents) {
         if (x.second->time > cut_time and x.first->time <= cut_time) {
             candidates.push_back(Branch(x.first, x.second));
         }
     }
-    int index = (int) floor(candidates.size()*uniform_random());
+    int index = (int) floor(candidates.size()*rng.uniform());
     index = min((int) candidates.size() - 1, index);
     return {candidates[index], cut_time};
 }
 
 void Tree::internal_cut(double cut_time) {
-    for (auto it = parents.begin(); it != parents.end();) {
-        if (it->second->time <= cut_time) {
-            it = parents.erase(it);
-        } else {
-            ++it;
+    vector<Node_ptr> cut_nodes = {};
+    for (auto &x : parents) {
+        if (x.second->time <= cut_time) {
+            cut_nodes.push_back(x.first);
         }
     }
+    for (Node_ptr n : cut_nodes) {
+        parents.erase(n);
+    }
 }
 
 void Tree::internal_forward_update(Recombination &r, double cut_time) {
@@ -313,9 +326,10 @@ int Tree::distance(Node_ptr n1, Node_ptr n2) {
 
 void Tree::impute_states(double m, set<Branch> &mutation_branches) {
     map<Node_ptr, double> states = {};
+    int site = site_index().get_id(m);
     for (const Branch &b : mutation_branches) {
-        states[b.lower_node] = b.lower_node->get_state(m);
-        states[b.upper_node] = b.upper_node->get_state(m);
+        states[b.lower_node] = b.lower_node->get_state(site);
+        states[b.upper_node] = b.upper_node->get_state(site);
     }
     for (auto &x : parents) {
         impute_states_helper(x.first, states);
@@ -338,7 +352,3 @@ void Tree::impute_states_helper(Node_ptr n, map<Node_ptr, double> &states) {
     states[n] = states[p];
 }
 
-double Tree::random() {
-    double p = uniform_random();
-    return p;
-}
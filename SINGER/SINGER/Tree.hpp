@@ -15,13 +15,15 @@
 #include "random_utils.hpp"
 #include "Branch.hpp"
 #include "Recombination.hpp"
+#include "Persistent_map.hpp"
 
 class Tree {
 
 public:
     
-    map<Node_ptr, Node_ptr, compare_node> parents = {};
-    unordered_map<Node_ptr, unordered_set<Node_ptr>> children = {};
+    // copies of a tree share structure, so snapshots are cheap (see Persistent_map)
+    Persistent_map<Node_ptr, Node_ptr, compare_node> parents = {};
+    Persistent_map<Node_ptr, pair<Node_ptr, Node_ptr>, compare_node> children = {}; // at most two children per node
     
     Tree();
     
@@ -31,6 +33,10 @@ public:
     
     void delete_branch(const Branch &b);
     
+    void insert_child(Node_ptr p, Node_ptr c);
+    
+    void delete_child(Node_ptr p, Node_ptr c);
+    
     void internal_insert_branch(const Branch &b, double cut_time);
     
     void internal_delete_branch(const Branch &b, double cut_time);
@@ -47,7 +53,7 @@ public:
     
     Branch find_joining_branch(Branch removed_branch);
     
-    pair<Branch, double> sample_cut_point();
+    pair<Branch, double> sample_cut_point(Random_context &rng);
     
     void internal_cut(double cut_time);
     
@@ -81,7 +87,6 @@ public:
     
     void impute_states_helper(Node_ptr n, map<Node_ptr, double> &states);
     
-    double random();
     
 };
 
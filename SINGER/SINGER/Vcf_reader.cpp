@@ -0,0 +1,344 @@
+//
+//  Vcf_reader.cpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#include "Vcf_reader.hpp"
+#include <unistd.h>
+
+Vcf_reader::Vcf_reader(string prefix) {
+    filename = find(prefix);
+    file = fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        cerr << "VCF file not found: " + prefix + ".vcf" << endl;
+        exit(1);
+    }
+    int c0 = fgetc(file);
+    int c1 = fgetc(file);
+    compressed = (c0 == 0x1f and c1 == 0x8b);
+    memset(&stream, 0, sizeof(stream));
+    if (compressed) {
+        inflateInit2(&stream, 15 + 16);
+    }
+    input.resize(1 << 20);
+    buffer.resize(1 << 20);
+    seek_offset(0, 0);
+    string s;
+    long block, skip;
+    while (read_line(s, block, skip)) {
+        if (s.compare(0, 6, "#CHROM") == 0) {
+            istringstream iss(s);
+            string field;
+            int num_fields = 0;
+            while (iss >> field) {
+                num_fields += 1;
+            }
+            num_individuals = num_fields - 9;
+        } else if (s.size() > 0 and s[0] != '#') {
+            next_line = s;
+            has_next = true;
+            next_position = parse_position(next_line);
+            break;
+        }
+    }
+}
+
+string Vcf_reader::find(string prefix) {
+    struct stat info;
+    if (stat((prefix + ".vcf").c_str(), &info) != 0 and stat((prefix + ".vcf.gz").c_str(), &info) == 0) {
+        return prefix + ".vcf.gz";
+    }
+    return prefix + ".vcf";
+}
+
+Vcf_reader::~Vcf_reader() {
+    if (compressed) {
+        inflateEnd(&stream);
+    }
+    fclose(file);
+}
+
+void Vcf_reader::seek(double start) {
+    if (!has_next or next_position >= start) {
+        return;
+    }
+    if (!load_index()) {
+        build_index();
+    }
+    int bin = (int) (start/bin_width);
+    int k = (int) distance(bins.begin(), lower_bound(bins.begin(), bins.end(), bin));
+    has_next = false;
+    next_position = -1;
+    if (k == bins.size()) {
+        return;
+    }
+    seek_offset(blocks[k], skips[k]);
+    long block, skip;
+    while (read_data_line(next_line, block, skip)) {
+        next_position = parse_position(next_line);
+        if (next_position >= start) {
+            has_next = true;
+            return;
+        }
+    }
+    next_position = -1;
+}
+
+bool Vcf_reader::next() {
+    if (!has_next) {
+        return false;
+    }
+    swap(line, next_line);
+    long block, skip;
+    has_next = read_data_line(next_line, block, skip);
+    next_position = has_next ? parse_position(next_line) : -1;
+    parse_line();
+    return true;
+}
+
+int Vcf_reader::read_genotypes(vector<double> &genotypes) {
+    const char *p = line.c_str() + genotype_start;
+    int n = 0;
+    while (*p != '\0') {
+        const char *q = p;
+        while (*q != '\0' and *q != '\t' and *q != ' ') {
+            q++;
+        }
+        if (genotypes.size() < n + 2) {
+            genotypes.resize(n + 2);
+        }
+        genotypes[n] = (p[0] == '1');
+        genotypes[n + 1] = (q - p > 2 and p[2] == '1');
+        n += 2;
+        p = q;
+        while (*p == '\t' or *p == ' ') {
+            p++;
+        }
+    }
+    return n;
+}
+
+bool Vcf_reader::refill() {
+    if (!compressed) {
+        buffer_block = file_offset;
+        buffer_base = 0;
+        buffer_begin = 0;
+        buffer_end = fread(buffer.data(), 1, buffer.size(), file);
+        file_offset += buffer_end;
+        return buffer_end > 0;
+    }
+    buffer_base += buffer_end;
+    buffer_begin = 0;
+    buffer_end = 0;
+    while (buffer_end == 0) {
+        if (stream.avail_in == 0) {
+            size_t n = fread(input.data(), 1, input.size(), file);
+            file_offset += n;
+            stream.next_in = input.data();
+            stream.avail_in = (uInt) n;
+        }
+        if (member_done) {
+            if (stream.avail_in == 0) {
+                return false;
+            }
+            buffer_block = file_offset - stream.avail_in;
+            buffer_base = 0;
+            inflateReset(&stream);
+            member_done = false;
+        }
+        stream.next_out = (Bytef *) buffer.data();
+        stream.avail_out = (uInt) buffer.size();
+        int status = inflate(&stream, Z_NO_FLUSH);
+        buffer_end = buffer.size() - stream.avail_out;
+        if (status == Z_STREAM_END) {
+            member_done = true;
+        } else if (status == Z_BUF_ERROR and buffer_end == 0) {
+            return false; // the file ends within a member
+        } else if (status != Z_OK and status != Z_BUF_ERROR) {
+            cerr << "Corrupted gzip data in " << filename << endl;
+            exit(1);
+        }
+    }
+    return true;
+}
+
+void Vcf_reader::seek_offset(long block, long skip) {
+    fseek(file, block, SEEK_SET);
+    file_offset = block;
+    stream.avail_in = 0;
+    if (compressed) {
+        inflateReset(&stream);
+    }
+    member_done = false;
+    buffer_block = block;
+    buffer_base = 0;
+    buffer_begin = 0;
+    buffer_end = 0;
+    while (skip > 0) {
+        if (buffer_begin == buffer_end and !refill()) {
+            return;
+        }
+        size_t n = min((size_t) skip, buffer_end - buffer_begin);
+        buffer_begin += n;
+        skip -= n;
+    }
+}
+
+bool Vcf_reader::read_line(string &s, long &block, long &skip) {
+    s.clear();
+    if (buffer_begin == buffer_end and !refill()) {
+        return false;
+    }
+    if (compressed) {
+        block = buffer_block;
+        skip = buffer_base + buffer_begin;
+    } else {
+        block = buffer_block + buffer_begin;
+        skip = 0;
+    }
+    while (true) {
+        char *p = buffer.data() + buffer_begin;
+        char *q = (char *) memchr(p, '\n', buffer_end - buffer_begin);
+        if (q != nullptr) {
+            s.append(p, q - p);
+            buffer_begin = q + 1 - buffer.data();
+            break;
+        }
+        s.append(p, buffer_end - buffer_begin);
+        buffer_begin = buffer_end;
+        if (!refill()) {
+            break;
+        }
+    }
+    if (s.size() > 0 and s.back() == '\r') {
+        s.pop_back();
+    }
+    return true;
+}
+
+bool Vcf_reader::read_data_line(string &s, long &block, long &skip) {
+    while (read_line(s, block, skip)) {
+        if (s.size() > 0 and s[0] != '#') {
+            return true;
+        }
+    }
+    return false;
+}
+
+int Vcf_reader::parse_position(const string &s) {
+    const char *p = s.c_str();
+    while (*p != '\0' and *p != '\t' and *p != ' ') {
+        p++;
+    }
+    return atoi(p);
+}
+
+void Vcf_reader::parse_line() {
+    const char *begin = line.c_str();
+    const char *p = begin;
+    int field = 0;
+    while (field < 9 and *p != '\0') {
+        const char *q = p;
+        while (*q != '\0' and *q != '\t' and *q != ' ') {
+            q++;
+        }
+        if (field == 1) {
+            position = atoi(p);
+        } else if (field == 3) {
+            ref_length = (int) (q - p);
+        } else if (field == 4) {
+            alt_length = (int) (q - p);
+        }
+        field += 1;
+        p = q;
+        while (*p == '\t' or *p == ' ') {
+            p++;
+        }
+    }
+    genotype_start = p - begin;
+}
+
+string Vcf_reader::index_filename() {
+    return filename + ".sidx";
+}
+
+long Vcf_reader::file_size() {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        return -1;
+    }
+    return (long) info.st_size;
+}
+
+int64_t Vcf_reader::file_mtime() {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        return -1;
+    }
+    return (int64_t) info.st_mtim.tv_sec*1000000000 + info.st_mtim.tv_nsec;
+}
+
+bool Vcf_reader::load_index() {
+    ifstream file(index_filename());
+    if (!file.is_open()) {
+        return false;
+    }
+    string header, tag;
+    int width = 0;
+    long size = 0;
+    int64_t mtime = 0;
+    getline(file, header);
+    istringstream iss(header);
+    iss >> tag >> width >> size >> mtime;
+    if (tag != "##singer_vcf_index" or width <= 0 or size != file_size() or mtime != file_mtime()) {
+        return false; // written for another version of the VCF
+    }
+    bin_width = width;
+    bins.clear();
+    blocks.clear();
+    skips.clear();
+    int bin;
+    long block, skip;
+    while (file >> bin >> block >> skip) {
+        bins.push_back(bin);
+        blocks.push_back(block);
+        skips.push_back(skip);
+    }
+    return true;
+}
+
+void Vcf_reader::build_index() {
+    cout << "Indexing " << filename << endl;
+    bins.clear();
+    blocks.clear();
+    skips.clear();
+    seek_offset(0, 0);
+    string s;
+    long block, skip;
+    while (read_data_line(s, block, skip)) {
+        int bin = parse_position(s)/bin_width;
+        if (bins.size() == 0 or bin > bins.back()) {
+            bins.push_back(bin);
+            blocks.push_back(block);
+            skips.push_back(skip);
+        }
+    }
+    write_index();
+}
+
+void Vcf_reader::write_index() {
+    // other processes may be reading the same VCF, so the index appears in one rename
+    string temp_filename = index_filename() + "." + to_string(getpid());
+    ofstream file(temp_filename);
+    if (!file.is_open()) {
+        return; // the index is kept for this run only
+    }
+    file << "##singer_vcf_index" << "\t" << bin_width << "\t" << file_size() << "\t" << file_mtime() << endl;
+    for (int i = 0; i < bins.size(); i++) {
+        file << bins[i] << "\t" << blocks[i] << "\t" << skips[i] << "\n";
+    }
+    file.close();
+    rename(temp_filename.c_str(), index_filename().c_str());
+}
@@ -0,0 +1,104 @@
+//
+//  Vcf_reader.hpp
+//  SINGER
+//
+//  Created by Yun Deng on 10/18/26.
+//
+
+#ifndef Vcf_reader_hpp
+#define Vcf_reader_hpp
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <sys/stat.h>
+#include <zlib.h>
+
+using namespace std;
+
+// Streams the variant lines of prefix.vcf or prefix.vcf.gz (bgzip or plain gzip). Each line is
+// held back by one, so the position of the next line is known without reading it twice, and the
+// fields are split by hand. seek goes to the first line at or after a position through an index
+// of the first line in every bin of bin_width bases, kept next to the VCF in a .sidx file and
+// built with one pass over the positions the first time it is needed. A line is located by the
+// offset of its gzip member in the file and its offset in the member's text, so seeking into a
+// bgzip file inflates one block of 64 KB; for a plain VCF the member is the whole file.
+class Vcf_reader {
+
+public:
+
+    string filename = "";
+    FILE *file = nullptr;
+    bool compressed = false;
+    z_stream stream;
+    vector<unsigned char> input = {};
+    long file_offset = 0; // bytes of the file read into input
+    bool member_done = false;
+    vector<char> buffer = {};
+    size_t buffer_begin = 0;
+    size_t buffer_end = 0;
+    long buffer_block = 0; // member of the text in buffer
+    long buffer_base = 0; // offset of buffer[0] in that member
+
+    int num_individuals = 0; // columns after FORMAT in the #CHROM line
+    string line = "";
+    string next_line = "";
+    bool has_next = false;
+    int position = -1;
+    int next_position = -1; // -1 at the end of the file
+    int ref_length = 0;
+    int alt_length = 0;
+    size_t genotype_start = 0; // first character of the genotype columns of line
+
+    int bin_width = 16384;
+    vector<int> bins = {};
+    vector<long> blocks = {};
+    vector<long> skips = {};
+
+    Vcf_reader(string prefix);
+
+    static string find(string prefix); // prefix.vcf, or prefix.vcf.gz if there is no plain one
+
+    Vcf_reader(const Vcf_reader &) = delete;
+
+    ~Vcf_reader();
+
+    void seek(double start); // the next line read is the first one at or after start
+
+    bool next(); // false after the last line
+
+    int read_genotypes(vector<double> &genotypes); // haplotype states of line, returns their number
+
+    bool refill();
+
+    void seek_offset(long block, long skip);
+
+    bool read_line(string &s, long &block, long &skip);
+
+    bool read_data_line(string &s, long &block, long &skip);
+
+    int parse_position(const string &s);
+
+    void parse_line();
+
+    string index_filename();
+
+    long file_size();
+
+    int64_t file_mtime(); // modification time in nanoseconds
+
+    bool load_index();
+
+    void build_index();
+
+    void write_index();
+};
+
+#endif /* Vcf_reader_hpp */
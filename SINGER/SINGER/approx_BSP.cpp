@@ -10,15 +10,64 @@
 approx_BSP::approx_BSP() {}
 
 approx_BSP::~approx_BSP() {
-    vector<vector<double>>().swap(forward_probs);
-    map<int, vector<Interval_ptr>>().swap(state_spaces);
+    map<int, vector<Interval *>>().swap(state_spaces);
     map<int, vector<double>>().swap(times);
     map<int, vector<double>>().swap(weights);
 }
 
+void approx_BSP::reset() {
+    cut_time = 0;
+    cutoff = 0;
+    check_points.clear();
+    rhos.clear();
+    recomb_sums.clear();
+    weight_sums.clear();
+    curr_index = 0;
+    interval_pool.clear();
+    state_spaces.clear();
+    state_spaces[INT_MAX] = {};
+    curr_intervals.clear();
+    temp_intervals.clear();
+    times.clear();
+    times[INT_MAX] = {};
+    weights.clear();
+    weights[INT_MAX] = {};
+    cc.reset();
+    transfer_infos.clear();
+    transfer_sources.clear();
+    transfer_weights.clear();
+    transfer_order.clear();
+    prev_rho = -1;
+    prev_theta = -1;
+    prev_node = nullptr;
+    dim = 0;
+    recomb_sum = 0;
+    weight_sum = 0;
+    temp.clear();
+    sample_index = -1;
+    trace_back_probs.clear();
+    forward_probs.clear();
+    emit_thetas.clear();
+    emit_bin_sizes.clear();
+    emit_nodes.clear();
+    emit_mut_offsets.resize(1);
+    emit_mutations.clear();
+    states_change = false;
+    valid_branches.clear();
+}
+
 void approx_BSP::reserve_memory(int length) {
-    // forward_probs.reserve(length);
-    forward_probs.resize(length);
+    forward_probs.reserve(length);
+    if (forward_probs.spacing > 0) {
+        emit_thetas.reserve(length);
+        emit_bin_sizes.reserve(length);
+        emit_nodes.reserve(length);
+        emit_mut_offsets.reserve(length + 1);
+    }
+}
+
+void approx_BSP::set_checkpoint(int k) {
+    forward_probs.set_spacing(k);
 }
 
 void approx_BSP::start(set<Branch> &branches, double t) {
@@ -32,23 +81,27 @@ void approx_BSP::start(set<Branch> &branches, double t) {
     double lb = 0;
     double ub = 0;
     double p = 0;
-    Interval_ptr new_interval = nullptr;
-    cc = make_shared<approx_coalescent_calculator>(cut_time);
+    Interval *new_interval = nullptr;
+    if (exact_coalescent) {
+        cc = make_shared<fast_coalescent_calculator>(cut_time);
+    } else {
+        cc = make_shared<approx_coalescent_calculator>(cut_time);
+    }
     cc->start(valid_branches);
     for (const Branch &b : branches) {
         if (b.upper_node->time > cut_time) {
             lb = max(b.lower_node->time, cut_time);
             ub = b.upper_node->time;
             p = cc->prob(lb, ub);
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             new_interval->source_pos = curr_index;
             curr_intervals.push_back(new_interval);
             temp.push_back(p);
         }
     }
     cutoff = min(0.01, cutoff/curr_intervals.size()); // adjust cutoff based on number of states;
-    // forward_probs.push_back(temp);
-    forward_probs[curr_index] = temp;
+    forward_probs.add_row(temp);
+    forward_probs.pin(curr_index);
     weight_sums.push_back(0.0);
     set_dimensions();
     compute_interval_info();
@@ -67,23 +120,27 @@ void approx_BSP::start(Tree &tree, double t) {
     double lb = 0;
     double ub = 0;
     double p = 0;
-    Interval_ptr new_interval = nullptr;
-    cc = make_shared<approx_coalescent_calculator>(cut_time);
+    Interval *new_interval = nullptr;
+    if (exact_coalescent) {
+        cc = make_shared<fast_coalescent_calculator>(cut_time);
+    } else {
+        cc = make_shared<approx_coalescent_calculator>(cut_time);
+    }
     cc->start(valid_branches);
     for (auto &x : tree.parents) {
         if (x.second->time > cut_time) {
             lb = max(x.first->time, cut_time);
             ub = x.second->time;
             p = cc->prob(lb, ub);
-            new_interval = create_interval(Branch(x.first, x.second), lb, ub, curr_index);
+            new_interval = interval_pool.create(Branch(x.first, x.second), lb, ub, curr_index);
             new_interval->source_pos = curr_index;
             curr_intervals.push_back(new_interval);
             temp.push_back(p);
         }
     }
     cutoff = min(0.01, cutoff/curr_intervals.size()); // adjust cutoff based on number of states;
-    // forward_probs.push_back(temp);
-    forward_probs[curr_index] = temp;
+    forward_probs.add_row(temp);
+    forward_probs.pin(curr_index);
     weight_sums.push_back(0.0);
     set_dimensions();
     compute_interval_info();
@@ -109,12 +166,14 @@ void approx_BSP::forward(double rho) {
     compute_recomb_weights(rho);
     prev_rho = rho;
     curr_index += 1;
-    recomb_sum = inner_product(recomb_probs.begin(), recomb_probs.end(), forward_probs[curr_index - 1].begin(), 0.0);
-    // forward_probs.push_back(recomb_probs);
-    forward_probs[curr_index] = recomb_probs;
-    for (int i = 0; i < dim; i++) {
-        forward_probs[curr_index][i] = forward_probs[curr_index - 1][i]*(1 - recomb_probs[i]) + recomb_sum*recomb_weights[i];
-    }
+    recomb_sum = inner_product(recomb_probs.begin(), recomb_probs.end(), forward_probs[curr_index - 1], 0.0);
+    double *curr_probs = forward_probs.add_row(dim);
+    double *prev_probs = forward_probs[curr_index - 1];
+    for_states([&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            curr_probs[i] = prev_probs[i]*(1 - recomb_probs[i]) + recomb_sum*recomb_weights[i];
+        }
+    });
     recomb_sums.push_back(recomb_sum);
     weight_sums.push_back(weight_sum);
 }
@@ -126,9 +185,11 @@ void approx_BSP::transfer(Recombination &r) {
     recomb_sums.push_back(0);
     weight_sums.push_back(0);
     sanity_check(r);
+    forward_probs.pin(curr_index);
     curr_index += 1;
+    transfer_infos.clear();
+    transfer_sources.clear();
     transfer_weights.clear();
-    transfer_intervals.clear();
     temp.clear();
     temp_intervals.clear();
     for (int i = 0; i < curr_intervals.size(); i++) {
@@ -140,6 +201,7 @@ void approx_BSP::transfer(Recombination &r) {
     cc->update(r);
     compute_interval_info();
     state_spaces[curr_index] = curr_intervals;
+    forward_probs.pin(curr_index);
 }
 
 double approx_BSP::get_recomb_prob(double rho, double t) {
@@ -151,36 +213,48 @@ void approx_BSP::null_emit(double theta, Node_ptr query_node) {
     compute_null_emit_prob(theta, query_node);
     prev_theta = theta;
     prev_node = query_node;
-    double ws = 0;
-    auto &curr_probs = forward_probs[curr_index];
-    for (int i = 0; i < dim; i++) {
-        if (curr_probs[i] > 0) {
-            curr_probs[i] = max(epsilon, curr_probs[i]*null_emit_probs[i]);
-            ws += curr_probs[i];
-        }
-        // ws += curr_probs[i];
-    }
-    assert(ws > 0);
-    for (int i = 0; i < dim; i++) {
-        curr_probs[i] /= ws;
+    apply_emission(forward_probs[curr_index], null_emit_probs);
+    if (forward_probs.spacing > 0) {
+        record_emission(theta, 0, query_node);
     }
 }
 
 void approx_BSP::mut_emit(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node) {
     compute_mut_emit_probs(theta, bin_size, mut_set, query_node);
+    apply_emission(forward_probs[curr_index], mut_emit_probs);
+    if (forward_probs.spacing > 0) {
+        emit_mutations.insert(emit_mutations.end(), mut_set.begin(), mut_set.end());
+        record_emission(theta, bin_size, query_node);
+    }
+}
+
+void approx_BSP::apply_emission(double *probs, vector<double> &emit_probs) {
+    for_states([&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (probs[i] > 0) {
+                probs[i] = max(epsilon, probs[i]*emit_probs[i]);
+            }
+        }
+    });
+    // summed in order after the update, zeros add nothing
     double ws = 0;
-    auto &curr_probs = forward_probs[curr_index];
     for (int i = 0; i < dim; i++) {
-        if (curr_probs[i] > 0) {
-            curr_probs[i] = max(epsilon, curr_probs[i]*mut_emit_probs[i]);
-            ws += curr_probs[i];
-        }
-        // ws += curr_probs[i];
+        ws += probs[i];
     }
     assert(ws > 0);
-    for (int i = 0; i < dim; i++) {
-        curr_probs[i] /= ws;
-    }
+    for_states([&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            probs[i] /= ws;
+        }
+    });
+}
+
+void approx_BSP::record_emission(double theta, double bin_size, Node_ptr query_node) {
+    assert(emit_thetas.size() == curr_index);
+    emit_thetas.push_back(theta);
+    emit_bin_sizes.push_back(bin_size);
+    emit_nodes.push_back(query_node);
+    emit_mut_offsets.push_back((int) emit_mutations.size());
 }
 
 map<double, Branch> approx_BSP::sample_joining_branches(int start_index, vector<double> &coordinates) {
@@ -189,11 +263,11 @@ map<double, Branch> approx_BSP::sample_joining_branches(int start_index, vector<
     int x = curr_index;
     int y = 0;
     double pos = coordinates[x + start_index + 1];
-    Interval_ptr interval = sample_curr_interval(x);
+    Interval *interval = sample_curr_interval(x);
     Branch b = interval->branch;
     joining_branches[pos] = b;
     while (x >= 0) {
-        vector<Interval_ptr> &intervals = get_state_space(x);
+        vector<Interval *> &intervals = get_state_space(x);
         assert(intervals[sample_index] == interval);
         x = trace_back_helper(interval, x);
         b = interval->branch;
@@ -224,57 +298,66 @@ void approx_BSP::set_dimensions() {
     recomb_weights.resize(dim); recomb_weights.assign(dim, 0);
     null_emit_probs.resize(dim); null_emit_probs.assign(dim, 0);
     mut_emit_probs.resize(dim); mut_emit_probs.assign(dim, 0);
+    lower_nodes.resize(dim);
+    upper_nodes.resize(dim);
+    lower_times.resize(dim);
+    upper_times.resize(dim);
 }
 
 void approx_BSP::compute_recomb_probs(double rho) {
     if (prev_rho == rho) {
         return;
     }
-    double rb = 0;
-    for (int i = 0; i < dim; i++) {
-        rb = get_recomb_prob(rho, time_points[i]);
-        recomb_probs[i] = rb;
-    }
+    for_states([&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            recomb_probs[i] = get_recomb_prob(rho, time_points[i]);
+        }
+    });
 }
 
 void approx_BSP::compute_recomb_weights(double rho) {
     if (prev_rho == rho) {
         return;
     }
-    for (int i = 0; i < dim; i++) {
-        if (curr_intervals[i]->full(cut_time)) {
-            recomb_weights[i] = recomb_probs[i]*raw_weights[i];
+    for_states([&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (curr_intervals[i]->full(cut_time)) {
+                recomb_weights[i] = recomb_probs[i]*raw_weights[i];
+            }
         }
-    }
+    });
     weight_sum = accumulate(recomb_weights.begin(), recomb_weights.end(), 0.0);
-    for (int i = 0; i < dim; i++) {
-        recomb_weights[i] /= weight_sum;
-    }
+    for_states([&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            recomb_weights[i] /= weight_sum;
+        }
+    });
 }
 
 void approx_BSP::compute_null_emit_prob(double theta, Node_ptr query_node) {
     if (theta == prev_theta and query_node == prev_node) {
         return;
     }
-    for (int i = 0; i < dim; i++) {
-        null_emit_probs[i] = eh->null_emit(curr_intervals[i]->branch, time_points[i], theta, query_node);
-    }
+    eh->prepare_null_emit(dim, null_emit_probs);
+    for_states([&](int begin, int end) {
+        eh->null_emit(begin, end, time_points, lower_times, upper_times, theta, query_node, null_emit_probs);
+    });
 }
 
 void approx_BSP::compute_mut_emit_probs(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node) {
-    for (int i = 0; i < dim; i++) {
-        mut_emit_probs[i] = eh->mut_emit(curr_intervals[i]->branch, time_points[i], theta, bin_size, mut_set, query_node);
-    }
+    eh->mut_emit(time_points, lower_nodes, upper_nodes, theta, bin_size, mut_set, query_node, mut_emit_probs);
 }
 
-void approx_BSP::transfer_helper(Interval_info &next_interval, Interval_ptr &prev_interval, double w) {
-    transfer_weights[next_interval].push_back(w);
-    transfer_intervals[next_interval].push_back(prev_interval);
+void approx_BSP::transfer_helper(Interval_info &next_interval, Interval *prev_interval, double w) {
+    transfer_infos.push_back(next_interval);
+    transfer_sources.push_back(prev_interval);
+    transfer_weights.push_back(w);
 }
 
 void approx_BSP::transfer_helper(Interval_info &next_interval) {
-    transfer_weights[next_interval];
-    transfer_intervals[next_interval];
+    transfer_infos.push_back(next_interval);
+    transfer_sources.push_back(nullptr);
+    transfer_weights.push_back(0);
 }
 
 void approx_BSP::add_new_branches(Recombination &r) { // add recombined branch and merging branch, if legal
@@ -300,7 +383,7 @@ void approx_BSP::compute_interval_info() {
     double t;
     double p;
     for (int i = 0; i < curr_intervals.size(); i++) {
-        Interval_ptr interval = curr_intervals[i];
+        Interval *interval = curr_intervals[i];
         p = cc->prob(interval->lb, interval->ub);
         t = cc->find_median(interval->lb, interval->ub);
         interval->weight = p;
@@ -317,7 +400,7 @@ void approx_BSP::compute_interval_info() {
     double t;
     double p;
     for (int i = 0; i < curr_intervals.size(); i++) {
-        const Interval_ptr &interval = curr_intervals[i];
+        Interval *interval = curr_intervals[i];
         if (interval->start_pos == curr_index) {
             p = cc->prob(interval->lb, interval->ub);
             t = cc->find_median(interval->lb, interval->ub);
@@ -329,6 +412,10 @@ void approx_BSP::compute_interval_info() {
             raw_weights[i] = interval->weight;
             time_points[i] = interval->time;
         }
+        lower_nodes[i] = interval->branch.lower_node;
+        upper_nodes[i] = interval->branch.upper_node;
+        lower_times[i] = lower_nodes[i]->time;
+        upper_times[i] = upper_nodes[i]->time;
     }
     times[curr_index] = time_points;
     weights[curr_index] = raw_weights;
@@ -336,7 +423,7 @@ void approx_BSP::compute_interval_info() {
 
 void approx_BSP::sanity_check(Recombination &r) {
     for (int i = 0; i < curr_intervals.size(); i++) {
-        const Interval_ptr& interval = curr_intervals[i];
+        Interval *interval = curr_intervals[i];
         if (interval->lb == interval->ub and interval->lb == r.inserted_node->time and interval->branch != r.target_branch) {
             forward_probs[curr_index][i] = 0;
         }
@@ -351,42 +438,40 @@ void approx_BSP::generate_intervals(Recombination &r) {
     double lb;
     double ub;
     double p;
-    vector<Interval_ptr> intervals;
-    vector<double> weights;
+    int n = (int) transfer_infos.size();
+    int j = 0;
+    int k = 0;
     Interval_info interval;
-    Interval_ptr new_interval = nullptr;
-    auto y = transfer_intervals.begin();
-    for (auto x = transfer_weights.begin(); x != transfer_weights.end(); ++x, ++y) {
-        interval = x->first;
-        auto &weights = x->second;
-        auto &intervals = y->second;
+    Interval *new_interval = nullptr;
+    sort_transfers(transfer_infos, transfer_order);
+    for (j = 0; j < n; j = k) {
+        interval = transfer_infos[transfer_order[j]];
         b = interval.branch;
         lb = interval.lb;
         ub = interval.ub;
-        p = accumulate(weights.begin(), weights.end(), 0.0);
+        p = 0;
+        for (k = j; k < n and !(interval < transfer_infos[transfer_order[k]]); k++) {
+            if (transfer_sources[transfer_order[k]] != nullptr) {
+                p += transfer_weights[transfer_order[k]];
+            }
+        }
         assert(!isnan(p));
         if (lb == max(cut_time, b.lower_node->time)) { // full intervals
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             temp_intervals.push_back(new_interval);
             temp.push_back(p);
-            if (weights.size() > 0) {
-                new_interval->source_weights = move(weights);
-                new_interval->intervals = move(intervals);
-            }
+            add_sources(new_interval, j, k);
         } else if (p > cutoff) { // partial intervals
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             temp_intervals.push_back(new_interval);
             temp.push_back(p);
-            if (weights.size() > 0) {
-                new_interval->source_weights = move(weights);
-                new_interval->intervals = move(intervals);
-            }
+            add_sources(new_interval, j, k);
             if (lb == ub) { // Need to find out where the point mass is from
                 if (b == r.merging_branch and lb == r.deleted_node->time) {
                     new_interval->node = r.deleted_node; // creation of a new point mass
                 } else {
-                    assert(new_interval->intervals.size() == 1);
-                    new_interval->node = new_interval->intervals.front()->node;
+                    assert(interval_pool.num_sources(new_interval) == 1);
+                    new_interval->node = interval_pool.source(new_interval, 0)->node;
                 }
             }
             if (new_interval->lb < new_interval->ub) {
@@ -396,11 +481,19 @@ void approx_BSP::generate_intervals(Recombination &r) {
             }
         }
     }
-    // forward_probs.push_back(temp);
-    forward_probs[curr_index] = temp;
+    forward_probs.add_row(temp);
     curr_intervals = move(temp_intervals);
 }
 
+void approx_BSP::add_sources(Interval *interval, int j, int k) {
+    for (int i = j; i < k; i++) {
+        Interval *source = transfer_sources[transfer_order[i]];
+        if (source != nullptr) {
+            interval_pool.add_source(interval, source, transfer_weights[transfer_order[i]]);
+        }
+    }
+}
+
 double approx_BSP::get_overwrite_prob(Recombination &r, double lb, double ub) {
     if (check_points.count(r.pos) > 0) {
         return 0.0;
@@ -429,7 +522,7 @@ void approx_BSP::process_interval(Recombination &r, int i) {
 
 void approx_BSP::process_source_interval(Recombination &r, int i) {
     double w1, w2, lb, ub = 0;
-    Interval_ptr prev_interval = curr_intervals[i];
+    Interval *prev_interval = curr_intervals[i];
     double p = forward_probs[curr_index - 1][i];
     double point_time = r.source_branch.upper_node->time;
     double break_time = r.start_time;
@@ -472,7 +565,7 @@ void approx_BSP::process_source_interval(Recombination &r, int i) {
 
 void approx_BSP::process_target_interval(Recombination &r, int i) {
     double w0, w1, w2, lb, ub = 0;
-    Interval_ptr prev_interval = curr_intervals[i];
+    Interval *prev_interval = curr_intervals[i];
     double p = forward_probs[curr_index - 1][i];
     double join_time = r.inserted_node->time;
     Branch next_branch;
@@ -529,7 +622,7 @@ void approx_BSP::process_target_interval(Recombination &r, int i) {
 
 void approx_BSP::process_other_interval(Recombination &r, int i) {
     double lb, ub = 0;
-    Interval_ptr prev_interval = curr_intervals[i];
+    Interval *prev_interval = curr_intervals[i];
     double p = forward_probs[curr_index - 1][i];
     if (prev_interval->branch != r.source_sister_branch and prev_interval->branch != r.source_parent_branch) {
         // in other words, not affected by recombination
@@ -550,8 +643,7 @@ void approx_BSP::process_other_interval(Recombination &r, int i) {
 }
 
 double approx_BSP::random() {
-    double p = uniform_random();
-    return p;
+    return rng->uniform();
 }
 
 int approx_BSP::get_prev_breakpoint(int x) {
@@ -560,7 +652,7 @@ int approx_BSP::get_prev_breakpoint(int x) {
     return state_it->first;
 }
 
-vector<Interval_ptr> &approx_BSP::get_state_space(int x) {
+vector<Interval *> &approx_BSP::get_state_space(int x) {
     auto state_it = state_spaces.upper_bound(x);
     state_it--;
     return state_it->second;
@@ -578,7 +670,7 @@ vector<double> &approx_BSP::get_raw_weights(int x) {
     return weight_it->second;
 }
 
-int approx_BSP::get_interval_index(Interval_ptr interval, vector<Interval_ptr > &intervals) {
+int approx_BSP::get_interval_index(Interval *interval, vector<Interval *> &intervals) {
     auto it = find(intervals.begin(), intervals.end(), interval);
     int index = (int) distance(intervals.begin(), it);
     return index;
@@ -598,13 +690,14 @@ void approx_BSP::simplify(map<double, Branch> &joining_branches) {
     joining_branches = simplified_joining_branches;
 }
 
-Interval_ptr approx_BSP::sample_curr_interval(int x) {
-    vector<Interval_ptr > &intervals = get_state_space(x);
-    double ws = accumulate(forward_probs[x].begin(), forward_probs[x].end(), 0.0);
+Interval *approx_BSP::sample_curr_interval(int x) {
+    vector<Interval *> &intervals = get_state_space(x);
+    double *probs = get_forward_probs(x);
+    double ws = accumulate(probs, probs + forward_probs.dim(x), 0.0);
     double q = random();
     double w = ws*q;
     for (int i = 0; i < intervals.size(); i++) {
-        w -= forward_probs[x][i];
+        w -= probs[i];
         if (w <= 0) {
             sample_index = i;
             return intervals[i];
@@ -614,17 +707,18 @@ Interval_ptr approx_BSP::sample_curr_interval(int x) {
     exit(1);
 }
 
-Interval_ptr approx_BSP::sample_prev_interval(int x) {
-    vector<Interval_ptr > &intervals = get_state_space(x);
+Interval *approx_BSP::sample_prev_interval(int x) {
+    vector<Interval *> &intervals = get_state_space(x);
     vector<double> &prev_times = get_time_points(x);
     double rho = rhos[x];
     double ws = recomb_sums[x];
     double q = random();
     double w = ws*q;
     double rb = 0;
+    double *probs = get_forward_probs(x);
     for (int i = 0; i < intervals.size(); i++) {
         rb = get_recomb_prob(rho, prev_times[i]);
-        w -= rb*forward_probs[x][i];
+        w -= rb*probs[i];
         if (w <= 0) {
             sample_index = i;
             return intervals[i];
@@ -634,19 +728,22 @@ Interval_ptr approx_BSP::sample_prev_interval(int x) {
     exit(1);
 }
 
-Interval_ptr approx_BSP::sample_source_interval(Interval_ptr interval, int x) {
-    vector<Interval_ptr> &intervals = interval->intervals;
-    vector<double> &weights = interval->source_weights;
-    vector<Interval_ptr> &prev_intervals = get_state_space(x);
+Interval *approx_BSP::sample_source_interval(Interval *interval, int x) {
+    vector<Interval *> &prev_intervals = get_state_space(x);
     if (x == interval->start_pos - 1) {
+        int n = interval_pool.num_sources(interval);
         double q = random();
-        double ws = accumulate(weights.begin(), weights.end(), 0.0);
+        double ws = 0;
+        for (int i = 0; i < n; i++) {
+            ws += interval_pool.source_weight(interval, i);
+        }
         double w = ws*q;
-        for (int i = 0; i < weights.size(); i++) {
-            w -= weights[i];
+        for (int i = 0; i < n; i++) {
+            w -= interval_pool.source_weight(interval, i);
             if (w <= 0) {
-                sample_index = get_interval_index(intervals[i], prev_intervals);
-                return intervals[i];
+                Interval *source = interval_pool.source(interval, i);
+                sample_index = get_interval_index(source, prev_intervals);
+                return source;
             }
         }
         cerr << "approx bsp sample_source_interval failed" << endl;
@@ -658,7 +755,7 @@ Interval_ptr approx_BSP::sample_source_interval(Interval_ptr interval, int x) {
     }
 }
 
-int approx_BSP::trace_back_helper(Interval_ptr interval, int x) {
+int approx_BSP::trace_back_helper(Interval *interval, int x) {
     int y = get_prev_breakpoint(x);
     if (!interval->full(cut_time)) {
         return y;
@@ -675,13 +772,14 @@ int approx_BSP::trace_back_helper(Interval_ptr interval, int x) {
     double non_recomb_prob = 0;
     double all_prob = 0;
     while (x > y) {
+        double *prev_probs = get_forward_probs(x - 1);
         recomb_sum = recomb_sums[x - 1];
         weight_sum = weight_sums[x];
         if (recomb_sum == 0) {
             shrinkage = 1;
         } else {
             recomb_prob = get_recomb_prob(rhos[x - 1], t);
-            non_recomb_prob = (1 - recomb_prob)*forward_probs[x - 1][sample_index];
+            non_recomb_prob = (1 - recomb_prob)*prev_probs[sample_index];
             all_prob = non_recomb_prob + recomb_sum*w*recomb_prob/weight_sum;
             shrinkage = non_recomb_prob/all_prob;
             assert(shrinkage >= 0 and shrinkage <= 1);
@@ -695,6 +793,63 @@ int approx_BSP::trace_back_helper(Interval_ptr interval, int x) {
     return y;
 }
 
+double *approx_BSP::get_forward_probs(int x) {
+    if (!forward_probs.available(x)) {
+        recompute_segment(x);
+    }
+    return forward_probs[x];
+}
+
+void approx_BSP::load_state_space(int x) {
+    curr_intervals = get_state_space(x);
+    set_dimensions();
+    time_points = get_time_points(x);
+    raw_weights = get_raw_weights(x);
+    for (int i = 0; i < dim; i++) {
+        lower_nodes[i] = curr_intervals[i]->branch.lower_node;
+        upper_nodes[i] = curr_intervals[i]->branch.upper_node;
+        lower_times[i] = lower_nodes[i]->time;
+        upper_times[i] = upper_nodes[i]->time;
+    }
+    prev_rho = -1;
+    prev_theta = -1;
+    prev_node = nullptr;
+}
+
+// replay forward() and the emission of every bin between the stored rows around x
+void approx_BSP::recompute_segment(int x) {
+    int c = forward_probs.prev_stored(x);
+    int e = forward_probs.next_stored(x);
+    load_state_space(c);
+    forward_probs.start_segment(c + 1);
+    for (int z = c + 1; z < e; z++) {
+        double rho = rhos[z - 1];
+        compute_recomb_probs(rho);
+        compute_recomb_weights(rho);
+        prev_rho = rho;
+        double *curr_probs = forward_probs.add_segment_row(dim);
+        double *prev_probs = forward_probs[z - 1];
+        double sum = recomb_sums[z - 1];
+        for_states([&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                curr_probs[i] = prev_probs[i]*(1 - recomb_probs[i]) + sum*recomb_weights[i];
+            }
+        });
+        double theta = emit_thetas[z];
+        Node_ptr query_node = emit_nodes[z];
+        if (emit_mut_offsets[z + 1] > emit_mut_offsets[z]) {
+            set<double> mut_set = set<double>(emit_mutations.begin() + emit_mut_offsets[z], emit_mutations.begin() + emit_mut_offsets[z + 1]);
+            compute_mut_emit_probs(theta, emit_bin_sizes[z], mut_set, query_node);
+            apply_emission(curr_probs, mut_emit_probs);
+        } else {
+            compute_null_emit_prob(theta, query_node);
+            prev_theta = theta;
+            prev_node = query_node;
+            apply_emission(curr_probs, null_emit_probs);
+        }
+    }
+}
+
 double approx_BSP::avg_num_states() {
     int span = 0;
     double count = 0;
@@ -13,11 +13,12 @@
 #include "Tree.hpp"
 #include "Coalescent_calculator.hpp"
 #include "approx_coalescent_calculator.hpp"
+#include "fast_coalescent_calculator.hpp"
 #include "Interval.hpp"
+#include "Forward_buffer.hpp"
 #include "Emission.hpp"
 #include "Binary_emission.hpp"
-
-using Interval_ptr = shared_ptr<Interval>;
+#include "Thread_team.hpp"
 
 class approx_BSP {
     
@@ -34,6 +35,9 @@ public:
     double rho_unit = 0;
     int grace_period = 0;
     double penalty = 1;
+    Random_context *rng = &thread_random_context();
+    Thread_team *team = nullptr; // shares the loops over states of bins with at least min_team_dim states
+    int min_team_dim = 256;
     
     // hmm running results
     vector<double> rhos = {};
@@ -42,18 +46,22 @@ public:
     
     // hmm states
     int curr_index = 0;
-    map<int, vector<Interval_ptr>>  state_spaces = {{INT_MAX, {}}};
-    vector<Interval_ptr> curr_intervals = {};
-    vector<Interval_ptr> temp_intervals = {};
+    Interval_pool interval_pool;
+    map<int, vector<Interval *>>  state_spaces = {{INT_MAX, {}}};
+    vector<Interval *> curr_intervals = {};
+    vector<Interval *> temp_intervals = {};
     map<int, vector<double>> times = {{INT_MAX, {}}};
     map<int, vector<double>> weights = {{INT_MAX, {}}};
     
     // coalescent computation
-    shared_ptr<approx_coalescent_calculator> cc;
+    shared_ptr<Coalescent_prior> cc;
+    bool exact_coalescent = false; // fast_coalescent_calculator in place of approx_coalescent_calculator
     
-    // transfer at recombinations
-    map<Interval_info, vector<Interval_ptr>> transfer_intervals = {};
-    map<Interval_info, vector<double>> transfer_weights = {};
+    // transfer at recombinations, grouped by target interval with sort_transfers:
+    vector<Interval_info> transfer_infos = {};
+    vector<Interval *> transfer_sources = {}; // nullptr for a target without source
+    vector<double> transfer_weights = {};
+    vector<int> transfer_order = {};
     
     // cache:
     double prev_rho = -1;
@@ -71,9 +79,20 @@ public:
     vector<double> recomb_weights = {};
     vector<double> null_emit_probs = {};
     vector<double> mut_emit_probs = {};
+    vector<Node_ptr> lower_nodes = {};
+    vector<Node_ptr> upper_nodes = {};
+    vector<double> lower_times = {};
+    vector<double> upper_times = {};
     int sample_index = -1;
     vector<double> trace_back_probs = {};
-    vector<vector<double>> forward_probs = {};
+    Forward_buffer forward_probs;
+    
+    // emission inputs per bin, kept for recomputation when checkpointing:
+    vector<double> emit_thetas = {};
+    vector<double> emit_bin_sizes = {};
+    vector<Node_ptr> emit_nodes = {};
+    vector<int> emit_mut_offsets = {0};
+    vector<double> emit_mutations = {};
     
     // states after pruning:
     bool states_change = false;
@@ -83,8 +102,12 @@ public:
     
     ~approx_BSP();
     
+    void reset(); // clear all hmm state but keep allocated capacity, so the engine can be reused
+    
     void reserve_memory(int length);
     
+    void set_checkpoint(int k); // store forward probabilities every k bins only, 0 stores all
+    
     void start(set<Branch> &branches, double t);
     
     void start(Tree &tree, double t);
@@ -105,6 +128,10 @@ public:
     
     void mut_emit(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node);
     
+    void apply_emission(double *probs, vector<double> &emit_probs);
+    
+    void record_emission(double theta, double bin_size, Node_ptr query_node);
+    
     map<double, Branch> sample_joining_branches(int start_index, vector<double> &coordinates);
     
     void set_dimensions();
@@ -117,10 +144,12 @@ public:
     
     void compute_mut_emit_probs(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node);
     
-    void transfer_helper(Interval_info &next_interval, Interval_ptr &prev_interval, double w);
+    void transfer_helper(Interval_info &next_interval, Interval *prev_interval, double w);
     
     void transfer_helper(Interval_info &next_interval);
     
+    void add_sources(Interval *interval, int j, int k); // sources from transfer_order[j, k)
+    
     void add_new_branches(Recombination &r);
     
     void compute_interval_info();
@@ -141,25 +170,40 @@ public:
     
     double random();
     
+    template<class F>
+    void for_states(F f) { // f(begin, end) over [0, dim), split across the team for large state spaces
+        if (team != nullptr and dim >= min_team_dim) {
+            team->run(dim, f);
+        } else {
+            f(0, dim);
+        }
+    }
+    
     int get_prev_breakpoint(int x);
     
-    vector<Interval_ptr> &get_state_space(int x);
+    vector<Interval *> &get_state_space(int x);
     
     vector<double> &get_time_points(int x);
     
     vector<double> &get_raw_weights(int x);
     
-    int get_interval_index(Interval_ptr interval, vector<Interval_ptr> &intervals);
+    int get_interval_index(Interval *interval, vector<Interval *> &intervals);
     
     void simplify(map<double, Branch> &joining_branches);
     
-    Interval_ptr sample_curr_interval(int x);
+    Interval *sample_curr_interval(int x);
+    
+    Interval *sample_prev_interval(int x);
+    
+    Interval *sample_source_interval(Interval *interval, int x);
+    
+    int trace_back_helper(Interval *interval, int x);
     
-    Interval_ptr sample_prev_interval(int x);
+    double *get_forward_probs(int x);
     
-    Interval_ptr sample_source_interval(Interval_ptr interval, int x);
+    void load_state_space(int x);
     
-    int trace_back_helper(Interval_ptr interval, int x);
+    void recompute_segment(int x);
     
     double avg_num_states();
     
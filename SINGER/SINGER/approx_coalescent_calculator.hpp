@@ -11,11 +11,9 @@
 #include <stdio.h>
 #include <map>
 #include <math.h>
-#include "Branch.hpp"
-#include "Tree.hpp"
-#include "Recombination.hpp"
+#include "Coalescent_prior.hpp"
 
-class approx_coalescent_calculator {
+class approx_coalescent_calculator : public Coalescent_prior {
     
 public:
     
@@ -28,21 +26,21 @@ public:
     
     ~approx_coalescent_calculator();
     
-    void start(set<Branch> &branches);
+    void start(set<Branch> &branches) override;
     
-    void start(Tree &tree);
+    void start(Tree &tree) override;
     
-    void update(Recombination &r);
+    void update(Recombination &r) override;
     
-    pair<double, double> compute_time_weights(double x, double y);
+    pair<double, double> compute_time_weights(double x, double y) override;
     
     void compute_first_moment();
     
-    double prob(double x, double y);
+    double prob(double x, double y) override;
     
     double prob_integral(double x);
     
-    double find_median(double x, double y);
+    double find_median(double x, double y) override;
     
 };
 
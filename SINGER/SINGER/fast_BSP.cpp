@@ -10,12 +10,65 @@
 fast_BSP::fast_BSP() {}
 
 fast_BSP::~fast_BSP() {
-    vector<vector<double>>().swap(forward_probs);
-    map<int, vector<Interval_ptr>>().swap(state_spaces);
+    map<int, vector<Interval *>>().swap(state_spaces);
+}
+
+void fast_BSP::reset() {
+    cut_time = 0;
+    cutoff = 0;
+    check_points.clear();
+    rhos.clear();
+    recomb_sums.clear();
+    reduced_sums.clear();
+    curr_index = 0;
+    interval_pool.clear();
+    state_spaces.clear();
+    state_spaces[INT_MAX] = {};
+    curr_intervals.clear();
+    temp_intervals.clear();
+    all_join_times.clear();
+    all_join_times[INT_MAX] = {};
+    all_join_weights.clear();
+    all_join_weights[INT_MAX] = {};
+    cc.reset();
+    transfer_infos.clear();
+    transfer_sources.clear();
+    transfer_weights.clear();
+    transfer_order.clear();
+    prev_rho = -1;
+    prev_theta = -1;
+    prev_node = nullptr;
+    dim = 0;
+    recomb_sum = 0;
+    reduced_sum = 0;
+    temp_probs.clear();
+    sample_index = -1;
+    trace_back_probs.clear();
+    forward_probs.clear();
+    emit_thetas.clear();
+    emit_bin_sizes.clear();
+    emit_nodes.clear();
+    emit_mut_offsets.resize(1);
+    emit_mutations.clear();
+    branch_change = false;
+    covered_branches.clear();
+    full_branches.clear();
+    reduced_branches.clear();
+    reduced_intervals.clear();
 }
 
 void fast_BSP::reserve_memory(int length) {
     forward_probs.reserve(length);
+    if (forward_probs.spacing > 0) {
+        emit_thetas.reserve(length);
+        emit_bin_sizes.reserve(length);
+        emit_nodes.reserve(length);
+        emit_mut_offsets.reserve(length + 1);
+    }
+}
+
+void fast_BSP::set_checkpoint(int k) {
+    forward_probs.set_spacing(k);
 }
 
 void fast_BSP::start(set<Branch> &start_branches, set<Interval_info> &start_intervals, double t) {
@@ -26,20 +79,25 @@ void fast_BSP::start(set<Branch> &start_branches, set<Interval_info> &start_inte
     double lb = 0;
     double ub = 0;
     double p = 0;
-    Interval_ptr new_interval = nullptr;
-    cc = make_shared<approx_coalescent_calculator>(cut_time);
+    Interval *new_interval = nullptr;
+    if (exact_coalescent) {
+        cc = make_shared<fast_coalescent_calculator>(cut_time);
+    } else {
+        cc = make_shared<approx_coalescent_calculator>(cut_time);
+    }
     cc->start(start_branches);
     for (const Branch &b : reduced_branches) {
         if (b.upper_node->time > cut_time) {
             lb = max(b.lower_node->time, cut_time);
             ub = b.upper_node->time;
             p = cc->prob(lb, ub);
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             curr_intervals.emplace_back(new_interval);
             temp_probs.emplace_back(p);
         }
     }
-    forward_probs.emplace_back(temp_probs);
+    forward_probs.add_row(temp_probs);
+    forward_probs.pin(curr_index);
     reduced_sums.emplace_back(0.0);
     set_dimensions();
     compute_interval_info();
@@ -55,20 +113,25 @@ void fast_BSP::start(Tree &start_tree, set<Interval_info> &start_intervals, doub
     double lb = 0;
     double ub = 0;
     double p = 0;
-    Interval_ptr new_interval = nullptr;
-    cc = make_shared<approx_coalescent_calculator>(cut_time);
+    Interval *new_interval = nullptr;
+    if (exact_coalescent) {
+        cc = make_shared<fast_coalescent_calculator>(cut_time);
+    } else {
+        cc = make_shared<approx_coalescent_calculator>(cut_time);
+    }
     cc->start(start_tree);
     for (const Branch &b : reduced_branches) {
         if (b.upper_node->time > cut_time) {
             lb = max(b.lower_node->time, cut_time);
             ub = b.upper_node->time;
             p = cc->prob(lb, ub);
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             curr_intervals.emplace_back(new_interval);
             temp_probs.emplace_back(p);
         }
     }
-    forward_probs.emplace_back(temp_probs);
+    forward_probs.add_row(temp_probs);
+    forward_probs.pin(curr_index);
     reduced_sums.emplace_back(0.0);
     set_dimensions();
     compute_interval_info();
@@ -105,9 +168,11 @@ void fast_BSP::transfer(Recombination &r) {
     recomb_sums.emplace_back(0);
     reduced_sums.emplace_back(0);
     sanity_check(r);
+    forward_probs.pin(curr_index);
     curr_index += 1;
+    transfer_infos.clear();
+    transfer_sources.clear();
     transfer_weights.clear();
-    transfer_intervals.clear();
     temp_probs.clear();
     temp_intervals.clear();
     covered_branches.clear();
@@ -116,6 +181,7 @@ void fast_BSP::transfer(Recombination &r) {
     }
     generate_intervals(r);
     state_spaces[curr_index] = curr_intervals;
+    forward_probs.pin(curr_index);
 }
 
 void fast_BSP::regular_forward(double rho) {
@@ -123,10 +189,11 @@ void fast_BSP::regular_forward(double rho) {
     compute_recomb_probs(rho);
     prev_rho = rho;
     curr_index += 1;
-    recomb_sum = inner_product(recomb_probs.begin(), recomb_probs.end(), forward_probs[curr_index - 1].begin(), 0.0);
-    forward_probs.emplace_back(recomb_probs);
+    recomb_sum = inner_product(recomb_probs.begin(), recomb_probs.end(), forward_probs[curr_index - 1], 0.0);
+    double *curr_probs = forward_probs.add_row(dim);
+    double *prev_probs = forward_probs[curr_index - 1];
     for (int i = 0; i < dim; i++) {
-        forward_probs[curr_index][i] = forward_probs[curr_index - 1][i]*(1 - recomb_probs[i]) + recomb_sum*join_weights[i];
+        curr_probs[i] = prev_probs[i]*(1 - recomb_probs[i]) + recomb_sum*join_weights[i];
     }
     recomb_sums.emplace_back(recomb_sum);
     reduced_sums.emplace_back(reduced_sum);
@@ -134,14 +201,14 @@ void fast_BSP::regular_forward(double rho) {
 
 void fast_BSP::update(double rho) {
     double lb, ub, p;
-    Interval_ptr prev_interval, new_interval;
+    Interval *prev_interval, *new_interval;
     Branch prev_branch;
     rhos.emplace_back(rho);
     compute_recomb_probs(rho);
     prev_rho = -1;
     prev_theta = -1;
     curr_index += 1;
-    recomb_sum = inner_product(recomb_probs.begin(), recomb_probs.end(), forward_probs[curr_index - 1].begin(), 0.0);
+    recomb_sum = inner_product(recomb_probs.begin(), recomb_probs.end(), forward_probs[curr_index - 1], 0.0);
     temp_probs.clear();
     temp_intervals.clear();
     covered_branches.clear();
@@ -159,19 +226,21 @@ void fast_BSP::update(double rho) {
         if (covered_branches.count(b) == 0) {
             lb = max(cut_time, b.lower_node->time);
             ub = b.upper_node->time;
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             temp_intervals.emplace_back(new_interval);
             temp_probs.emplace_back(0);
         }
     }
-    forward_probs.emplace_back(temp_probs);
+    forward_probs.add_row(temp_probs);
+    forward_probs.pin(curr_index);
     curr_intervals = temp_intervals;
     state_spaces[curr_index] = curr_intervals;
     set_dimensions();
     compute_interval_info();
     compute_recomb_probs(rho);
+    double *curr_probs = forward_probs[curr_index];
     for (int i = 0; i < dim; i++) {
-        forward_probs[curr_index][i] += recomb_sum*join_weights[i];
+        curr_probs[i] += recomb_sum*join_weights[i];
         // assert(!isnan(forward_probs[curr_index][i]) and forward_probs[curr_index][i] >= 0);
     }
     assert(recomb_sum > 0);
@@ -190,37 +259,48 @@ void fast_BSP::null_emit(double theta, Node_ptr query_node) {
     compute_null_emit_prob(theta, query_node);
     prev_theta = theta;
     prev_node = query_node;
-    double ws = 0;
-    for (int i = 0; i < dim; i++) {
-        forward_probs[curr_index][i] *= null_emit_probs[i];
-        ws += forward_probs[curr_index][i];
-    }
-    assert(ws > 0);
-    for (int i = 0; i < dim; i++) {
-        forward_probs[curr_index][i] /= ws;
+    apply_emission(forward_probs[curr_index], null_emit_probs);
+    if (forward_probs.spacing > 0) {
+        record_emission(theta, 0, query_node);
     }
 }
 
 void fast_BSP::mut_emit(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node) {
     compute_mut_emit_probs(theta, bin_size, mut_set, query_node);
+    apply_emission(forward_probs[curr_index], mut_emit_probs);
+    if (forward_probs.spacing > 0) {
+        emit_mutations.insert(emit_mutations.end(), mut_set.begin(), mut_set.end());
+        record_emission(theta, bin_size, query_node);
+    }
+}
+
+void fast_BSP::apply_emission(double *probs, vector<double> &emit_probs) {
     double ws = 0;
     for (int i = 0; i < dim; i++) {
-        forward_probs[curr_index][i] *= mut_emit_probs[i];
-        ws += forward_probs[curr_index][i];
+        probs[i] *= emit_probs[i];
+        ws += probs[i];
     }
     assert(ws > 0);
     for (int i = 0; i < dim; i++) {
-        forward_probs[curr_index][i] /= ws;
+        probs[i] /= ws;
     }
 }
 
+void fast_BSP::record_emission(double theta, double bin_size, Node_ptr query_node) {
+    assert(emit_thetas.size() == curr_index);
+    emit_thetas.push_back(theta);
+    emit_bin_sizes.push_back(bin_size);
+    emit_nodes.push_back(query_node);
+    emit_mut_offsets.push_back((int) emit_mutations.size());
+}
+
 map<double, Branch> fast_BSP::sample_joining_branches(int start_index, vector<double> &coordinates) {
     prev_rho = -1;
     map<double, Branch> joining_branches = {};
     int x = curr_index;
     int y = 0;
     double pos = coordinates[x + start_index + 1];
-    Interval_ptr interval = sample_curr_interval(x);
+    Interval *interval = sample_curr_interval(x);
     Branch b = interval->branch;
     joining_branches[pos] = b;
     while (x >= 0) {
@@ -250,6 +330,59 @@ map<double, Branch> fast_BSP::sample_joining_branches(int start_index, vector<do
     return joining_branches;
 }
 
+double *fast_BSP::get_forward_probs(int x) {
+    if (!forward_probs.available(x)) {
+        recompute_segment(x);
+    }
+    return forward_probs[x];
+}
+
+void fast_BSP::load_state_space(int x) {
+    curr_intervals = get_state_space(x);
+    set_dimensions();
+    join_times = get_join_times(x);
+    join_weights = get_join_weights(x);
+    for (int i = 0; i < dim; i++) {
+        lower_nodes[i] = curr_intervals[i]->branch.lower_node;
+        upper_nodes[i] = curr_intervals[i]->branch.upper_node;
+        lower_times[i] = lower_nodes[i]->time;
+        upper_times[i] = upper_nodes[i]->time;
+    }
+    prev_rho = -1;
+    prev_theta = -1;
+    prev_node = nullptr;
+}
+
+// replay regular_forward() and the emission of every bin between the stored rows around x
+void fast_BSP::recompute_segment(int x) {
+    int c = forward_probs.prev_stored(x);
+    int e = forward_probs.next_stored(x);
+    load_state_space(c);
+    forward_probs.start_segment(c + 1);
+    for (int z = c + 1; z < e; z++) {
+        double rho = rhos[z - 1];
+        compute_recomb_probs(rho);
+        prev_rho = rho;
+        double *curr_probs = forward_probs.add_segment_row(dim);
+        double *prev_probs = forward_probs[z - 1];
+        for (int i = 0; i < dim; i++) {
+            curr_probs[i] = prev_probs[i]*(1 - recomb_probs[i]) + recomb_sums[z - 1]*join_weights[i];
+        }
+        double theta = emit_thetas[z];
+        Node_ptr query_node = emit_nodes[z];
+        if (emit_mut_offsets[z + 1] > emit_mut_offsets[z]) {
+            set<double> mut_set = set<double>(emit_mutations.begin() + emit_mut_offsets[z], emit_mutations.begin() + emit_mut_offsets[z + 1]);
+            compute_mut_emit_probs(theta, emit_bin_sizes[z], mut_set, query_node);
+            apply_emission(curr_probs, mut_emit_probs);
+        } else {
+            compute_null_emit_prob(theta, query_node);
+            prev_theta = theta;
+            prev_node = query_node;
+            apply_emission(curr_probs, null_emit_probs);
+        }
+    }
+}
+
 double fast_BSP::avg_num_states() {
     int span = 0;
     double count = 0;
@@ -267,7 +400,7 @@ double fast_BSP::avg_num_states() {
 // private methods:
 
 /*
-bool fast_BSP::intercept(Interval_ptr interval) {
+bool fast_BSP::intercept(Interval *interval) {
     set<Interval_info> &intervals = reduced_intervals[interval->branch];
     for (auto &x : intervals) {
         if (interval->lb <= x.ub and interval->ub >= x.lb) {
@@ -320,6 +453,10 @@ void fast_BSP::set_dimensions() {
     join_weights.resize(dim); join_weights.assign(dim, 0);
     null_emit_probs.resize(dim); null_emit_probs.assign(dim, 0);
     mut_emit_probs.resize(dim); mut_emit_probs.assign(dim, 0);
+    lower_nodes.resize(dim);
+    upper_nodes.resize(dim);
+    lower_times.resize(dim);
+    upper_times.resize(dim);
 }
 
 void fast_BSP::compute_recomb_probs(double rho) {
@@ -335,33 +472,34 @@ void fast_BSP::compute_null_emit_prob(double theta, Node_ptr query_node) {
     if (theta == prev_theta and query_node == prev_node) {
         return;
     }
-    for (int i = 0; i < dim; i++) {
-        null_emit_probs[i] = eh->null_emit(curr_intervals[i]->branch, join_times[i], theta, query_node);
-    }
+    eh->null_emit(join_times, lower_times, upper_times, theta, query_node, null_emit_probs);
 }
 
 void fast_BSP::compute_mut_emit_probs(double theta, double bin_size, set<double> &mut_set, Node_ptr query_node) {
-    for (int i = 0; i < dim; i++) {
-        mut_emit_probs[i] = eh->mut_emit(curr_intervals[i]->branch, join_times[i], theta, bin_size, mut_set, query_node);
-    }
+    eh->mut_emit(join_times, lower_nodes, upper_nodes, theta, bin_size, mut_set, query_node, mut_emit_probs);
 }
 
-void fast_BSP::transfer_helper(Interval_info &next_interval, Interval_ptr &prev_interval, double w) {
+void fast_BSP::transfer_helper(Interval_info &next_interval, Interval *prev_interval, double w) {
     if (reduced_branches.count(next_interval.branch) == 0) {
         return;
     }
-    transfer_weights[next_interval].emplace_back(w);
-    transfer_intervals[next_interval].emplace_back(prev_interval);
+    transfer_infos.emplace_back(next_interval);
+    transfer_sources.emplace_back(prev_interval);
+    transfer_weights.emplace_back(w);
 }
 
 void fast_BSP::compute_interval_info() {
     double t;
     double p;
     for (int i = 0; i < curr_intervals.size(); i++) {
-        Interval_ptr interval = curr_intervals[i];
+        Interval *interval = curr_intervals[i];
         tie(t, p) = cc->compute_time_weights(interval->lb, interval->ub);
         join_times[i] = t;
         assert(t > cut_time);
+        lower_nodes[i] = interval->branch.lower_node;
+        upper_nodes[i] = interval->branch.upper_node;
+        lower_times[i] = lower_nodes[i]->time;
+        upper_times[i] = upper_nodes[i]->time;
         if (interval->full(cut_time)) {
             join_weights[i] = p;
         }
@@ -380,7 +518,7 @@ void fast_BSP::compute_interval_info() {
 
 void fast_BSP::sanity_check(Recombination &r) {
     for (int i = 0; i < curr_intervals.size(); i++) {
-        Interval_ptr interval = curr_intervals[i];
+        Interval *interval = curr_intervals[i];
         if (interval->lb == interval->ub and interval->lb == r.inserted_node->time and interval->branch != r.target_branch) {
             forward_probs[curr_index][i] = 0;
         }
@@ -389,18 +527,25 @@ void fast_BSP::sanity_check(Recombination &r) {
 
 void fast_BSP::get_full_branches(Recombination &r) {
     double lb, ub, p;
-    for (auto &x : transfer_weights) {
-        const Branch &b = x.first.branch;
-        lb = x.first.lb;
-        ub = x.first.ub;
-        p = accumulate(x.second.begin(), x.second.end(), 0.0f);
+    int n = (int) transfer_infos.size();
+    int k = 0;
+    for (int j = 0; j < n; j = k) {
+        const Interval_info &interval = transfer_infos[transfer_order[j]];
+        const Branch &b = interval.branch;
+        lb = interval.lb;
+        ub = interval.ub;
+        float q = 0.0f;
+        for (k = j; k < n and !(interval < transfer_infos[transfer_order[k]]); k++) {
+            q += transfer_weights[transfer_order[k]];
+        }
+        p = q;
         if (lb == max(cut_time, b.lower_node->time) and ub == b.upper_node->time and p > 0) {
             full_branches.insert(b);
         }
     }
     for (int i = 0; i < curr_intervals.size(); i++) {
         p = forward_probs[curr_index - 1][i];
-        Interval_ptr prev_interval = curr_intervals[i];
+        Interval *prev_interval = curr_intervals[i];
         if (prev_interval->full(cut_time) and p > 0) {
             full_branches.insert(prev_interval->branch);
         }
@@ -409,55 +554,48 @@ void fast_BSP::get_full_branches(Recombination &r) {
 
 void fast_BSP::generate_intervals(Recombination &r) {
     full_branches.clear();
+    sort_transfers(transfer_infos, transfer_order);
     get_full_branches(r);
     Branch b;
     double lb;
     double ub;
     double p;
-    vector<Interval_ptr> intervals;
-    vector<double> weights;
+    int n = (int) transfer_infos.size();
+    int j = 0;
+    int k = 0;
     Interval_info interval;
-    Interval_ptr new_interval;
-    auto y = transfer_intervals.begin();
-    for (auto x = transfer_weights.begin(); x != transfer_weights.end(); ++x, ++y) {
-        interval = x->first;
-        auto &weights = x->second;
-        auto &intervals = y->second;
+    Interval *new_interval;
+    for (j = 0; j < n; j = k) {
+        interval = transfer_infos[transfer_order[j]];
         b = interval.branch;
         lb = interval.lb;
         ub = interval.ub;
-        p = accumulate(weights.begin(), weights.end(), 0.0);
+        p = 0;
+        for (k = j; k < n and !(interval < transfer_infos[transfer_order[k]]); k++) {
+            p += transfer_weights[transfer_order[k]];
+        }
         assert(!isnan(p));
         if (lb == max(cut_time, b.lower_node->time) and ub == b.upper_node->time) { // full intervals
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             temp_intervals.emplace_back(new_interval);
             temp_probs.emplace_back(p);
-            if (weights.size() > 0) {
-                new_interval->source_weights = move(weights);
-                new_interval->intervals = move(intervals);
-            }
+            add_sources(new_interval, j, k);
             covered_branches.insert(b);
         } else if (full_branches.count(b) == 0) {
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             temp_intervals.emplace_back(new_interval);
             temp_probs.emplace_back(p);
-            if (weights.size() > 0) {
-                new_interval->source_weights = move(weights);
-                new_interval->intervals = move(intervals);
-            }
+            add_sources(new_interval, j, k);
         } else if (p > cutoff) {
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             temp_intervals.emplace_back(new_interval);
             temp_probs.emplace_back(p);
-            if (weights.size() > 0) {
-                new_interval->source_weights = move(weights);
-                new_interval->intervals = move(intervals);
-            }
+            add_sources(new_interval, j, k);
         }
     }
     for (int i = 0; i < curr_intervals.size(); i++) {
         p = forward_probs[curr_index - 1][i];
-        Interval_ptr prev_interval = curr_intervals[i];
+        Interval *prev_interval = curr_intervals[i];
         if (!r.affect(prev_interval->branch)) {
             if (prev_interval->full(cut_time)) {
                 temp_intervals.emplace_back(prev_interval);
@@ -476,18 +614,24 @@ void fast_BSP::generate_intervals(Recombination &r) {
         if (covered_branches.count(b) == 0) {
             lb = max(cut_time, b.lower_node->time);
             ub = b.upper_node->time;
-            new_interval = create_interval(b, lb, ub, curr_index);
+            new_interval = interval_pool.create(b, lb, ub, curr_index);
             temp_intervals.emplace_back(new_interval);
             temp_probs.emplace_back(0);
         }
     }
-    forward_probs.emplace_back(temp_probs);
+    forward_probs.add_row(temp_probs);
     curr_intervals = temp_intervals;
     set_dimensions();
     cc->update(r);
     compute_interval_info();
 }
 
+void fast_BSP::add_sources(Interval *interval, int j, int k) {
+    for (int i = j; i < k; i++) {
+        interval_pool.add_source(interval, transfer_sources[transfer_order[i]], transfer_weights[transfer_order[i]]);
+    }
+}
+
 double fast_BSP::get_overwrite_prob(Recombination &r, double lb, double ub) {
     if (check_points.count(r.pos) > 0) {
         return 0.0;
@@ -503,7 +647,7 @@ double fast_BSP::get_overwrite_prob(Recombination &r, double lb, double ub) {
 }
 
 void fast_BSP::process_interval(Recombination &r, int i) {
-    Interval_ptr &prev_interval = curr_intervals[i];
+    Interval *&prev_interval = curr_intervals[i];
     Branch &prev_branch = prev_interval->branch;
     if (!r.affect(prev_branch)) {
         ;
@@ -518,7 +662,7 @@ void fast_BSP::process_interval(Recombination &r, int i) {
 
 void fast_BSP::process_source_interval(Recombination &r, int i) {
     double w1, w2, lb, ub = 0;
-    Interval_ptr prev_interval = curr_intervals[i];
+    Interval *prev_interval = curr_intervals[i];
     double p = forward_probs[curr_index - 1][i];
     double point_time = r.source_branch.upper_node->time;
     double break_time = r.start_time;
@@ -561,7 +705,7 @@ void fast_BSP::process_source_interval(Recombination &r, int i) {
 
 void fast_BSP::process_target_interval(Recombination &r, int i) {
     double w0, w1, w2, lb, ub = 0;
-    Interval_ptr prev_interval = curr_intervals[i];
+    Interval *prev_interval = curr_intervals[i];
     double p = forward_probs[curr_index - 1][i];
     double join_time = r.inserted_node->time;
     Branch next_branch;
@@ -618,7 +762,7 @@ void fast_BSP::process_target_interval(Recombination &r, int i) {
 
 void fast_BSP::process_other_interval(Recombination &r, int i) {
     double lb, ub = 0;
-    Interval_ptr &prev_interval = curr_intervals[i];
+    Interval *&prev_interval = curr_intervals[i];
     double p = forward_probs[curr_index - 1][i];
     lb = prev_interval->lb;
     ub = prev_interval->ub;
@@ -628,8 +772,7 @@ void fast_BSP::process_other_interval(Recombination &r, int i) {
 }
 
 double fast_BSP::random() {
-    double p = uniform_random();
-    return p;
+    return rng->uniform();
 }
 
 int fast_BSP::get_prev_breakpoint(int x) {
@@ -638,7 +781,7 @@ int fast_BSP::get_prev_breakpoint(int x) {
     return state_it->first;
 }
 
-vector<Interval_ptr > &fast_BSP::get_state_space(int x) {
+vector<Interval *> &fast_BSP::get_state_space(int x) {
     auto state_it = state_spaces.upper_bound(x);
     state_it--;
     return state_it->second;
@@ -656,7 +799,7 @@ vector<double> &fast_BSP::get_join_weights(int x) {
     return weight_it->second;
 }
 
-int fast_BSP::get_interval_index(Interval_ptr interval, vector<Interval_ptr > &intervals) {
+int fast_BSP::get_interval_index(Interval *interval, vector<Interval *> &intervals) {
     auto it = find(intervals.begin(), intervals.end(), interval);
     int index = (int) distance(intervals.begin(), it);
     return index;
@@ -676,13 +819,14 @@ void fast_BSP::simplify(map<double, Branch> &joining_branches) {
     joining_branches = simplified_joining_branches;
 }
 
-Interval_ptr fast_BSP::sample_curr_interval(int x) {
-    vector<Interval_ptr > &intervals = get_state_space(x);
-    double ws = accumulate(forward_probs[x].begin(), forward_probs[x].end(), 0.0);
+Interval *fast_BSP::sample_curr_interval(int x) {
+    vector<Interval *> &intervals = get_state_space(x);
+    double *probs = get_forward_probs(x);
+    double ws = accumulate(probs, probs + forward_probs.dim(x), 0.0);
     double q = random();
     double w = ws*q;
     for (int i = 0; i < intervals.size(); i++) {
-        w -= forward_probs[x][i];
+        w -= probs[i];
         if (w <= 0) {
             sample_index = i;
             return intervals[i];
@@ -692,15 +836,16 @@ Interval_ptr fast_BSP::sample_curr_interval(int x) {
     exit(1);
 }
 
-Interval_ptr fast_BSP::sample_prev_interval(int x) {
-    vector<Interval_ptr > &intervals = get_state_space(x);
+Interval *fast_BSP::sample_prev_interval(int x) {
+    vector<Interval *> &intervals = get_state_space(x);
     vector<double> &prev_times = get_join_times(x);
     double rho = rhos[x];
     double ws = recomb_sums[x];
     double q = random();
     double w = ws*q;
+    double *probs = get_forward_probs(x);
     for (int i = 0; i < intervals.size(); i++) {
-        w -= get_recomb_prob(rho, prev_times[i])*forward_probs[x][i];
+        w -= get_recomb_prob(rho, prev_times[i])*probs[i];
         if (w <= 0) {
             sample_index = i;
             return intervals[i];
@@ -710,19 +855,22 @@ Interval_ptr fast_BSP::sample_prev_interval(int x) {
     exit(1);
 }
 
-Interval_ptr fast_BSP::sample_source_interval(Interval_ptr interval, int x) {
-    vector<Interval_ptr> &intervals = interval->intervals;
-    vector<double> &weights = interval->source_weights;
-    vector<Interval_ptr> &prev_intervals = get_state_space(x);
+Interval *fast_BSP::sample_source_interval(Interval *interval, int x) {
+    vector<Interval *> &prev_intervals = get_state_space(x);
     if (x == interval->start_pos - 1) {
+        int n = interval_pool.num_sources(interval);
         double q = random();
-        double ws = accumulate(weights.begin(), weights.end(), 0.0);
+        double ws = 0;
+        for (int i = 0; i < n; i++) {
+            ws += interval_pool.source_weight(interval, i);
+        }
         double w = ws*q;
-        for (int i = 0; i < weights.size(); i++) {
-            w -= weights[i];
+        for (int i = 0; i < n; i++) {
+            w -= interval_pool.source_weight(interval, i);
             if (w <= 0) {
-                sample_index = get_interval_index(intervals[i], prev_intervals);
-                return intervals[i];
+                Interval *source = interval_pool.source(interval, i);
+                sample_index = get_interval_index(source, prev_intervals);
+                return source;
             }
         }
         cerr << "sampling failed" << endl;
@@ -734,20 +882,21 @@ Interval_ptr fast_BSP::sample_source_interval(Interval_ptr interval, int x) {
     }
 }
 
-Interval_ptr fast_BSP::sample_connection_interval(Interval_ptr interval, int x) {
-    vector<Interval_ptr > &prev_intervals = get_state_space(x);
+Interval *fast_BSP::sample_connection_interval(Interval *interval, int x) {
+    vector<Interval *> &prev_intervals = get_state_space(x);
     vector<double> &prev_times = get_join_times(x);
     vector<double> &next_weights = get_join_weights(x + 1);
     int n = (int) prev_intervals.size();
+    double *probs = get_forward_probs(x);
     double source_recomb_prob, target_proportion;
     vector<double> weights = vector<double>(n);
     recomb_sum = recomb_sums[x];
     reduced_sum = reduced_sums[x + 1];
     target_proportion = next_weights[sample_index];
     for (int i = 0; i < n; i++) {
-        source_recomb_prob = forward_probs[x][i]*get_recomb_prob(rhos[x], prev_times[i]); // probability that goes out from i-state
+        source_recomb_prob = probs[i]*get_recomb_prob(rhos[x], prev_times[i]); // probability that goes out from i-state
         if(interval == prev_intervals[i]) {
-            weights[i] += forward_probs[x][i] - source_recomb_prob;
+            weights[i] += probs[i] - source_recomb_prob;
         }
         weights[i] += source_recomb_prob*target_proportion;
     }
@@ -765,7 +914,7 @@ Interval_ptr fast_BSP::sample_connection_interval(Interval_ptr interval, int x)
     exit(1);
 }
 
-int fast_BSP::trace_back_helper(Interval_ptr interval, int x) {
+int fast_BSP::trace_back_helper(Interval *interval, int x) {
     int y = get_prev_breakpoint(x);
     if (!interval->full(cut_time)) {
         return y;
@@ -782,15 +931,16 @@ int fast_BSP::trace_back_helper(Interval_ptr interval, int x) {
     double t = prev_times[sample_index];
     double w = prev_weights[sample_index];
     while (x > y) {
+        double *prev_probs = get_forward_probs(x - 1);
         recomb_sum = recomb_sums[x - 1];
         reduced_sum = reduced_sums[x];
         if (recomb_sum == 0) {
             shrinkage = 1;
         } else {
             recomb_prob = get_recomb_prob(rhos[x - 1], t);
-            non_recomb_prob = (1 - recomb_prob)*forward_probs[x - 1][sample_index];
+            non_recomb_prob = (1 - recomb_prob)*prev_probs[sample_index];
             // all_prob = non_recomb_prob + recomb_sum*w;
-            all_prob = non_recomb_prob + recomb_sum*w + recomb_sum*forward_probs[x - 1][sample_index]*(1 - reduced_sum);
+            all_prob = non_recomb_prob + recomb_sum*w + recomb_sum*prev_probs[sample_index]*(1 - reduced_sum);
             shrinkage = non_recomb_prob/all_prob;
             assert(!isnan(shrinkage));
             assert(shrinkage >= 0 and shrinkage <= 1);
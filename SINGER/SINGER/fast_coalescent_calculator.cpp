@@ -9,8 +9,8 @@
 
 fast_coalescent_calculator::fast_coalescent_calculator(double t) {
     cut_time = t;
-    coalescence_times.insert(cut_time);
-    coalescence_times.insert(numeric_limits<double>::infinity());
+    coalescence_times.push_back(cut_time);
+    coalescence_times.push_back(numeric_limits<double>::infinity());
 }
 
 fast_coalescent_calculator::~fast_coalescent_calculator() {}
@@ -18,130 +18,221 @@ fast_coalescent_calculator::~fast_coalescent_calculator() {}
 void fast_coalescent_calculator::start(set<Branch> &branches) {
     for (const Branch &b : branches) {
         if (b.lower_node->time > cut_time) {
-            coalescence_times.insert(b.lower_node->time);
+            coalescence_times.push_back(b.lower_node->time);
         }
     }
-    compute_first_moment();
+    sort(coalescence_times.begin(), coalescence_times.end());
+    changed = true;
+}
+
+void fast_coalescent_calculator::start(Tree &tree) {
+    for (auto &x : tree.parents) {
+        if (x.first->time > cut_time) {
+            coalescence_times.push_back(x.first->time);
+        }
+    }
+    sort(coalescence_times.begin(), coalescence_times.end());
+    changed = true;
 }
 
 void fast_coalescent_calculator::update(Recombination &r) {
     double t_old = r.deleted_node->time;
     double t_new = r.inserted_node->time;
     if (t_old > cut_time) {
-        coalescence_times.erase(t_old);
-        first_moment = 0;
+        auto it = lower_bound(coalescence_times.begin(), coalescence_times.end(), t_old);
+        if (it != coalescence_times.end() and *it == t_old) {
+            coalescence_times.erase(it);
+        }
+        changed = true;
     }
     if (t_new > cut_time) {
-        coalescence_times.insert(t_new);
-        first_moment = 0;
-    }
-    if (first_moment == 0) {
-        compute_first_moment();
+        coalescence_times.insert(upper_bound(coalescence_times.begin(), coalescence_times.end(), t_new), t_new);
+        changed = true;
     }
 }
 
 void fast_coalescent_calculator::compute_first_moment() {
-    first_moment = 0;
-    double integral = 0;
-    double num_lineages = coalescence_times.size() - 1;
-    auto it = coalescence_times.begin();
-    double prev_time = cut_time;
-    double next_time = cut_time;
-    double prev_prob, next_prob;
-    double increment = 0;
-    while (next(it) != coalescence_times.end()) {
-        prev_prob = exp(-integral);
-        prev_time = *it;
-        next_time = *next(it);
-        integral += num_lineages*(next_time - prev_time);
-        next_prob = exp(-integral);
-        increment = (prev_prob - next_prob)/num_lineages;
-        first_moment += increment;
-        num_lineages -= 1;
-        it++;
+    int n = (int) coalescence_times.size();
+    hazards.resize(n);
+    survivals.resize(n);
+    lower_probs.resize(n);
+    upper_probs.resize(n);
+    lower_moments.resize(n);
+    upper_moments.resize(n);
+    hazards[0] = 0;
+    survivals[0] = 1;
+    for (int j = 0; j < n - 1; j++) {
+        hazards[j + 1] = hazards[j] + (n - 1 - j)*(coalescence_times[j + 1] - coalescence_times[j]);
+        survivals[j + 1] = isinf(hazards[j + 1]) ? 0 : exp(-hazards[j + 1]);
     }
+    lower_probs[0] = 0;
+    lower_moments[0] = 0;
+    for (int j = 0; j < n - 1; j++) {
+        lower_probs[j + 1] = lower_probs[j] + segment_prob(j, coalescence_times[j], coalescence_times[j + 1]);
+        lower_moments[j + 1] = lower_moments[j] + segment_moment(j, coalescence_times[j], coalescence_times[j + 1]);
+    }
+    upper_probs[n - 1] = 0;
+    upper_moments[n - 1] = 0;
+    for (int j = n - 2; j >= 0; j--) {
+        upper_probs[j] = upper_probs[j + 1] + segment_prob(j, coalescence_times[j], coalescence_times[j + 1]);
+        upper_moments[j] = upper_moments[j + 1] + segment_moment(j, coalescence_times[j], coalescence_times[j + 1]);
+    }
+    first_moment = lower_probs[n - 1];
+    changed = false;
 }
 
 pair<double, double> fast_coalescent_calculator::compute_time_weights(double x, double y) {
     if (x == y) { // no need to compute when point mass
         return {x, 0};
     }
-    double integral = get_integral(x);
-    auto it = coalescence_times.upper_bound(x);
-    it--;
-    // auto u_it = coalescence_times.upper_bound(y);
-    double prev_time, next_time;
-    double p = 0, q = 0;
-    double prev_prob = exp(-integral), next_prob = prev_prob;
-    double num_lineages = get_num_lineages(x);
-    while (*it < y) {
-        prev_prob = exp(-integral);
-        prev_time = max(*it, x);
-        next_time = min(*next(it), y);
-        integral += num_lineages*(next_time - prev_time);
-        next_prob = exp(-integral);
-        p += (prev_prob - next_prob)/num_lineages;
-        if (!isinf(next_time)) {
-            q += ((prev_time - cut_time)*prev_prob - (next_time - cut_time)*next_prob)/num_lineages + (prev_prob - next_prob)/num_lineages/num_lineages;
-        } else {
-            q += (prev_time - cut_time)*prev_prob/num_lineages + (prev_prob - next_prob)/num_lineages/num_lineages;
-        }
-        num_lineages -= 1;
-        it++;
-    }
+    double p = prob(x, y);
+    double q = moment(x, y);
     double t = q/p + cut_time;
     double w = q/first_moment;
     if (y - x < 0.001) {
         t = 0.5*(x + y);
         w = (t - cut_time)*p/first_moment;
     }
+    t = min(max(t, x), y);
     assert(w >= 0);
-    assert(t >= x and t <= y);
     return {t, w};
 }
 
 double fast_coalescent_calculator::prob(double x, double y) {
-    double integral = get_integral(x);
-    auto it = coalescence_times.upper_bound(x);
-    it--;
-    // auto u_it = coalescence_times.upper_bound(y);
-    double prev_time = *it, next_time;
-    double p = 0;
-    double prev_prob = exp(-integral), next_prob = prev_prob;
-    double num_lineages = get_num_lineages(x);
-    while (*it < y) {
-        prev_prob = exp(-integral);
-        prev_time = max(*it, x);
-        next_time = min(*next(it), y);
-        integral += num_lineages*(next_time - prev_time);
-        next_prob = exp(-integral);
-        p += (prev_prob - next_prob)/num_lineages;
-        num_lineages -= 1;
-        it++;
-    }
-    return p;
+    if (changed) {
+        compute_first_moment();
+    }
+    x = max(x, cut_time);
+    if (!(x < y)) {
+        return 0;
+    }
+    int j = get_segment(x);
+    int k = (int) (lower_bound(coalescence_times.begin(), coalescence_times.end(), y) - coalescence_times.begin()) - 1;
+    if (k <= j) {
+        return segment_prob(j, x, y);
+    }
+    return segment_prob(j, x, coalescence_times[j + 1]) + sum_probs(j + 1, k) + segment_prob(k, coalescence_times[k], y);
+}
+
+double fast_coalescent_calculator::moment(double x, double y) {
+    if (changed) {
+        compute_first_moment();
+    }
+    x = max(x, cut_time);
+    if (!(x < y)) {
+        return 0;
+    }
+    int j = get_segment(x);
+    int k = (int) (lower_bound(coalescence_times.begin(), coalescence_times.end(), y) - coalescence_times.begin()) - 1;
+    if (k <= j) {
+        return segment_moment(j, x, y);
+    }
+    return segment_moment(j, x, coalescence_times[j + 1]) + sum_moments(j + 1, k) + segment_moment(k, coalescence_times[k], y);
+}
+
+double fast_coalescent_calculator::find_median(double x, double y) {
+    if (x == y) {
+        return x;
+    }
+    if (y - x <= 0.01) {
+        return 0.5*(x + y);
+    }
+    x = max(x, cut_time);
+    double half = 0.5*prob(x, y);
+    int j = get_segment(x);
+    int last = (int) (lower_bound(coalescence_times.begin(), coalescence_times.end(), y) - coalescence_times.begin()) - 1;
+    int k = j;
+    double a = x;
+    if (j < last and segment_prob(j, x, coalescence_times[j + 1]) < half) {
+        half -= segment_prob(j, x, coalescence_times[j + 1]);
+        // the last segment that starts with less than half of the mass before it
+        int lo = j + 1;
+        int hi = last;
+        while (lo < hi) {
+            int mid = (lo + hi + 1)/2;
+            if (sum_probs(j + 1, mid) <= half) {
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        k = lo;
+        half -= sum_probs(j + 1, k);
+        a = coalescence_times[k];
+    }
+    double n = coalescence_times.size() - 1 - k;
+    double z = half*n/survival(k, a);
+    double t = z < 1 ? a - log1p(-z)/n : min(coalescence_times[k + 1], y);
+    if (isnan(t)) {
+        t = isinf(y) ? x + 1 : 0.5*(x + y);
+    }
+    return min(max(t, x), y);
 }
 
 double fast_coalescent_calculator::get_num_lineages(double x) {
-    auto u_it = coalescence_times.upper_bound(x);
-    // double d0 = distance(u_it, coalescence_times.end());
+    auto u_it = upper_bound(coalescence_times.begin(), coalescence_times.end(), x);
     double d = coalescence_times.size() - distance(coalescence_times.begin(), u_it);
-    // assert(d == d0);
     return d;
 }
 
 double fast_coalescent_calculator::get_integral(double x) {
-    double integral = 0;
-    double num_lineages = coalescence_times.size() - 1;
-    auto it = coalescence_times.begin();
-    double prev_time = cut_time;
-    double next_time = cut_time;
-    while (*it < x) {
-        prev_time = *it;
-        next_time = min(*next(it), x);
-        integral += num_lineages*(next_time - prev_time);
-        num_lineages -= 1;
-        it++;
-    }
-    return integral;
+    if (changed) {
+        compute_first_moment();
+    }
+    if (x <= cut_time) {
+        return 0;
+    }
+    int j = get_segment(x);
+    return hazards[j] + (coalescence_times.size() - 1 - j)*(x - coalescence_times[j]);
+}
+
+int fast_coalescent_calculator::get_segment(double x) {
+    int j = (int) (upper_bound(coalescence_times.begin(), coalescence_times.end(), x) - coalescence_times.begin()) - 1;
+    return min(max(j, 0), (int) coalescence_times.size() - 2);
+}
+
+double fast_coalescent_calculator::survival(int j, double x) {
+    if (x == coalescence_times[j]) {
+        return survivals[j];
+    }
+    if (isinf(x)) {
+        return 0;
+    }
+    return exp(-(hazards[j] + (coalescence_times.size() - 1 - j)*(x - coalescence_times[j])));
+}
+
+double fast_coalescent_calculator::segment_prob(int j, double x, double y) {
+    double n = coalescence_times.size() - 1 - j;
+    return (survival(j, x) - survival(j, y))/n;
+}
+
+double fast_coalescent_calculator::segment_moment(int j, double x, double y) {
+    double n = coalescence_times.size() - 1 - j;
+    double sx = survival(j, x);
+    double sy = survival(j, y);
+    if (isinf(y)) {
+        return (x - cut_time)*sx/n + sx/n/n;
+    }
+    return ((x - cut_time)*sx - (y - cut_time)*sy)/n + (sx - sy)/n/n;
+}
+
+double fast_coalescent_calculator::sum_probs(int j, int k) {
+    if (k <= j) {
+        return 0;
+    }
+    // the difference of the smaller partial sums loses the least precision
+    if (lower_probs[k] < upper_probs[j]) {
+        return lower_probs[k] - lower_probs[j];
+    }
+    return upper_probs[j] - upper_probs[k];
+}
+
+double fast_coalescent_calculator::sum_moments(int j, int k) {
+    if (k <= j) {
+        return 0;
+    }
+    if (lower_moments[k] < upper_moments[j]) {
+        return lower_moments[k] - lower_moments[j];
+    }
+    return upper_moments[j] - upper_moments[k];
 }
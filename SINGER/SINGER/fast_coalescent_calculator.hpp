@@ -11,36 +11,70 @@
 #include <stdio.h>
 #include <map>
 #include <math.h>
-#include "Branch.hpp"
-#include "Recombination.hpp"
+#include <algorithm>
+#include "Coalescent_prior.hpp"
+
+// Exact prior from the coalescence times above cut_time. Between two consecutive times the number
+// of lineages is constant, so the survival exp(-H), with H the integrated number of lineages, and
+// its integrals have closed forms on each segment. Their partial sums from cut_time and to
+// infinity are kept at every time, so a query is two binary searches and the two partial segments
+// at its ends. A new or removed time changes the number of lineages below it and the hazard above
+// it, which rescales every segment differently, so the sums are rebuilt in one pass at the first
+// query after an update. A BSP transfer therefore stays linear in the number of lineages, several
+// times the cost of approx_coalescent_calculator over a run, and the exact prior is only used with
+// -exact_coalescent.
+class fast_coalescent_calculator : public Coalescent_prior {
 
-class fast_coalescent_calculator {
-    
 public:
-    
+
     double cut_time;
     double first_moment = 0;
     double rho = 0;
-    multiset<double> coalescence_times = {};
-    
+    vector<double> coalescence_times = {}; // sorted, from cut_time to infinity
+    bool changed = true;
+    vector<double> hazards = {}; // H at each coalescence time
+    vector<double> survivals = {};
+    vector<double> lower_probs = {}; // integral of exp(-H) from cut_time to each coalescence time
+    vector<double> upper_probs = {}; // and from each coalescence time to infinity
+    vector<double> lower_moments = {}; // the same for (t - cut_time)*exp(-H)
+    vector<double> upper_moments = {};
+
     fast_coalescent_calculator(double t);
-    
+
     ~fast_coalescent_calculator();
-    
-    void start(set<Branch> &branches);
-    
-    void update(Recombination &r);
-    
-    void compute_first_moment();
-    
-    pair<double, double> compute_time_weights(double x, double y);
-    
-    double prob(double x, double y);
-    
+
+    void start(set<Branch> &branches) override;
+
+    void start(Tree &tree) override;
+
+    void update(Recombination &r) override;
+
+    void compute_first_moment(); // rebuilds the partial sums, first_moment is their total
+
+    pair<double, double> compute_time_weights(double x, double y) override;
+
+    double prob(double x, double y) override;
+
+    double find_median(double x, double y) override;
+
     double get_num_lineages(double x);
-    
+
     double get_integral(double x);
 
+    double moment(double x, double y);
+
+    int get_segment(double x); // j such that x is in [coalescence_times[j], coalescence_times[j + 1])
+
+    double survival(int j, double x);
+
+    double segment_prob(int j, double x, double y); // x and y within segment j
+
+    double segment_moment(int j, double x, double y);
+
+    double sum_probs(int j, int k); // whole segments j to k - 1
+
+    double sum_moments(int j, int k);
+
 };
 
 #endif /* fast_coalescent_calculator_hpp */
@@ -1,8 +1,12 @@
 import argparse
+import gzip
+import os
 import sys
 
 def index_vcf(input_prefix, segment_length):
     input_file = f"{input_prefix}.vcf"
+    if not os.path.exists(input_file):
+        input_file = f"{input_prefix}.vcf.gz" # offsets are then into the decompressed text
     index_file = f"{input_prefix}.index"
     
     current_segment_start = -1
@@ -14,7 +18,7 @@ def index_vcf(input_prefix, segment_length):
         f.write("")
     
     # Read VCF file line-by-line
-    with open(input_file, 'r') as f:
+    with (gzip.open(input_file, 'rt') if input_file.endswith(".gz") else open(input_file, 'r')) as f:
         for line in f:
             # Skip header lines
             if line.startswith("#"):
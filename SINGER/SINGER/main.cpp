@@ -7,12 +7,18 @@
 
 #include <iostream>
 #include "Test.hpp"
+#include "Parallel_sampler.hpp"
+#include "Chain_sampler.hpp"
 
 int main(int argc, const char * argv[]) {
     bool fast = false;
     bool resume = false;
     bool debug = false;
+    bool binary = false;
+    bool block_window = false;
     bool haps_mode = false;
+    bool make_cache = false;
+    bool exact_coalescent = false;
     double r = -1, m = -1, Ne = -1;
     int num_iters = 0;
     int spacing = 1;
@@ -24,6 +30,12 @@ int main(int argc, const char * argv[]) {
     double epsilon_hmm = 0.1;
     double epsilon_psmc = 0.05;
     int seed = 42;
+    int checkpoint = 0;
+    int num_threads = 0;
+    double block_length = 1e6;
+    int num_chains = 0;
+    int bsp_threads = 1;
+    int cut_threads = 1;
     for (int i = 1; i < argc; ++i) {
         string arg = argv[i];
         if (arg == "-fast") {
@@ -47,6 +59,34 @@ int main(int argc, const char * argv[]) {
             }
             debug = true;
         }
+        else if (arg == "-binary") {
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                cerr << "Error: -binary flag doesn't take any value. " << endl;
+                exit(1);
+            }
+            binary = true;
+        }
+        else if (arg == "-block_window") {
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                cerr << "Error: -block_window flag doesn't take any value. " << endl;
+                exit(1);
+            }
+            block_window = true;
+        }
+        else if (arg == "-exact_coalescent") {
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                cerr << "Error: -exact_coalescent flag doesn't take any value. " << endl;
+                exit(1);
+            }
+            exact_coalescent = true;
+        }
+        else if (arg == "-make_cache") {
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                cerr << "Error: -make_cache flag doesn't take any value. " << endl;
+                exit(1);
+            }
+            make_cache = true;
+        }
         else if (arg == "-Ne") {
             if (i + 1 >= argc || argv[i+1][0] == '-') {
                 cerr << "Error: -Ne flag cannot be empty. " << endl;
@@ -228,11 +268,117 @@ int main(int argc, const char * argv[]) {
                 exit(1);
             }
         }
+        else if (arg == "-checkpoint") {
+            if (i + 1 >= argc || argv[i+1][0] == '-') {
+                checkpoint = -1; // sqrt of the number of bins
+                continue;
+            }
+            try {
+                checkpoint = stoi(argv[++i]);
+            } catch (const invalid_argument&) {
+                cerr << "Error: -checkpoint flag expects a number. " << endl;
+                exit(1);
+            }
+            if (checkpoint < 1) {
+                cerr << "Error: -checkpoint spacing must be positive. " << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "-threads") {
+            if (i + 1 >= argc || argv[i+1][0] == '-') {
+                cerr << "Error: -threads flag cannot be empty. " << endl;
+                exit(1);
+            }
+            try {
+                num_threads = stoi(argv[++i]);
+            } catch (const invalid_argument&) {
+                cerr << "Error: -threads flag expects a number. " << endl;
+                exit(1);
+            }
+            if (num_threads < 1) {
+                cerr << "Error: -threads must be positive. " << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "-block") {
+            if (i + 1 >= argc || argv[i+1][0] == '-') {
+                cerr << "Error: -block flag cannot be empty. " << endl;
+                exit(1);
+            }
+            try {
+                block_length = stod(argv[++i]);
+            } catch (const invalid_argument&) {
+                cerr << "Error: -block flag expects a number. " << endl;
+                exit(1);
+            }
+            if (block_length <= 0) {
+                cerr << "Error: -block length must be positive. " << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "-chains") {
+            if (i + 1 >= argc || argv[i+1][0] == '-') {
+                cerr << "Error: -chains flag cannot be empty. " << endl;
+                exit(1);
+            }
+            try {
+                num_chains = stoi(argv[++i]);
+            } catch (const invalid_argument&) {
+                cerr << "Error: -chains flag expects a number. " << endl;
+                exit(1);
+            }
+            if (num_chains < 1) {
+                cerr << "Error: -chains must be positive. " << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "-bsp_threads") {
+            if (i + 1 >= argc || argv[i+1][0] == '-') {
+                cerr << "Error: -bsp_threads flag cannot be empty. " << endl;
+                exit(1);
+            }
+            try {
+                bsp_threads = stoi(argv[++i]);
+            } catch (const invalid_argument&) {
+                cerr << "Error: -bsp_threads flag expects a number. " << endl;
+                exit(1);
+            }
+            if (bsp_threads < 1) {
+                cerr << "Error: -bsp_threads must be positive. " << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "-cut_threads") {
+            if (i + 1 >= argc || argv[i+1][0] == '-') {
+                cerr << "Error: -cut_threads flag cannot be empty. " << endl;
+                exit(1);
+            }
+            try {
+                cut_threads = stoi(argv[++i]);
+            } catch (const invalid_argument&) {
+                cerr << "Error: -cut_threads flag expects a number. " << endl;
+                exit(1);
+            }
+            if (cut_threads < 1) {
+                cerr << "Error: -cut_threads must be positive. " << endl;
+                exit(1);
+            }
+        }
         else {
             cerr << "Error: Unknown flag. " << arg << endl;
             exit(1);
         }
     }
+    if (make_cache) { // converts the input once for all the windows that read it later
+        if (input_filename.size() == 0) {
+            cerr << "-input flag missing or invalid value. " << endl;
+            exit(1);
+        }
+        Genotype_cache cache = Genotype_cache();
+        cache.build(input_filename, haps_mode);
+        cout << "Cached " << cache.header.num_sites << " sites of " << cache.header.num_haplotypes << " haplotypes" << endl;
+        return 0;
+    }
     /*
     if (r < 0) {
         cerr << "-r flag missing or invalid value. " << endl;
@@ -275,8 +421,32 @@ int main(int argc, const char * argv[]) {
     sampler.set_output_file_prefix(output_prefix);
     sampler.fast_mode = fast;
     sampler.random_seed = seed;
+    sampler.checkpoint = checkpoint;
+    sampler.binary_output = binary;
+    sampler.block_window = block_window;
+    sampler.exact_coalescent = exact_coalescent;
+    sampler.bsp_threads = bsp_threads;
+    sampler.cut_threads = cut_threads;
     sampler.start = start_pos;
     sampler.end = end_pos;
+    if (cut_threads > 1 and bsp_threads > 1) {
+        cerr << "Error: -cut_threads and -bsp_threads cannot be combined. " << endl;
+        exit(1);
+    }
+    if (num_chains > 0 and (resume or debug or num_threads > 0)) {
+        cerr << "Error: -chains only works with a fresh run of a single region. " << endl;
+        exit(1);
+    }
+    if (num_threads > 0) { // blocks of the region on a thread pool, in place of one process per block
+        if (resume or debug or haps_mode) {
+            cerr << "Error: -threads only works with a fresh run on VCF input. " << endl;
+            exit(1);
+        }
+        Parallel_sampler parallel_sampler = Parallel_sampler(sampler, num_threads, block_length);
+        parallel_sampler.load_vcf(input_filename);
+        parallel_sampler.run(start_pos, end_pos, num_iters, spacing);
+        return 0;
+    }
     if (resume) {
         sampler.sequence_length = end_pos - start_pos;
         if (fast) {
@@ -308,6 +478,11 @@ int main(int argc, const char * argv[]) {
     } else {
         sampler.iterative_start();
     }
+    if (num_chains > 0) { // chains forked from the same initial ARG, each on its own thread
+        Chain_sampler chain_sampler = Chain_sampler(sampler, num_chains);
+        chain_sampler.run(num_iters, spacing);
+        return 0;
+    }
     if (fast) {
         sampler.fast_internal_sample(num_iters, spacing);
     } else {
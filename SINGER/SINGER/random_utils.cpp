@@ -7,19 +7,90 @@
 
 #include "random_utils.hpp"
 
-std::mt19937 random_engine;
-std::uniform_real_distribution<> uniform_distribution(0.0, 1.0);
+Random_context::Random_context(uint64_t seed, uint64_t stream) {
+    this->seed(seed, stream);
+}
 
-double uniform_random() {
-    double q = uniform_distribution(random_engine);
+void Random_context::seed(uint64_t s) {
+    seed(s, stream);
+}
+
+void Random_context::seed(uint64_t s, uint64_t n) {
+    key = s;
+    stream = n;
+    counter = 0;
+    position = 4;
+}
+
+Random_context Random_context::split(uint64_t n) {
+    return Random_context(key, n);
+}
+
+void Random_context::generate_block(uint64_t c) {
+    uint32_t x[4] = {(uint32_t) c, (uint32_t) (c >> 32), (uint32_t) stream, (uint32_t) (stream >> 32)};
+    uint32_t k0 = (uint32_t) key;
+    uint32_t k1 = (uint32_t) (key >> 32);
+    for (int r = 0; r < 10; r++) {
+        uint64_t p0 = (uint64_t) 0xD2511F53*x[0];
+        uint64_t p1 = (uint64_t) 0xCD9E8D57*x[2];
+        uint32_t y[4] = {(uint32_t) (p1 >> 32) ^ x[1] ^ k0, (uint32_t) p1, (uint32_t) (p0 >> 32) ^ x[3] ^ k1, (uint32_t) p0};
+        x[0] = y[0];
+        x[1] = y[1];
+        x[2] = y[2];
+        x[3] = y[3];
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+    }
+    for (int i = 0; i < 4; i++) {
+        block[i] = x[i];
+    }
+}
+
+Random_context::result_type Random_context::operator()() {
+    if (position == 4) {
+        generate_block(counter);
+        counter += 1;
+        position = 0;
+    }
+    return block[position++];
+}
+
+double Random_context::uniform() {
+    uint64_t a = (*this)() >> 5;
+    uint64_t b = (*this)() >> 6;
+    double q = (a*67108864.0 + b)/9007199254740992.0;
     if (q < 1e-5 or q > 1 - 1e-5) {
-        q = uniform_distribution(random_engine);
+        a = (*this)() >> 5;
+        b = (*this)() >> 6;
+        q = (a*67108864.0 + b)/9007199254740992.0;
     }
     return q;
 }
 
+std::ostream &operator<<(std::ostream &os, const Random_context &rng) {
+    os << rng.key << " " << rng.stream << " " << rng.counter << " " << rng.position;
+    return os;
+}
+
+std::istream &operator>>(std::istream &is, Random_context &rng) {
+    is >> rng.key >> rng.stream >> rng.counter >> rng.position;
+    if (rng.position < 4) { // the current block was generated from the previous counter
+        rng.generate_block(rng.counter - 1);
+    }
+    return is;
+}
+
+Random_context &thread_random_context() {
+    static thread_local Random_context rng;
+    return rng;
+}
+
+double uniform_random() {
+    return thread_random_context().uniform();
+}
+
 void set_seed(unsigned seed) {  // Implement the set_seed function
-    random_engine.seed(seed);
+    thread_random_context().seed(seed);
 }
 
 std::string get_time() {
@@ -27,7 +98,8 @@ std::string get_time() {
     auto now = system_clock::now();
     auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
     auto timer = system_clock::to_time_t(now);
-    std::tm bt = *std::localtime(&timer);
+    std::tm bt;
+    localtime_r(&timer, &bt);
     std::ostringstream oss;
     oss << "[" << std::put_time(&bt, "%H:%M:%S"); // HH:MM:SS
     oss << '.' << std::setfill('0') << std::setw(3) << ms.count() << "]";
@@ -15,9 +15,48 @@
 #include <iomanip>
 #include <fstream>
 #include <sstream>
+#include <cstdint>
 
-extern std::mt19937 random_engine;
-extern std::uniform_real_distribution<> uniform_distribution;
+// Counter-based generator (Philox4x32-10): block i of a stream is a pure function of
+// (seed, stream, i), so every sampler owns its own context and draws the same chain whatever
+// thread runs it, and independent streams are split off by number rather than by reseeding.
+class Random_context {
+
+public:
+
+    typedef uint32_t result_type;
+
+    uint64_t key = 0;
+    uint64_t stream = 0;
+    uint64_t counter = 0; // next block to generate
+    uint32_t block[4] = {};
+    int position = 4; // next unused word of block
+
+    Random_context(uint64_t seed = 0, uint64_t stream = 0);
+
+    void seed(uint64_t s); // keeps the stream
+
+    void seed(uint64_t s, uint64_t n);
+
+    Random_context split(uint64_t n); // same seed, stream n
+
+    result_type operator()();
+
+    double uniform(); // in (0, 1), with draws very close to the ends redrawn once, as in uniform_random
+
+    void generate_block(uint64_t c);
+
+    static constexpr result_type min() {return 0;}
+
+    static constexpr result_type max() {return UINT32_MAX;}
+};
+
+std::ostream &operator<<(std::ostream &os, const Random_context &rng);
+
+std::istream &operator>>(std::istream &is, Random_context &rng);
+
+// per-thread context for code that does not carry its own (the older engines and tests)
+Random_context &thread_random_context();
 
 double uniform_random();
 